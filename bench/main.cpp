@@ -0,0 +1,1038 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <popl.hpp>
+#include <SDL.h>
+#include <SDL_mixer.h>
+#include <thread>
+#include <vector>
+
+#include "Machine/MachineFactory.h"
+#include "i8080_arcade/AudioMixer.h"
+#include "i8080_arcade/HeadlessIoController.h"
+#include "i8080_arcade/MachineBatch.h"
+#include "i8080_arcade/MappedMemoryController.h"
+#include "i8080_arcade/MidwayPorts.h"
+#include "i8080_arcade/SpscRing.h"
+#include "i8080_arcade/Tracer.h"
+#include "i8080_arcade/PostProcessor.h"
+#include "i8080_arcade/RewindBuffer.h"
+#include "i8080_arcade/VramBlitter.h"
+
+#ifndef I8080_ARCADE_VERSION
+#define I8080_ARCADE_VERSION "unknown"
+#endif
+
+#ifndef I8080_ARCADE_SYSTEM
+#define I8080_ARCADE_SYSTEM "unknown"
+#endif
+
+#ifndef I8080_ARCADE_PROCESSOR
+#define I8080_ARCADE_PROCESSOR "unknown"
+#endif
+
+#ifndef I8080_ARCADE_COMPILER
+#define I8080_ARCADE_COMPILER "unknown"
+#endif
+
+#ifndef I8080_ARCADE_BUILD_TYPE
+#define I8080_ARCADE_BUILD_TYPE "unknown"
+#endif
+
+using namespace popl;
+using namespace i8080_arcade;
+
+static std::filesystem::path configFile;
+static std::filesystem::path romFilePath;
+static std::filesystem::path outputFile;
+static std::string gameRom;
+static std::string filter;
+static int repeats{};
+static uint64_t headlessFrames{};
+
+// Results are accumulated here so the optimiser can't discard the work being measured
+static volatile uint64_t sink{};
+
+int ParseCmdLine(int argc, char** argv)
+{
+	OptionParser op("Allowed options");
+	auto helpOpt = op.add<Switch>("h", "help", "produce this help message");
+	auto configFileOpt = op.add<Value<std::string>>("c", "config-file", "i8080 arcade configuration file", "conf/config.json");
+	auto romFilePathOpt = op.add<Value<std::string>>("r", "rom-file-path", "Path to the i8080 arcade rom files directory", "rom-files");
+	auto gameRomOpt = op.add<Value<std::string>>("g", "game", "The name of the i8080 arcade game to load as defined in the config file", "space-invaders");
+	auto outputFileOpt = op.add<Value<std::string>>("o", "output", "Write the JSON results to this file instead of stdout");
+	auto filterOpt = op.add<Value<std::string>>("f", "filter", "Only run the benchmarks whose name contains this string");
+	auto repeatsOpt = op.add<Value<int>>("", "repeats", "The number of times each benchmark is repeated", 5);
+	auto headlessFramesOpt = op.add<Value<uint64_t>>("", "frames", "The number of video frames to run for in the headless frame benchmark", 600);
+	op.parse(argc, argv);
+
+	if (helpOpt->is_set() == true)
+	{
+		std::cout << op << std::endl;
+		// print help then exit
+		return -1;
+	}
+
+	configFile = configFileOpt->value();
+	romFilePath = romFilePathOpt->value();
+	gameRom = gameRomOpt->value();
+	repeats = repeatsOpt->value();
+	headlessFrames = headlessFramesOpt->value();
+
+	if (outputFileOpt->is_set() == true)
+	{
+		outputFile = outputFileOpt->value();
+	}
+
+	if (filterOpt->is_set() == true)
+	{
+		filter = filterOpt->value();
+	}
+
+	if (repeats <= 0)
+	{
+		throw std::invalid_argument("The number of repeats must be greater than zero");
+	}
+
+	if (headlessFrames == 0)
+	{
+		throw std::invalid_argument("The number of headless frames must be greater than zero");
+	}
+
+	return 0;
+}
+
+/** Measure
+
+	Run a benchmark body once to warm up and then repeats times.
+
+	@param	iterations	The number of operations performed by each call to fn.
+	@param	fn			The benchmark body, called with the number of operations to perform.
+
+	@return				A JSON object holding the fastest, median and slowest time per operation in nanoseconds.
+*/
+template<typename Fn>
+nlohmann::json Measure(uint64_t iterations, Fn&& fn)
+{
+	std::vector<double> samples;
+
+	fn(iterations / 10 + 1);
+
+	for (int i = 0; i < repeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn(iterations);
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		samples.push_back(elapsed.count() / iterations);
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	return
+	{
+		{ "iterations", iterations },
+		{ "repeats", repeats },
+		{ "ns-per-op-min", samples.front() },
+		{ "ns-per-op-median", samples[samples.size() / 2] },
+		{ "ns-per-op-max", samples.back() }
+	};
+}
+
+/** Latency summary
+
+	@param	latencies	The measured latencies in nanoseconds, they are sorted in place.
+
+	@return				A JSON object holding the latency percentiles in nanoseconds.
+*/
+nlohmann::json LatencySummary(std::vector<int64_t>& latencies)
+{
+	if (latencies.empty() == true)
+	{
+		return { { "samples", 0 } };
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&latencies](double p)
+	{
+		return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+	};
+
+	return
+	{
+		{ "samples", latencies.size() },
+		{ "latency-ns-min", latencies.front() },
+		{ "latency-ns-p50", percentile(0.5) },
+		{ "latency-ns-p99", percentile(0.99) },
+		{ "latency-ns-max", latencies.back() }
+	};
+}
+
+int64_t Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+nlohmann::json BenchMemoryRead()
+{
+	auto memoryController = std::make_shared<MemoryController>();
+	// Call through the interface the same way the cpu does
+	MachEmu::IController& controller = *memoryController;
+
+	return Measure(1 << 24, [&controller](uint64_t iterations)
+	{
+		uint64_t sum = 0;
+
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			sum += controller.Read(static_cast<uint16_t>(i & 0x3FFF));
+		}
+
+		sink = sink + sum;
+	});
+}
+
+/** Make the memory controller under test
+
+	@param	mapped	When true the controller specialised for the Space Invaders memory layout, otherwise the flat controller.
+*/
+std::shared_ptr<MemoryController> MakeBenchMemoryController(bool mapped)
+{
+	if (mapped == true)
+	{
+		return std::make_shared<MappedMemoryController<InvadersMemoryMap>>();
+	}
+
+	return std::make_shared<MemoryController>();
+}
+
+nlohmann::json BenchMemoryWriteRam(bool mapped)
+{
+	auto memoryController = MakeBenchMemoryController(mapped);
+	MachEmu::IController& controller = *memoryController;
+
+	// Work ram, below video ram, skips the dirty row tracking
+	return Measure(1 << 24, [&controller](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			controller.Write(static_cast<uint16_t>(0x2000 + (i & 0x03FF)), static_cast<uint8_t>(i >> 10));
+		}
+	});
+}
+
+nlohmann::json BenchMemoryWriteVram(bool mapped)
+{
+	auto memoryController = MakeBenchMemoryController(mapped);
+	MachEmu::IController& controller = *memoryController;
+
+	// Every write changes the value held, so every write marks its row dirty
+	return Measure(1 << 24, [&controller](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			controller.Write(static_cast<uint16_t>(0x2400 + (i % 7168)), static_cast<uint8_t>(i / 7168 + 1));
+		}
+	});
+}
+
+// Dirty the rows a typical frame touches, a sprite 16 rows high
+void TouchVram(MemoryController& memoryController, uint64_t frame)
+{
+	auto firstRow = (frame * 16) % VideoFrame::rows;
+
+	for (uint64_t row = firstRow; row < firstRow + 16 && row < VideoFrame::rows; row++)
+	{
+		memoryController.Write(static_cast<uint16_t>(0x2400 + row * VideoFrame::rowBytes + 8), static_cast<uint8_t>(frame));
+	}
+}
+
+nlohmann::json BenchVideoFramePool(int framePoolSize)
+{
+	auto memoryController = std::make_shared<MemoryController>(framePoolSize);
+
+	return Measure(1 << 16, [&memoryController](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			TouchVram(*memoryController, i);
+			auto videoFrame = memoryController->GetVideoFrame();
+			sink = sink + videoFrame->sequence;
+		}
+	});
+}
+
+nlohmann::json BenchVideoFrameTriple()
+{
+	auto memoryController = std::make_shared<MemoryController>();
+
+	return Measure(1 << 16, [&memoryController](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			TouchVram(*memoryController, i);
+			memoryController->PublishVideoFrame();
+			sink = sink + memoryController->AcquireVideoFrame()->sequence;
+		}
+	});
+}
+
+std::array<uint8_t, VideoFrame::rows * VideoFrame::rowBytes> MakeVram()
+{
+	std::array<uint8_t, VideoFrame::rows * VideoFrame::rowBytes> vram{};
+	uint32_t state = 0x8080;
+
+	for (auto& byte : vram)
+	{
+		// xorshift, a stable pattern between runs and builds
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		byte = static_cast<uint8_t>(state);
+	}
+
+	return vram;
+}
+
+nlohmann::json BenchVramBlit(const std::string& kernel, bool upright, VramBlitter::PixelFormat pixelFormat)
+{
+	VramBlitter blitter(upright, 0xFF, pixelFormat, kernel);
+	auto vram = MakeVram();
+	auto pitch = blitter.Width() * blitter.BytesPerPixel();
+	std::vector<uint8_t> frame(pitch * blitter.Height());
+	auto region = blitter.GetRegion(0, VideoFrame::rows - 1);
+
+	return Measure(1 << 12, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			blitter.Blit(vram.data(), region, frame.data(), pitch);
+		}
+
+		sink = sink + frame[i8080_arcade::VideoFrame::rowBytes];
+	});
+}
+
+nlohmann::json BenchPostProcess(const std::string& kernel, size_t threads)
+{
+	VramBlitter blitter(true, 0xFF, VramBlitter::PixelFormat::ARGB8888, "auto");
+	auto vram = MakeVram();
+	auto region = blitter.GetRegion(0, VideoFrame::rows - 1);
+	std::vector<uint32_t> source(static_cast<size_t>(blitter.Width()) * blitter.Height());
+	blitter.Blit(vram.data(), region, reinterpret_cast<uint8_t*>(source.data()), blitter.Width() * 4);
+
+	// Every effect at a typical window scale, the phosphor persistence processes the whole frame
+	PostProcessor postProcessor(blitter.Width(), blitter.Height(), { 3, 0.5, 0.75, threads }, kernel);
+	auto pitch = postProcessor.Width() * 4;
+	std::vector<uint8_t> frame(static_cast<size_t>(pitch) * postProcessor.Height());
+
+	return Measure(1 << 8, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			postProcessor.Process(source.data(), region, frame.data(), pitch);
+		}
+
+		sink = sink + frame[pitch];
+	});
+}
+
+nlohmann::json BenchVramBlitMeenHw(const nlohmann::json& videoOptions)
+{
+	auto i8080ArcadeIO = meen_hw::MakeI8080ArcadeIO();
+
+	if (i8080ArcadeIO == nullptr)
+	{
+		throw std::runtime_error("Failed to create i8080 arcade hardware");
+	}
+
+	i8080ArcadeIO->SetOptions(videoOptions.dump().c_str());
+	auto vram = MakeVram();
+	auto width = i8080ArcadeIO->GetVRAMWidth();
+	std::vector<uint8_t> frame(width * i8080ArcadeIO->GetVRAMHeight() * videoOptions["bpp"].get<int>() / 8);
+
+	return Measure(1 << 12, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			i8080ArcadeIO->BlitVRAM(std::span(frame), width, std::span(vram));
+		}
+
+		sink = sink + frame[i8080_arcade::VideoFrame::rowBytes];
+	});
+}
+
+/** Frame handoff, pool
+
+	Measure the time from the producer (machine) thread queuing a frame on the ring to the
+	consumer (render) thread dequeuing it, frames are produced at a fixed interval.
+*/
+nlohmann::json BenchFrameHandoffPool(size_t queueDepth, uint64_t frames, std::chrono::microseconds interval)
+{
+	struct Handoff
+	{
+		VideoFramePtr frame;
+		int64_t pushed;
+	};
+
+	auto memoryController = std::make_shared<MemoryController>(static_cast<int>(queueDepth) + 1);
+	SpscRing<Handoff> ring(queueDepth);
+	std::vector<int64_t> latencies;
+	latencies.reserve(frames);
+
+	std::thread producer([&]()
+	{
+		auto deadline = std::chrono::steady_clock::now();
+
+		for (uint64_t i = 0; i < frames; i++)
+		{
+			deadline += interval;
+			std::this_thread::sleep_until(deadline);
+			TouchVram(*memoryController, i);
+			auto videoFrame = memoryController->GetVideoFrame();
+
+			if (videoFrame == nullptr)
+			{
+				ring.Drop();
+			}
+			else
+			{
+				ring.Push({ std::move(videoFrame), Now() });
+			}
+		}
+	});
+
+	Handoff handoff{};
+
+	while (ring.Consumed() + ring.Dropped() < frames)
+	{
+		if (ring.Pop(handoff) == true)
+		{
+			latencies.push_back(Now() - handoff.pushed);
+			// Release the frame back to the pool
+			handoff.frame = nullptr;
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	producer.join();
+
+	auto result = LatencySummary(latencies);
+	result["frames"] = frames;
+	result["dropped"] = ring.Dropped();
+	return result;
+}
+
+/** Frame handoff, triple buffer
+
+	Measure the time from the producer (machine) thread publishing a frame to the consumer (render)
+	thread acquiring it, frames are produced at a fixed interval. Frames that are overwritten before
+	they are acquired are counted as skipped.
+*/
+nlohmann::json BenchFrameHandoffTriple(uint64_t frames, std::chrono::microseconds interval)
+{
+	auto memoryController = std::make_shared<MemoryController>();
+	// Indexed by frame sequence number, written before the frame is published
+	std::vector<int64_t> published(frames + 1);
+	std::vector<int64_t> latencies;
+	latencies.reserve(frames);
+
+	std::thread producer([&]()
+	{
+		auto deadline = std::chrono::steady_clock::now();
+
+		for (uint64_t i = 0; i < frames; i++)
+		{
+			deadline += interval;
+			std::this_thread::sleep_until(deadline);
+			TouchVram(*memoryController, i);
+			// A new memory controller numbers its frames from 1
+			published[i + 1] = Now();
+			memoryController->PublishVideoFrame();
+		}
+	});
+
+	uint64_t lastSequence = 0;
+
+	// The last frame is never overwritten so it is always acquired
+	while (lastSequence < frames)
+	{
+		auto videoFrame = memoryController->AcquireVideoFrame();
+
+		if (videoFrame != nullptr && videoFrame->sequence != lastSequence)
+		{
+			latencies.push_back(Now() - published[videoFrame->sequence]);
+			lastSequence = videoFrame->sequence;
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	producer.join();
+
+	auto result = LatencySummary(latencies);
+	result["frames"] = frames;
+	result["skipped"] = frames - latencies.size();
+	return result;
+}
+
+nlohmann::json BenchInputPortRead(const nlohmann::json& videoHardware)
+{
+	auto memoryController = std::make_shared<MemoryController>();
+	auto ioController = std::make_shared<HeadlessIoController>(memoryController, 1, videoHardware);
+	MachEmu::IController& controller = *ioController;
+
+	return Measure(1 << 22, [&controller](uint64_t iterations)
+	{
+		uint64_t sum = 0;
+
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			sum += controller.Read(static_cast<uint16_t>(1 + (i & 0x01)));
+		}
+
+		sink = sink + sum;
+	});
+}
+
+/** Port io
+
+	Measure a single IN or OUT to the port map, cycling through the sequence a game uses to
+	shift a sprite and start a sound: shift data, shift amount, shifted result and sound latch.
+*/
+template<typename Ports>
+nlohmann::json BenchPortIo()
+{
+	auto i8080ArcadeIO = meen_hw::MakeI8080ArcadeIO();
+
+	if (i8080ArcadeIO == nullptr)
+	{
+		throw std::runtime_error("Failed to create i8080 arcade hardware");
+	}
+
+	Ports ports;
+	ports.Attach(i8080ArcadeIO.get());
+
+	return Measure(1 << 24, [&ports](uint64_t iterations)
+	{
+		uint64_t sum = 0;
+
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			auto data = static_cast<uint8_t>(i >> 2);
+
+			switch (i & 0x03)
+			{
+				case 0:
+				{
+					sum += ports.WritePort(4, data);
+					break;
+				}
+				case 1:
+				{
+					sum += ports.WritePort(2, data);
+					break;
+				}
+				case 2:
+				{
+					sum += ports.ReadPort(3);
+					break;
+				}
+				default:
+				{
+					sum += ports.WritePort(3, data);
+					break;
+				}
+			}
+		}
+
+		sink = sink + sum;
+	});
+}
+
+/** Run headless
+
+	Run the selected game headless as fast as possible for the headless frame count.
+
+	@param	onSave	When set the machine saves its state every frame, synchronously, and hands it to this handler.
+
+	@return			The statistics of the run.
+*/
+HeadlessIoController::Statistics RunHeadless(const nlohmann::json& hardware, const nlohmann::json& software, const nlohmann::json& arcadeGame, std::function<void(const char*)> onSave = nullptr)
+{
+	auto machEmu = hardware["mach-emu"];
+	// Don't sync the machine to real time, run it as fast as possible
+	machEmu["clockResolution"] = -1;
+	// Keep the save on the machine thread so that it is part of the frame time
+	machEmu["saveAsync"] = false;
+	auto machine = MachEmu::MakeMachine(machEmu.dump().c_str());
+	auto memoryController = MakeMemoryController(arcadeGame["memory"]);
+	auto ioController = std::make_shared<HeadlessIoController>(memoryController, headlessFrames, hardware["video"]);
+
+	ioController->SetVideoOptions(software["video"]);
+	memoryController->LoadRoms(romFilePath, arcadeGame["memory"]["rom"]["file"]);
+	machine->SetOptions(arcadeGame["memory"].dump().c_str());
+	machine->SetMemoryController(memoryController);
+	machine->SetIoController(ioController);
+
+	if (onSave != nullptr)
+	{
+		ioController->SetSaveEveryFrame(true);
+		machine->OnSave(std::move(onSave));
+	}
+
+	machine->Run(0x00);
+	machine->WaitForCompletion();
+
+	auto stats = ioController->GetStatistics();
+
+	if (stats.frames == 0 || stats.wallTime == 0)
+	{
+		throw std::runtime_error("The machine did not complete any frames");
+	}
+
+	return stats;
+}
+
+nlohmann::json BenchHeadlessFrame(const nlohmann::json& hardware, const nlohmann::json& software, const nlohmann::json& arcadeGame)
+{
+	auto stats = RunHeadless(hardware, software, arcadeGame);
+
+	auto wallSeconds = stats.wallTime / 1e9;
+
+	return
+	{
+		{ "game", gameRom },
+		{ "frames", stats.frames },
+		{ "cycles", stats.cycles },
+		{ "ns-per-frame", static_cast<double>(stats.wallTime) / stats.frames },
+		{ "cycles-per-second", stats.cycles / wallSeconds },
+		{ "speed-up", stats.emulatedTime / 1e9 / wallSeconds }
+	};
+}
+
+/** Rewind capture
+
+	Measure the full cost of a rewind snapshot, the machine saving its state to JSON after every
+	frame and the save being delta encoded into a rewind buffer holding 30 seconds, against the
+	same run without saves. The frame budget percentage is the capture cost as a fraction of a
+	60Hz frame, rewind should stay under 5% on the target hardware.
+*/
+nlohmann::json BenchRewindCapture(const nlohmann::json& hardware, const nlohmann::json& software, const nlohmann::json& arcadeGame)
+{
+	const auto& rewind = hardware["rewind"];
+	RewindBuffer rewindBuffer(30 * 60, rewind["budget"].get<size_t>(), rewind["keyframe-interval"].get<size_t>());
+	size_t saveBytes = 0;
+
+	auto plain = RunHeadless(hardware, software, arcadeGame);
+	auto capturing = RunHeadless(hardware, software, arcadeGame, [&rewindBuffer, &saveBytes](const char* json)
+	{
+		saveBytes = std::strlen(json);
+		rewindBuffer.Push(json);
+	});
+
+	auto plainFrame = static_cast<double>(plain.wallTime) / plain.frames;
+	auto capturingFrame = static_cast<double>(capturing.wallTime) / capturing.frames;
+	auto capture = capturingFrame - plainFrame;
+
+	return
+	{
+		{ "game", gameRom },
+		{ "frames", capturing.frames },
+		{ "save-bytes", saveBytes },
+		{ "ns-per-frame", plainFrame },
+		{ "ns-per-frame-capturing", capturingFrame },
+		{ "capture-ns-per-frame", capture },
+		{ "frame-budget-percent", capture / (1e9 / 60) * 100 }
+	};
+}
+
+nlohmann::json BenchBatchStep(const nlohmann::json& hardware, const nlohmann::json& software, size_t instances)
+{
+	MachineBatch batch(hardware, software, gameRom, romFilePath, instances);
+	std::vector<uint16_t> inputPorts(instances);
+
+	auto result = Measure(60, [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			batch.Step(inputPorts);
+		}
+
+		sink = sink + batch.Observations()[0];
+	});
+
+	result["instances"] = instances;
+	result["frames-per-second"] = instances * 1e9 / result["ns-per-op-median"].get<double>();
+	return result;
+}
+
+/** Trace span
+
+	Measure recording a span, including reading the clock at its end, with the writer thread
+	draining the ring to a temporary trace file. Each run is a quarter of the ring so that the
+	writer keeps up and the spans are queued rather than dropped.
+*/
+nlohmann::json BenchTraceSpan()
+{
+	auto path = std::filesystem::temp_directory_path() / "i8080-arcade-bench-trace.json";
+	nlohmann::json result;
+
+	{
+		Tracer tracer(path);
+		auto start = FrameTiming::Now();
+
+		result = Measure(1 << 14, [&tracer, start](uint64_t iterations)
+		{
+			for (uint64_t i = 0; i < iterations; i++)
+			{
+				tracer.Span(Tracer::Event::ServiceInterrupts, start, FrameTiming::Now());
+			}
+		});
+
+		// Finish writing before the trace file is removed
+		tracer.Close();
+	}
+
+	std::filesystem::remove(path);
+	return result;
+}
+
+/** Audio mix
+
+	Measure the cost of the native mixer rendering one device buffer with every sample looping.
+*/
+nlohmann::json BenchAudioMix(const nlohmann::json& audioHardware)
+{
+	auto sampleRate = audioHardware["sample-rate"].get<int>();
+	auto channels = audioHardware["channels"].get<int>();
+	auto bufferFrames = audioHardware["sample-size"].get<size_t>();
+	std::vector<std::vector<int16_t>> samples;
+	AudioMixer mixer(sampleRate, channels, bufferFrames);
+	std::vector<int16_t> buffer(bufferFrames * channels);
+
+	// Samples of differing lengths so the voices wrap at different points in the buffer
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		samples.emplace_back(static_cast<size_t>(sampleRate) / (i + 2), static_cast<int16_t>(1000 + i));
+	}
+
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		mixer.SetSample(i, samples[i]);
+		mixer.QueueTrigger(i, AudioMixer::Action::Loop, 0);
+	}
+
+	auto result = Measure(1 << 12, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			mixer.Mix(buffer);
+		}
+
+		sink = sink + static_cast<uint16_t>(buffer[0]);
+	});
+
+	result["frames-per-op"] = bufferFrames;
+	return result;
+}
+
+/** Audio trigger latency
+
+	Measure the time from the producer (machine) thread triggering a sample to the audio device being
+	handed the buffer it starts in. The device callback is simulated by a thread which mixes a buffer
+	every buffer period, triggers are raised at irregular intervals in real time.
+*/
+nlohmann::json BenchAudioTriggerLatency(const nlohmann::json& audioHardware, uint64_t triggers)
+{
+	auto sampleRate = audioHardware["sample-rate"].get<int>();
+	auto channels = audioHardware["channels"].get<int>();
+	auto bufferFrames = audioHardware["sample-size"].get<size_t>();
+	std::vector<int16_t> sample(static_cast<size_t>(sampleRate) / 10, 1000);
+	AudioMixer mixer(sampleRate, channels, bufferFrames);
+	FrameTiming frameTiming;
+	std::atomic<bool> done{};
+
+	mixer.SetSample(0, sample);
+	mixer.SetFrameTiming(&frameTiming);
+
+	std::thread callback([&]()
+	{
+		auto period = std::chrono::nanoseconds(static_cast<int64_t>(bufferFrames * 1000000000 / sampleRate));
+		auto deadline = std::chrono::steady_clock::now();
+		std::vector<int16_t> buffer(bufferFrames * channels);
+
+		while (done.load(std::memory_order_acquire) == false)
+		{
+			deadline += period;
+			std::this_thread::sleep_until(deadline);
+			mixer.Mix(buffer);
+		}
+	});
+
+	auto start = Now();
+
+	for (uint64_t i = 0; i < triggers; i++)
+	{
+		// Spread the triggers over the buffer period
+		std::this_thread::sleep_for(std::chrono::microseconds(3000 + (i * 7919) % 5000));
+		mixer.QueueTrigger(0, AudioMixer::Action::Play, Now() - start);
+	}
+
+	// Let the last trigger reach the device
+	std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<int64_t>(4 * bufferFrames * 1000000000 / sampleRate)));
+	done.store(true, std::memory_order_release);
+	callback.join();
+
+	auto summary = frameTiming.Summarise(FrameTiming::Stage::Audio);
+
+	return
+	{
+		{ "samples", summary.count },
+		{ "latency-ns-p50", summary.p50 },
+		{ "latency-ns-p99", summary.p99 },
+		{ "latency-ns-max", summary.max },
+		{ "dropped", mixer.DroppedTriggers() }
+	};
+}
+
+/** SDL Mixer trigger latency
+
+	The SDL Mixer counterpart of the audio trigger latency: the time from the producer thread playing a
+	sample to the SDL Mixer post mix callback for the buffer it was first mixed into, the point the
+	runtime audio stage measures. SDL's dummy audio driver stands in for the device, it requests a
+	buffer every buffer period. In the emulator the play is also delayed by the main thread handling
+	the RenderAudio event, which is not included.
+*/
+nlohmann::json BenchAudioTriggerLatencySdlMixer(const nlohmann::json& audioHardware, uint64_t triggers)
+{
+	struct PostMix
+	{
+		FrameTiming frameTiming;
+		std::atomic<int64_t> triggerTime{};
+	} postMix;
+
+	if (SDL_AudioInit("dummy") < 0)
+	{
+		throw std::runtime_error(std::string("Failed to initialise the dummy audio driver: ") + SDL_GetError());
+	}
+
+	// The same format as the SDL controller
+	if (Mix_OpenAudio(audioHardware["sample-rate"].get<int>(), 8 /* format (mono) */, audioHardware["channels"].get<int>(), audioHardware["sample-size"].get<int>()) < 0)
+	{
+		SDL_AudioQuit();
+		throw std::runtime_error(std::string("Failed to open SDL Mixer: ") + SDL_GetError());
+	}
+
+	int frequency = 0;
+	Uint16 format = 0;
+	int channels = 0;
+	Mix_QuerySpec(&frequency, &format, &channels);
+	// A tenth of a second of silence, only when it is mixed matters
+	std::vector<Uint8> pcm(static_cast<size_t>(frequency) / 10 * channels * (SDL_AUDIO_BITSIZE(format) / 8));
+	auto chunk = Mix_QuickLoad_RAW(pcm.data(), static_cast<Uint32>(pcm.size()));
+
+	Mix_SetPostMix([](void* udata, [[maybe_unused]] Uint8* stream, [[maybe_unused]] int len)
+	{
+		auto postMix = static_cast<PostMix*>(udata);
+		auto triggerTime = postMix->triggerTime.exchange(0, std::memory_order_relaxed);
+
+		if (triggerTime != 0)
+		{
+			postMix->frameTiming.Record(FrameTiming::Stage::Audio, FrameTiming::Now() - triggerTime);
+		}
+	}, &postMix);
+
+	for (uint64_t i = 0; i < triggers; i++)
+	{
+		// Spread the triggers over the buffer period as the native mixer benchmark does
+		std::this_thread::sleep_for(std::chrono::microseconds(3000 + (i * 7919) % 5000));
+		// Keep the oldest trigger time until the post mix callback takes it
+		int64_t none = 0;
+		postMix.triggerTime.compare_exchange_strong(none, FrameTiming::Now(), std::memory_order_relaxed);
+		Mix_PlayChannel(-1, chunk, 0);
+	}
+
+	// Let the last trigger reach the device
+	std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<int64_t>(4 * audioHardware["sample-size"].get<uint64_t>() * 1000000000 / frequency)));
+	Mix_SetPostMix(nullptr, nullptr);
+	Mix_HaltChannel(-1);
+	Mix_FreeChunk(chunk);
+	Mix_CloseAudio();
+	SDL_AudioQuit();
+
+	auto summary = postMix.frameTiming.Summarise(FrameTiming::Stage::Audio);
+
+	return
+	{
+		{ "samples", summary.count },
+		{ "latency-ns-p50", summary.p50 },
+		{ "latency-ns-p99", summary.p99 },
+		{ "latency-ns-max", summary.max }
+	};
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		if (ParseCmdLine(argc, argv) < 0)
+		{
+			// We return < 0 when we print the help, exit.
+			return 0;
+		}
+
+		std::ifstream fin(configFile);
+
+		if (!fin)
+		{
+			throw std::runtime_error("The config file failed to open");
+		}
+
+		auto config = nlohmann::json::parse(fin)["i8080-arcade"];
+		const auto& hardware = config["hardware"];
+		const auto& software = config["software"];
+
+		if (software.contains(gameRom) == false)
+		{
+			throw std::invalid_argument("The game is not defined in the config file");
+		}
+
+		auto queueDepth = hardware["video"]["frame-queue-depth"].get<size_t>();
+		std::vector<std::pair<std::string, std::function<nlohmann::json()>>> benchmarks
+		{
+			{ "memory-read", BenchMemoryRead },
+			{ "memory-write-ram", []() { return BenchMemoryWriteRam(false); } },
+			{ "memory-write-ram-mapped", []() { return BenchMemoryWriteRam(true); } },
+			{ "memory-write-vram", []() { return BenchMemoryWriteVram(false); } },
+			{ "memory-write-vram-mapped", []() { return BenchMemoryWriteVram(true); } },
+			{ "video-frame-pool", [queueDepth]() { return BenchVideoFramePool(static_cast<int>(queueDepth) + 1); } },
+			{ "video-frame-triple", BenchVideoFrameTriple }
+		};
+
+		for (const auto& kernel : VramBlitter::AvailableKernels())
+		{
+			for (auto upright : { false, true })
+			{
+				for (auto pixelFormat : { VramBlitter::PixelFormat::RGB332, VramBlitter::PixelFormat::ARGB8888 })
+				{
+					auto name = std::string("vram-blit-") + kernel.name + (upright == true ? "-upright" : "-cocktail") + (pixelFormat == VramBlitter::PixelFormat::RGB332 ? "-rgb332" : "-argb8888");
+					benchmarks.emplace_back(name, [name = std::string(kernel.name), upright, pixelFormat]() { return BenchVramBlit(name, upright, pixelFormat); });
+				}
+			}
+		}
+
+		for (const auto& kernel : PostProcessor::AvailableKernels())
+		{
+			benchmarks.emplace_back(std::string("post-process-") + kernel.name + "-1-thread", [name = std::string(kernel.name)]() { return BenchPostProcess(name, 1); });
+			benchmarks.emplace_back(std::string("post-process-") + kernel.name + "-auto-threads", [name = std::string(kernel.name)]() { return BenchPostProcess(name, 0); });
+		}
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			auto videoOptions = software["video"];
+			videoOptions["bpp"] = 8;
+			videoOptions["orientation"] = orientation;
+			benchmarks.emplace_back(std::string("vram-blit-meen-hw-") + orientation + "-rgb332", [videoOptions]() { return BenchVramBlitMeenHw(videoOptions); });
+		}
+
+		benchmarks.emplace_back("frame-handoff-pool", [queueDepth]() { return BenchFrameHandoffPool(queueDepth, 2000, std::chrono::microseconds(250)); });
+		benchmarks.emplace_back("frame-handoff-triple", []() { return BenchFrameHandoffTriple(2000, std::chrono::microseconds(250)); });
+		benchmarks.emplace_back("input-port-read", [&hardware]() { return BenchInputPortRead(hardware["video"]); });
+		benchmarks.emplace_back("port-io-meen-hw", []() { return BenchPortIo<MeenHwPorts>(); });
+		benchmarks.emplace_back("port-io-native", []() { return BenchPortIo<MidwayPorts<>>(); });
+		benchmarks.emplace_back("trace-span", []() { return BenchTraceSpan(); });
+		benchmarks.emplace_back("audio-mix", [&hardware]() { return BenchAudioMix(hardware["audio"]); });
+		benchmarks.emplace_back("audio-trigger-latency", [&hardware]() { return BenchAudioTriggerLatency(hardware["audio"], 500); });
+		benchmarks.emplace_back("audio-trigger-latency-sdl-mixer", [&hardware]() { return BenchAudioTriggerLatencySdlMixer(hardware["audio"], 500); });
+		benchmarks.emplace_back("headless-frame", [&]() { return BenchHeadlessFrame(hardware, software, software[gameRom]); });
+		benchmarks.emplace_back("rewind-capture", [&]() { return BenchRewindCapture(hardware, software, software[gameRom]); });
+		benchmarks.emplace_back("batch-step-1", [&]() { return BenchBatchStep(hardware, software, 1); });
+		benchmarks.emplace_back("batch-step-hw-threads", [&]() { return BenchBatchStep(hardware, software, std::max(1u, std::thread::hardware_concurrency())); });
+
+		nlohmann::json kernels = nlohmann::json::array();
+
+		for (const auto& kernel : VramBlitter::AvailableKernels())
+		{
+			kernels.push_back(kernel.name);
+		}
+
+		nlohmann::json results
+		{
+			{ "version", I8080_ARCADE_VERSION },
+			{ "system", I8080_ARCADE_SYSTEM },
+			{ "processor", I8080_ARCADE_PROCESSOR },
+			{ "compiler", I8080_ARCADE_COMPILER },
+			{ "build-type", I8080_ARCADE_BUILD_TYPE },
+			{ "hardware-threads", std::thread::hardware_concurrency() },
+			{ "blit-kernels", kernels },
+			{ "benchmarks", nlohmann::json::object() }
+		};
+
+		for (const auto& [name, benchmark] : benchmarks)
+		{
+			if (name.find(filter) != std::string::npos)
+			{
+				// Progress goes to stderr so stdout remains valid JSON
+				fprintf(stderr, "Running %s\n", name.c_str());
+				results["benchmarks"][name] = benchmark();
+			}
+		}
+
+		if (outputFile.empty() == true)
+		{
+			std::cout << results.dump(4) << std::endl;
+		}
+		else
+		{
+			std::ofstream fout(outputFile);
+
+			if (!fout)
+			{
+				throw std::runtime_error("The output file failed to open");
+			}
+
+			fout << results.dump(4) << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "i8080-arcade-bench failed: %s\n", e.what());
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ARCADE_CONFIG_H
+#define ARCADE_CONFIG_H
+
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** Arcade config
+
+		The sections of the config file needed to run one game, the file is parsed once and
+		each section is looked up once. The options handed to the machine as strings are
+		serialised here rather than each time a machine is made.
+	*/
+	struct ArcadeConfig
+	{
+		std::string game;				/**< The name of the game as defined in the config file. */
+		std::string machineOptions;		/**< The mach-emu hardware section for MakeMachine, with the clock unsynchronised as the io controllers pace the machine. */
+		std::string memoryOptions;		/**< The game's memory section for SetOptions. */
+		nlohmann::json memory;			/**< The game's memory section. */
+		nlohmann::json audioHardware;	/**< The audio hardware section. */
+		nlohmann::json videoHardware;	/**< The video hardware section. */
+		nlohmann::json inputHardware;	/**< The input hardware section. */
+		nlohmann::json rewindHardware;	/**< The rewind hardware section. */
+		nlohmann::json audioSoftware;	/**< The audio software section. */
+		nlohmann::json videoSoftware;	/**< The video software section. */
+		int frameQueueDepth{};			/**< The video frame queue depth. */
+
+		/** Load
+
+			@param	configFile	The config file, see the README for an explanation of each option.
+			@param	game		The name of the game to load the sections of.
+
+			@return				The sections of the config file for the game.
+
+			@throw	std::runtime_error when the config file can't be opened.
+			@throw	std::invalid_argument when the game is not defined in the config file.
+			@throw	nlohmann::json::exception when the config file is invalid or a section is missing.
+		*/
+		static ArcadeConfig Load(const std::filesystem::path& configFile, const std::string& game);
+
+		/** Games
+
+			@param	configFile	The config file, see the README for an explanation of each option.
+
+			@return				The names of the games defined in the software section of the config file, sorted by name.
+
+			@throw	std::runtime_error when the config file can't be opened.
+			@throw	nlohmann::json::exception when the config file is invalid.
+		*/
+		static std::vector<std::string> Games(const std::filesystem::path& configFile);
+	};
+} // namespace i8080_arcade
+
+#endif // ARCADE_CONFIG_H
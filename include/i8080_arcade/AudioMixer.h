@@ -0,0 +1,284 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "i8080_arcade/FrameTiming.h"
+#include "i8080_arcade/SpscRing.h"
+
+namespace i8080_arcade
+{
+	/** Audio mixer
+
+		A sample mixer run directly from the audio device callback.
+
+		The machine thread queues sample triggers, timestamped in emulated time, on a wait-free
+		ring which the callback drains each time it renders a buffer. Emulated time is mapped to
+		output sample positions so that triggers land at the same spacing they were raised at,
+		a trigger which arrives too late (or too far ahead) re-anchors the mapping and is played
+		at the start of the buffer.
+
+		Each sample has one voice, triggering a sample which is playing restarts it. A looping
+		sample repeats from its start until it is stopped.
+	*/
+	class AudioMixer final
+	{
+		public:
+			/** Action
+
+				What a trigger does to the voice of its sample.
+			*/
+			enum class Action : uint8_t
+			{
+				Play,	/**< Play the sample once from the start. */
+				Loop,	/**< Play the sample repeatedly from the start until it is stopped. */
+				Stop	/**< Stop the sample. */
+			};
+
+			/** Trigger
+
+				A request to change the voice of a sample.
+			*/
+			struct Trigger
+			{
+				int64_t time{};			/**< The emulated time in nanoseconds the trigger was raised at. */
+				int64_t wallTime{};		/**< The steady clock time in nanoseconds the trigger was raised at, see FrameTiming::Now. */
+				uint8_t sample{};		/**< The index of the sample. */
+				Action action{};		/**< What to do to the voice. */
+			};
+
+		private:
+			/** Voice
+
+				The playback state of one sample.
+			*/
+			struct Voice
+			{
+				size_t position{};		/**< The next frame of the sample to mix. */
+				bool active{};			/**< Whether the sample is playing. */
+				bool looping{};			/**< Whether the sample restarts when it ends. */
+			};
+
+			/** Scheduled trigger
+
+				A trigger waiting for the buffer it falls in to be rendered.
+			*/
+			struct Scheduled
+			{
+				Trigger trigger;		/**< The trigger. */
+				uint64_t position{};	/**< The output frame the trigger takes effect at. */
+			};
+
+			/** Samples
+
+				A view of the mono 16 bit PCM of each sample at the output sample rate.
+			*/
+			std::vector<std::span<const int16_t>> samples_;
+
+			/** Voices
+
+				One voice per sample.
+
+				@remark		Only accessed from the callback once it is running.
+			*/
+			std::vector<Voice> voices_;
+
+			/** Triggers
+
+				The triggers queued by the machine thread for the callback.
+			*/
+			SpscRing<Trigger> triggers_;
+
+			/** Scheduled
+
+				The triggers popped from triggers_ which fall in a later buffer, oldest first.
+
+				@remark		Only accessed from the callback, its capacity is reserved so it never allocates.
+			*/
+			std::vector<Scheduled> scheduled_;
+
+			/** Accumulator
+
+				The 32 bit sum of the voices of the buffer being rendered.
+			*/
+			std::vector<int32_t> accumulator_;
+
+			/** Frame timing
+
+				When set the trigger to output latency is recorded to its audio stage.
+			*/
+			FrameTiming* frameTiming_{};
+
+			/** Sample rate
+
+				The output frames per second.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int sampleRate_{};
+
+			/** Channels
+
+				The number of interleaved output channels, every channel receives the same mono mix.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int channels_{};
+
+			/** Buffer frames
+
+				The number of frames the device requests per callback.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t bufferFrames_{};
+
+			/** Position
+
+				The number of output frames rendered.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t position_{};
+
+			/** Anchored
+
+				Whether anchorTime_ and anchorPosition_ map emulated time to output frames.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool anchored_{};
+
+			/** Anchor time
+
+				The emulated time in nanoseconds which maps to anchorPosition_.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t anchorTime_{};
+
+			/** Anchor position
+
+				The output frame which anchorTime_ maps to.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t anchorPosition_{};
+
+			/** Schedule
+
+				Map a trigger to the output frame it takes effect at.
+
+				@param	trigger		The trigger to map.
+				@param	bufferStart	The first frame of the buffer being rendered.
+
+				@return				The frame the trigger takes effect at, never before bufferStart.
+			*/
+			uint64_t Schedule(const Trigger& trigger, uint64_t bufferStart);
+
+			/** Apply
+
+				Change the voice of a trigger's sample.
+
+				@param	trigger		The trigger to apply.
+			*/
+			void Apply(const Trigger& trigger);
+
+			/** Render
+
+				Add the active voices to the accumulator.
+
+				@param	begin	The first frame of the accumulator to render.
+				@param	end		One past the last frame of the accumulator to render.
+			*/
+			void Render(size_t begin, size_t end);
+
+		public:
+			/** Initialisation constructor
+
+				@param	sampleRate		The output frames per second.
+				@param	channels		The number of interleaved output channels.
+				@param	bufferFrames	The number of frames the device requests per callback.
+				@param	queueCapacity	The most triggers that can be queued between callbacks.
+
+				@throw	std::invalid_argument when any of the parameters are zero.
+			*/
+			AudioMixer(int sampleRate, int channels, size_t bufferFrames, size_t queueCapacity = 256);
+
+			/** Set a sample
+
+				@param	index	The index of the sample.
+				@param	pcm		The mono 16 bit PCM of the sample at the output sample rate, empty if there is no sample.
+
+				@remark		Must be called before the callback is started, the PCM is not copied and must outlive the mixer.
+			*/
+			void SetSample(size_t index, std::span<const int16_t> pcm);
+
+			/** Sample rate
+
+				@return		The output frames per second, samples must be converted to it before they are set.
+			*/
+			int SampleRate() const;
+
+			/** Sample duration
+
+				@param	index	The index of the sample.
+
+				@return			The play time of the sample in nanoseconds, 0 if there is no sample.
+			*/
+			uint64_t SampleDuration(size_t index) const;
+
+			/** Set the frame timing
+
+				@param	frameTiming		Where to record the trigger to output latency, nullptr for none.
+
+				@remark		Must be called before the callback is started.
+			*/
+			void SetFrameTiming(FrameTiming* frameTiming);
+
+			/** Queue trigger
+
+				Queue a trigger, called from the machine thread only.
+
+				@param	sample	The index of the sample.
+				@param	action	What to do to the sample.
+				@param	time	The emulated time in nanoseconds the trigger was raised at.
+
+				@return			false if the queue was full and the trigger was dropped.
+			*/
+			bool QueueTrigger(uint8_t sample, Action action, int64_t time);
+
+			/** Mix
+
+				Render the next buffer, called from the audio device callback only.
+
+				@param	out		Receives the interleaved 16 bit samples of the buffer.
+			*/
+			void Mix(std::span<int16_t> out);
+
+			/** Dropped triggers
+
+				@return		The number of triggers dropped because the queue was full.
+			*/
+			uint64_t DroppedTriggers() const;
+	};
+} // namespace i8080_arcade
+
+#endif // AUDIO_MIXER_H
@@ -0,0 +1,226 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef BATCH_IO_CONTROLLER_H
+#define BATCH_IO_CONTROLLER_H
+
+#include <atomic>
+#include <nlohmann/json.hpp>
+#include <semaphore>
+#include <span>
+
+#include "meen_hw/MH_Factory.h"
+#include "i8080_arcade/MemoryController.h"
+#include "i8080_arcade/MidwayPorts.h"
+
+namespace i8080_arcade
+{
+	/** Lock step io controller.
+
+		A custom io controller targetting Space Invaders i8080 arcade hardware compatible ROMs
+		that runs the machine a fixed number of frames at a time. At the end of each step the
+		observation (video ram then work ram) is copied out and the machine thread blocks until
+		the next step is started with a new set of inputs.
+
+		@see MachineBatch
+	*/
+	class BatchIoController final : public MachEmu::IController
+	{
+		public:
+			/** Video ram size
+
+				The number of bytes of video ram at the start of an observation.
+			*/
+			static constexpr size_t vramSize_{ 0x1C00 };
+
+			/** Work ram size
+
+				The number of bytes of work ram (0x2000 to 0x23FF) following the video ram in an observation.
+			*/
+			static constexpr size_t ramSize_{ 0x0400 };
+
+			/** Observation size
+
+				The total size of an observation in bytes.
+			*/
+			static constexpr size_t observationSize_{ vramSize_ + ramSize_ };
+
+		private:
+			/**	i8080_arcade
+
+				The hardware emulator.
+			*/
+			std::unique_ptr<meen_hw::MH_II8080ArcadeIO> i8080ArcadeIO_;
+
+			/** Ports
+
+				The port map, inline or forwarded to the hardware emulator depending on the build.
+			*/
+			ArcadePorts ports_;
+
+			/** i8080 arcade memory
+
+				The memory the observations are copied from.
+			*/
+			std::shared_ptr<MemoryController> memoryController_;
+
+			/** Running
+
+				Shared by all of the controllers in a batch, it limits the number of machines emulating at once.
+			*/
+			std::counting_semaphore<>& running_;
+
+			/** Go
+
+				Released by Go to start a step.
+			*/
+			std::binary_semaphore go_{ 0 };
+
+			/** Done
+
+				Released by the machine thread at the end of a step.
+			*/
+			std::binary_semaphore done_{ 0 };
+
+			/** Observation
+
+				Where to copy the observation at the end of each step.
+			*/
+			std::span<uint8_t> observation_;
+
+			/** Frames per step
+
+				The number of render interrupts in each step.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint32_t framesPerStep_{};
+
+			/** Frames
+
+				The number of render interrupts since the start of the current step.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint32_t frames_{};
+
+			/** Input ports
+
+				The port 1 (low byte) and port 2 (high byte) input bitfields for the current step.
+
+				@remark		Written before go_ is released and read by the machine thread after acquiring it.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint16_t inputPorts_{};
+
+			/** Holding a thread
+
+				Set while the machine thread holds one of the running_ slots.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool holdingThread_{};
+
+			/** Quit
+
+				Set by Quit to stop the machine at the start of the next step.
+			*/
+			std::atomic_bool quit_{};
+
+		public:
+			/** Initialisation constructor
+
+				@param	memoryController	The memory controller from which to take observations.
+				@param	videoOptions		JSON object describing the video texture, see SdlIoController::LoadVideoTextures.
+				@param	running				Limits the number of machines emulating at once.
+				@param	framesPerStep		The number of video frames to run for in each step.
+				@param	observation			Where to copy the observation at the end of each step, observationSize_ bytes.
+
+				@throw	std::invalid_argument when framesPerStep is zero or the observation is too small.
+			*/
+			BatchIoController(const std::shared_ptr<MemoryController>& memoryController, const nlohmann::json& videoOptions, std::counting_semaphore<>& running, uint32_t framesPerStep, std::span<uint8_t> observation);
+
+			/** IController Read override
+
+				Port 1 and 2 return the inputs of the current step.
+
+				@param	port	The device to read from.
+
+				@return	int		A bitfield indicating the action to take.
+			*/
+			uint8_t Read(uint16_t port) final;
+
+			/** IController write override
+
+				Forward the write to the hardware, any audio generated is discarded.
+
+				@param	port	The output device to write to.
+				@param	data	A bitfield indicating what data to write.
+			*/
+			void Write(uint16_t port, uint8_t data) final;
+
+			/** IController::ServiceInterrupts override
+
+				Copy the observation and wait for the next step once the step's frames have been generated.
+
+				@param	currTime	The current CPU run time in nanoseconds.
+				@param	cycles		The number of CPU cycles completed.
+			*/
+			MachEmu::ISR ServiceInterrupts(uint64_t currTime, uint64_t cycles) final;
+
+			/**	Uuid
+
+				Unique universal identifier for this controller.
+
+				@return					The uuid as a 16 byte array.
+			*/
+			std::array<uint8_t, 16> Uuid() const final;
+
+			/** Go
+
+				Start the next step.
+
+				@param	inputPorts	The port 1 (low byte) and port 2 (high byte) input bitfields to hold for the step,
+									see SdlIoController for the bit assignments.
+
+				@remark		Only call this once the previous step is done.
+			*/
+			void Go(uint16_t inputPorts);
+
+			/** Wait until done
+
+				Block until the current step (or the first step, which starts when the machine is run) is done.
+			*/
+			void WaitUntilDone();
+
+			/** Quit
+
+				Stop the machine instead of starting the next step.
+
+				@remark		Only call this once the previous step is done.
+			*/
+			void Quit();
+	};
+} // namespace i8080_arcade
+
+#endif // BATCH_IO_CONTROLLER_H
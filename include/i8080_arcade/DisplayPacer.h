@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef DISPLAY_PACER_H
+#define DISPLAY_PACER_H
+
+#include <cstdint>
+#include <string>
+
+namespace i8080_arcade
+{
+	/** Display pacer
+
+		Aligns the presentation of video frames with the refresh of the display. The refresh
+		interval is measured from the times vsynced presents return, starting from the nominal
+		interval reported by the display, so that panels which don't refresh at exactly their
+		nominal rate are paced correctly.
+
+		The judder of each new frame, how far the time it spent on screen differs from the
+		interval it was emulated at, is reported in every mode so the modes can be compared.
+
+		@remark		Not thread safe, it is used from the render thread only.
+	*/
+	class DisplayPacer final
+	{
+		public:
+			/** Mode
+
+				How presents are paced.
+			*/
+			enum class Mode
+			{
+				Off,		/**< Frames are presented as soon as they are dequeued without waiting for vsync. */
+				LowLatency,	/**< The newest frame is presented just before the next vblank. */
+				Smooth		/**< One frame is kept queued so that there is a frame ready at every vblank, at the cost of a frame of latency. */
+			};
+
+		private:
+			/** Present margin
+
+				How long before the vblank a low latency present is made, on top of the time it takes
+				to prepare the frame, in nanoseconds.
+			*/
+			static constexpr int64_t presentMargin_{ 2000000 };
+
+			/** Mode
+
+				How presents are paced.
+			*/
+			Mode mode_{};
+
+			/** Frame interval
+
+				The interval new frames are produced at in nanoseconds.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t frameInterval_{};
+
+			/** Refresh interval
+
+				The measured refresh interval of the display in nanoseconds.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t refreshInterval_{};
+
+			/** Nominal refresh interval
+
+				The refresh interval reported by the display in nanoseconds.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t nominalRefreshInterval_{};
+
+			/** Prepare time
+
+				A moving average of the time taken to upload and render a frame before it is presented.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t prepareTime_{};
+
+			/** Last vblank time
+
+				When the last vsynced present returned, 0 before the first.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t lastVblankTime_{};
+
+			/** Last frame time
+
+				When the last new frame was presented, 0 before the first.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t lastFrameTime_{};
+
+		public:
+			/** Initialisation constructor
+
+				@param	mode			How presents are paced.
+				@param	frameInterval	The interval new frames are produced at in nanoseconds, it is also the refresh
+										interval until one is set.
+			*/
+			DisplayPacer(Mode mode, int64_t frameInterval);
+
+			/** Parse a mode
+
+				@param	mode	"off", "low-latency" or "smooth".
+
+				@return			The mode.
+
+				@throw	std::invalid_argument when the mode is not recognised.
+			*/
+			static Mode ParseMode(const std::string& mode);
+
+			/** Get the mode
+
+				@return		How presents are paced.
+			*/
+			Mode GetMode() const;
+
+			/** Set the refresh interval
+
+				Seed the measured refresh interval with the nominal interval reported by the display.
+
+				@param	refreshInterval		The nominal refresh interval in nanoseconds, ignored when not positive.
+			*/
+			void SetRefreshInterval(int64_t refreshInterval);
+
+			/** Refresh interval
+
+				@return		The measured refresh interval of the display in nanoseconds.
+			*/
+			int64_t RefreshInterval() const;
+
+			/** Nominal refresh interval
+
+				@return		The refresh interval reported by the display in nanoseconds.
+			*/
+			int64_t NominalRefreshInterval() const;
+
+			/** Present deadline
+
+				@param	now		The current time.
+
+				@return			When to start preparing the frame so that it is presented just before the next vblank
+								it can make in low latency mode, now in the other modes.
+			*/
+			int64_t PresentDeadline(int64_t now) const;
+
+			/** Prepared
+
+				@param	prepareTime		The time taken to upload and render the frame which is about to be presented.
+			*/
+			void Prepared(int64_t prepareTime);
+
+			/** Presented
+
+				Call once the present has returned.
+
+				@param	presentedTime	When the present returned.
+				@param	newFrame		Whether a new frame was presented rather than the last one redrawn.
+
+				@return					The judder of a new frame in nanoseconds, -1 when there is none to report:
+										the frame was not new, it is the first or the frames were interrupted.
+			*/
+			int64_t Presented(int64_t presentedTime, bool newFrame);
+	};
+} // namespace i8080_arcade
+
+#endif // DISPLAY_PACER_H
@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace i8080_arcade
+{
+	/** Frame timing
+
+		Latency histograms for each stage of a video frame's trip from the render interrupt to the screen,
+		and of a sound's trip from the port write to the audio device.
+
+		Each histogram is log-linear (HDR style): values are bucketed by their most significant bit
+		with 8 linear sub-buckets per power of two, so any recorded value is reported to within 12.5%.
+		Recording is a couple of relaxed atomic increments, the machine and main threads can record
+		and summarise concurrently without locking.
+	*/
+	class FrameTiming final
+	{
+		public:
+			/** Stage
+
+				The stages a video frame (or sound) passes through.
+			*/
+			enum class Stage
+			{
+				Copy,		/**< The render interrupt was raised until video ram was copied into a frame. */
+				Queue,		/**< Video ram was copied until the main thread dequeued the frame. */
+				Blit,		/**< The frame was uploaded to the texture. */
+				PostProcess,	/**< The frame was post processed into the texture, part of the blit stage. */
+				Present,	/**< The texture was rendered until SDL_RenderPresent returned. */
+				Total,		/**< The render interrupt was raised until SDL_RenderPresent returned. */
+				Audio,		/**< A sound was triggered until the audio device was handed the buffer it starts in. */
+				Judder,		/**< How far the time a new frame was on screen differed from the interval it was emulated at. */
+				Count
+			};
+
+			/** Summary
+
+				The latency percentiles of one stage in nanoseconds.
+			*/
+			struct Summary
+			{
+				uint64_t count{};	/**< The number of latencies recorded. */
+				int64_t p50{};		/**< The median latency. */
+				int64_t p99{};		/**< The 99th percentile latency. */
+				int64_t max{};		/**< The largest latency. */
+			};
+
+		private:
+			/** Sub-bucket bits
+
+				Each power of two is divided into 2^subBucketBits linear buckets.
+			*/
+			static constexpr int subBucketBits_{ 3 };
+
+			/** Bucket count
+
+				Enough buckets to hold any non negative 64 bit value.
+			*/
+			static constexpr size_t bucketCount_{ (64 - subBucketBits_ + 1) << subBucketBits_ };
+
+			/** Histogram
+
+				The bucket counts and exact maximum of one stage.
+			*/
+			struct Histogram
+			{
+				std::array<std::atomic<uint64_t>, bucketCount_> buckets{};	/**< The number of latencies in each bucket. */
+				std::atomic<uint64_t> count{};								/**< The number of latencies recorded. */
+				std::atomic<int64_t> max{};									/**< The largest latency recorded. */
+			};
+
+			/** Histograms
+
+				One histogram per stage.
+			*/
+			std::array<Histogram, static_cast<size_t>(Stage::Count)> histograms_{};
+
+			/** Bucket
+
+				@param	value	The latency in nanoseconds.
+
+				@return			The index of the bucket holding the value.
+			*/
+			static size_t Bucket(uint64_t value);
+
+			/** Bucket upper bound
+
+				@param	bucket	The index of a bucket.
+
+				@return			The largest value held by the bucket.
+			*/
+			static int64_t BucketUpperBound(size_t bucket);
+
+		public:
+			/** Now
+
+				@return		The steady clock time in nanoseconds, the timestamp all stages are measured with.
+			*/
+			static int64_t Now();
+
+			/** Stage name
+
+				@param	stage	The stage to name.
+
+				@return			The name of the stage.
+			*/
+			static const char* StageName(Stage stage);
+
+			/** Record
+
+				@param	stage	The stage the latency was measured for.
+				@param	latency	The latency in nanoseconds, negative latencies are recorded as 0.
+			*/
+			void Record(Stage stage, int64_t latency);
+
+			/** Summarise
+
+				@param	stage	The stage to summarise.
+
+				@return			The percentiles of all the latencies recorded for the stage so far.
+			*/
+			Summary Summarise(Stage stage) const;
+
+			/** Print summary
+
+				Print a table of the percentiles of every stage.
+			*/
+			void PrintSummary() const;
+	};
+} // namespace i8080_arcade
+
+#endif // FRAME_TIMING_H
@@ -0,0 +1,294 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef HEADLESS_IO_CONTROLLER_H
+#define HEADLESS_IO_CONTROLLER_H
+
+#include <chrono>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+#include "meen_hw/MH_Factory.h"
+#include "i8080_arcade/InputLog.h"
+#include "i8080_arcade/MemoryController.h"
+#include "i8080_arcade/MidwayPorts.h"
+#include "i8080_arcade/VideoRecorder.h"
+
+namespace i8080_arcade
+{
+	/** Custom headless io controller.
+
+		A custom io controller targetting Space Invaders i8080 arcade hardware compatible ROMs
+		that requires no window, renderer or audio device. Video frames are still taken from the
+		memory controller so the cost of doing so is reflected in any measurements taken.
+	*/
+	class HeadlessIoController final : public MachEmu::IController
+	{
+		public:
+			/** Statistics
+
+				Throughput measurements taken over the lifetime of the run.
+			*/
+			struct Statistics
+			{
+				uint64_t frames{};			/**< The number of video frames generated. */
+				uint64_t cycles{};			/**< The number of emulated CPU cycles completed. */
+				uint64_t emulatedTime{};	/**< The emulated CPU run time in nanoseconds. */
+				uint64_t wallTime{};		/**< The real time in nanoseconds taken to emulate the above. */
+				uint64_t frameHash{};		/**< The video ram hash at the last frame, see MemoryController::VramHash. */
+			};
+
+		private:
+			/**	i8080_arcade
+
+				The hardware emulator.
+			*/
+			std::unique_ptr<meen_hw::MH_II8080ArcadeIO> i8080ArcadeIO_;
+
+			/** Ports
+
+				The port map, inline or forwarded to the hardware emulator depending on the build.
+			*/
+			ArcadePorts ports_;
+
+			/** i8080 arcade memory
+
+				Holds the underlying memory and vram frame pool.
+			*/
+			std::shared_ptr<MemoryController> memoryController_;
+
+			/** Frame limit
+
+				The number of video frames to generate before the machine is asked to quit.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t frameLimit_{};
+
+			/** Triple buffering
+
+				When true video frames are published via the memory controller triple buffer,
+				otherwise they are copied from its frame pool.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool tripleBuffering_{};
+
+			/** Input log
+
+				When set the input ports are replayed from it.
+			*/
+			std::shared_ptr<InputLog> inputLog_;
+
+			/** Video recorder
+
+				When set each video frame is queued to it.
+			*/
+			std::shared_ptr<VideoRecorder> videoRecorder_;
+
+			/** Input script
+
+				When set, and no input log is being replayed, the input ports are latched from it at each render interrupt.
+			*/
+			std::function<uint16_t(uint64_t frame)> inputScript_;
+
+			/** Checkpoint interval
+
+				The number of frames between checkpoints, 0 when the frames are not hashed.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t checkpointInterval_{};
+
+			/** Frame hash chain
+
+				The video ram hash of every frame so far folded into one.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t frameHashChain_{};
+
+			/** Checkpoints
+
+				The frame hash chain at the end of each checkpoint interval.
+			*/
+			std::vector<uint64_t> checkpoints_;
+
+			/** Save every frame
+
+				When true the machine is asked to save its state after each render interrupt, in the same
+				way as the SDL controller takes rewind snapshots.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool saveEveryFrame_{};
+
+			/** Save pending
+
+				Set at each render interrupt when saving every frame, the save is requested at the next interrupt check.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool savePending_{};
+
+			/** Latched input ports
+
+				The port 1 (low byte) and port 2 (high byte) values replayed at the last render interrupt.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint16_t latchedInputPorts_{ 0x0008 };
+
+			/** Start time
+
+				The real time at which the first interrupt was serviced.
+			*/
+			std::chrono::steady_clock::time_point startTime_{};
+
+			/** Statistics
+
+				Updated from the machine thread, only safe to read once the machine has completed.
+			*/
+			Statistics statistics_{};
+
+		public:
+			/** Initialisation constructor
+
+				Creates a headless i8080 arcade IO controller.
+
+				@param	memoryController	The memory controller from which to take video frames.
+				@param	frameLimit			The number of video frames to generate before quitting.
+				@param	videoHardware		JSON object describing the video hardware, only "frame-buffering" is used.
+			*/
+			HeadlessIoController(const std::shared_ptr<MemoryController>& memoryController, uint64_t frameLimit, const nlohmann::json& videoHardware);
+
+			/** IController Read override
+
+				There is no user input, port 1 and 2 read as if no keys are held unless an input log is being replayed.
+
+				@param	port	The device to read from.
+
+				@return	int		A bitfield indicating the action to take.
+			*/
+			uint8_t Read(uint16_t port) final;
+
+			/** IController write override
+
+				Forward the write to the hardware, any audio generated is discarded.
+
+				@param	port	The output device to write to.
+				@param	data	A bitfield indicating what data to write.
+			*/
+			void Write(uint16_t port, uint8_t data) final;
+
+			/** IController::ServiceInterrupts override
+
+				Take a video frame from the memory controller on each render interrupt and
+				quit the machine once the frame limit has been reached.
+
+				@param	currTime	The current CPU run time in nanoseconds.
+				@param	cycles		The number of CPU cycles completed.
+			*/
+			MachEmu::ISR ServiceInterrupts(uint64_t currTime, uint64_t cycles) final;
+
+			/**	Uuid
+
+				Unique universal identifier for this controller.
+
+				@return					The uuid as a 16 byte array.
+			*/
+			std::array<uint8_t, 16> Uuid() const final;
+
+			/** Set the video options
+
+				Configure the hardware video options so that the headless run matches a windowed one.
+
+				@param	videoOptions	JSON object describing the video texture.
+			*/
+			void SetVideoOptions(const nlohmann::json& videoOptions);
+
+			/** Get the run statistics
+
+				@return		The statistics gathered by the machine thread.
+
+				@remark		Only call this once the machine has completed.
+			*/
+			Statistics GetStatistics() const;
+
+			/** Set the input log
+
+				Replay the inputs of a recorded log, the input ports are latched from it at each render interrupt.
+
+				@param	inputLog	The log to replay.
+
+				@remark		Must be called before the machine is run. The frame limit should be the length of the log.
+			*/
+			void SetInputLog(const std::shared_ptr<InputLog>& inputLog);
+
+			/** Set the video recorder
+
+				Record each video frame to a video, the machine waits for the writer when it falls behind.
+
+				@param	videoRecorder	The recorder to queue the frames to.
+
+				@remark		Must be called before the machine is run.
+			*/
+			void SetVideoRecorder(const std::shared_ptr<VideoRecorder>& videoRecorder);
+
+			/** Set the input script
+
+				Drive the input ports from a function of the frame number rather than leaving them idle.
+
+				@param	inputScript		Returns the port 1 (low byte) and port 2 (high byte) values to hold for
+										the frame number it is passed, the first frame is frame 0.
+
+				@remark		Must be called before the machine is run. An input log takes precedence.
+			*/
+			void SetInputScript(std::function<uint16_t(uint64_t frame)> inputScript);
+
+			/** Set the checkpoint interval
+
+				Hash video ram at every frame, see MemoryController::VramHash, and fold the hashes into a chain
+				which is checkpointed at a fixed interval. Two runs take the same path up to the first
+				checkpoint that differs.
+
+				@param	checkpointInterval	The number of frames between checkpoints, 0 to stop hashing.
+
+				@remark		Must be called before the machine is run.
+			*/
+			void SetCheckpointInterval(uint64_t checkpointInterval);
+
+			/** Set save every frame
+
+				Ask the machine to save its state once per frame, the cost of a rewind snapshot is then part of the measurements.
+
+				@param	saveEveryFrame	true to save every frame.
+
+				@remark		Must be called before the machine is run. The machine OnSave handler receives the saves.
+			*/
+			void SetSaveEveryFrame(bool saveEveryFrame);
+
+			/** Get the checkpoints
+
+				@return		The frame hash chain at the end of each checkpoint interval.
+
+				@remark		Only call this once the machine has completed.
+			*/
+			const std::vector<uint64_t>& GetCheckpoints() const;
+	};
+} // namespace i8080_arcade
+
+#endif // HEADLESS_IO_CONTROLLER_H
@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "i8080_arcade/MappedFile.h"
+
+namespace i8080_arcade
+{
+	/** Input log
+
+		Records the input ports latched at each render interrupt so that a run can be replayed
+		exactly. Inputs only change at frame boundaries while a log is recorded or replayed,
+		so the same log drives the machine down the same path on every build.
+
+		The file starts with a 32 byte header: the magic "i8080inp", a u16 version, a u16 and
+		a u32 reserved, the u64 number of frames recorded and the u64 video ram hash at the
+		last frame (all little endian). Each change to port 1 or 2 follows as the LEB128
+		number of frames since the previous change, the port number and the new port value.
+
+		A recorded log is written by Save once the machine has completed, a replayed log is
+		memory mapped and decoded a frame at a time.
+	*/
+	class InputLog final
+	{
+		private:
+			/** Recorded entries
+
+				The encoded changes of a log being recorded.
+			*/
+			std::vector<uint8_t> entries_;
+
+			/** Mapped file
+
+				The log being replayed, empty when recording.
+			*/
+			MappedFile mappedFile_;
+
+			/** Position
+
+				The offset in the mapped file of the next change to replay.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t position_{};
+
+			/** Next change frame
+
+				The frame of the next change to replay.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t nextFrame_{};
+
+			/** Frame
+
+				The number of frames latched so far.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t frame_{};
+
+			/** Last change frame
+
+				The frame of the last change recorded.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t lastFrame_{};
+
+			/** Frames
+
+				The number of frames in the log being replayed.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t frames_{};
+
+			/** Recorded frame hash
+
+				The video ram hash at the last frame of the log being replayed.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t recordedFrameHash_{};
+
+			/** Frame hash
+
+				The video ram hash at the last frame latched, as set by SetFrameHash.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t frameHash_{};
+
+			/** Input ports
+
+				The port 1 (low byte) and port 2 (high byte) values as of the last frame latched.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint16_t inputPorts_{ 0x0008 };
+
+			/** Read the next change frame
+
+				Decode the frame delta of the next change, the end of the log reads as a frame which is never reached.
+			*/
+			void ReadNextFrame();
+
+		public:
+			/** Log version
+
+				The version written to the header of a recorded log.
+			*/
+			static constexpr uint16_t version_{ 1 };
+
+			/** Default constructor
+
+				Create an empty log to record to.
+			*/
+			InputLog() = default;
+
+			/** Replay constructor
+
+				Memory map a recorded log to replay.
+
+				@param	path	The log file to replay.
+
+				@throw	std::runtime_error when the file can't be opened or is not a valid input log.
+			*/
+			explicit InputLog(const std::filesystem::path& path);
+
+			/** Replaying
+
+				@return		true if the log is being replayed, false if it is being recorded.
+			*/
+			bool Replaying() const;
+
+			/** Latch
+
+				Advance to the next frame, called at each render interrupt.
+
+				@param	inputPorts	The live port 1 (low byte) and port 2 (high byte) values, recorded when they change.
+									They are ignored when replaying.
+
+				@return				The port values to hold until the next frame.
+			*/
+			uint16_t Latch(uint16_t inputPorts);
+
+			/** Finished
+
+				@return		true once every frame of a log being replayed has been latched.
+			*/
+			bool Finished() const;
+
+			/** Frame
+
+				@return		The number of frames latched so far.
+			*/
+			uint64_t Frame() const;
+
+			/** Frames
+
+				@return		The number of frames in the log being replayed.
+			*/
+			uint64_t Frames() const;
+
+			/** Set the frame hash
+
+				@param	frameHash	The video ram hash at the frame just latched, see MemoryController::VramHash.
+			*/
+			void SetFrameHash(uint64_t frameHash);
+
+			/** Frame hash
+
+				@return		The video ram hash set at the last frame latched.
+			*/
+			uint64_t FrameHash() const;
+
+			/** Recorded frame hash
+
+				@return		The video ram hash at the last frame of the log being replayed.
+			*/
+			uint64_t RecordedFrameHash() const;
+
+			/** Save
+
+				Write the recorded log, the file is replaced in full.
+
+				@param	path	The file to write to.
+
+				@throw	std::runtime_error when the file can't be written.
+			*/
+			void Save(const std::filesystem::path& path) const;
+	};
+} // namespace i8080_arcade
+
+#endif // INPUT_LOG_H
@@ -0,0 +1,166 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MACHINE_BATCH_H
+#define MACHINE_BATCH_H
+
+#include <filesystem>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <semaphore>
+#include <span>
+#include <vector>
+
+#include "Machine/MachineFactory.h"
+#include "i8080_arcade/BatchIoController.h"
+
+namespace i8080_arcade
+{
+	/** Machine batch
+
+		Runs a batch of independent instances of the same game in lock step for embedding
+		the emulator in other programs, an agent training loop for example.
+
+		Each call to Step applies one set of inputs per instance, runs every instance for
+		the configured number of frames and returns once all of their observations are
+		available in a single contiguous buffer, one BatchIoController::observationSize_
+		stride per instance.
+
+		Each instance runs on its own machine thread, a shared semaphore limits the
+		number of instances emulating at once to the requested thread count.
+	*/
+	class MachineBatch final
+	{
+		private:
+			/** Instance
+
+				A machine and the controllers it is running with.
+			*/
+			struct Instance
+			{
+				std::unique_ptr<MachEmu::IMachine> machine;				/**< The emulated machine. */
+				std::shared_ptr<BatchIoController> ioController;		/**< The lock step io for the machine. */
+			};
+
+			/** Observations
+
+				The observation of each instance from the last step, contiguous and in instance order.
+			*/
+			std::vector<uint8_t> observations_;
+
+			/** Running
+
+				Limits the number of instances emulating at once.
+			*/
+			std::counting_semaphore<> running_;
+
+			/** Instances
+
+				The machines in the batch.
+			*/
+			std::vector<Instance> instances_;
+
+			/** Frames per step
+
+				The number of video frames each step runs for.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint32_t framesPerStep_{};
+
+			/** Frames
+
+				The number of video frames each instance has run for.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t frames_{};
+
+		public:
+			/** Initialisation constructor
+
+				Create and run the instances, it returns once the observations of the first step
+				(run with no inputs held) are available.
+
+				@param	hardware		JSON object containing the mach-emu options, see the config.json hardware section.
+				@param	software		JSON object containing the video options, see the config.json software section.
+				@param	game			The name of the game in the software section to run.
+				@param	romFilePath		The directory containing the rom files of the game.
+				@param	instances		The number of instances to run.
+				@param	threads			The most instances to emulate at once, 0 uses the number of hardware threads.
+				@param	framesPerStep	The number of video frames each step runs for.
+
+				@throw	std::invalid_argument when there are no instances or framesPerStep is zero.
+				@throw	std::runtime_error when an instance fails to be created.
+			*/
+			MachineBatch(const nlohmann::json& hardware, const nlohmann::json& software, const std::string& game, const std::filesystem::path& romFilePath, size_t instances, size_t threads = 0, uint32_t framesPerStep = 1);
+
+			/** Destructor
+
+				Stop the instances and wait for their machine threads to complete.
+			*/
+			~MachineBatch();
+
+			MachineBatch(const MachineBatch&) = delete;
+			MachineBatch& operator=(const MachineBatch&) = delete;
+
+			/** Size
+
+				@return		The number of instances in the batch.
+			*/
+			size_t Size() const;
+
+			/** Step
+
+				Run every instance for framesPerStep video frames.
+
+				@param	inputPorts	The port 1 (low byte) and port 2 (high byte) input bitfields of each instance,
+									held for the whole step.
+
+				@throw	std::invalid_argument when there is not one set of inputs per instance.
+			*/
+			void Step(std::span<const uint16_t> inputPorts);
+
+			/** Observations
+
+				@return		The video ram followed by the work ram of each instance from the last step,
+							valid until the next call to Step.
+			*/
+			std::span<const uint8_t> Observations() const;
+
+			/** Observation
+
+				@param	instance	The index of the instance.
+
+				@return				The observation of the instance from the last step.
+
+				@throw	std::out_of_range when the instance does not exist.
+			*/
+			std::span<const uint8_t> Observation(size_t instance) const;
+
+			/** Frames
+
+				@return		The number of video frames each instance has run for.
+			*/
+			uint64_t Frames() const;
+	};
+} // namespace i8080_arcade
+
+#endif // MACHINE_BATCH_H
@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace i8080_arcade
+{
+	/** Read only memory mapped file
+
+		Maps the whole of a file into the address space of the process, the contents are
+		paged in by the OS on first access rather than being read up front.
+	*/
+	class MappedFile final
+	{
+		private:
+			/** Data
+
+				The start of the mapping, nullptr when nothing is mapped.
+			*/
+			//cppcheck-suppress unusedStructMember
+			const uint8_t* data_{};
+
+			/** Size
+
+				The size of the mapping in bytes.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t size_{};
+
+#ifdef _WIN32
+			/** Mapping
+
+				The Win32 file mapping object handle.
+			*/
+			//cppcheck-suppress unusedStructMember
+			void* mapping_{};
+#endif
+
+			/** Unmap
+
+				Release the mapping if there is one.
+			*/
+			void Unmap();
+
+		public:
+			/** Default constructor
+
+				Creates an empty mapping.
+			*/
+			MappedFile() = default;
+
+			/** Initialisation constructor
+
+				@param	path	The file to map.
+
+				@throw	std::runtime_error when the file can't be opened or mapped, or is empty.
+			*/
+			explicit MappedFile(const std::filesystem::path& path);
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile(MappedFile&& other) noexcept;
+			MappedFile& operator=(MappedFile&& other) noexcept;
+
+			/** Destructor
+
+				Unmaps the file.
+			*/
+			~MappedFile();
+
+			/** Data
+
+				@return		The start of the mapped file.
+			*/
+			const uint8_t* Data() const;
+
+			/** Size
+
+				@return		The size of the mapped file in bytes.
+			*/
+			size_t Size() const;
+	};
+} // namespace i8080_arcade
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MAPPED_MEMORY_CONTROLLER_H
+#define MAPPED_MEMORY_CONTROLLER_H
+
+#include <memory>
+#include <nlohmann/json.hpp>
+
+#include "i8080_arcade/MemoryController.h"
+#include "i8080_arcade/MemoryMap.h"
+
+namespace i8080_arcade
+{
+    /** Mapped memory controller
+
+        A memory controller specialised for the memory layout of one game, writes to rom are
+        ignored and only writes to video ram pay for the dirty row tracking. The page table is
+        a compile time constant, so protecting rom costs a test of a constant mask per write
+        rather than a lookup in a table chosen at run time.
+
+        @tparam     Map     The memory map, see MemoryMap.h.
+    */
+    template<typename Map>
+    class MappedMemoryController final : public MemoryController
+    {
+        public:
+            using MemoryController::MemoryController;
+
+            /** Write to controller
+
+                Write 8 bits of data to the specifed 16 bit memory address according to the type of its page.
+                Writes to rom are ignored.
+
+                @see IController::Write for further details.
+            */
+            void Write(uint16_t address, uint8_t value) final
+            {
+                I8080_ARCADE_PROFILE_MEMORY(Write, address);
+
+                // The rom pages are a compile time constant, testing them is a shift and a branch which is rarely taken
+                if (((Map::romPages >> (address >> pageBits)) & 1) != 0)
+                {
+                    // Rom is write protected
+                    return;
+                }
+
+                if (static_cast<uint16_t>(address - vramOffset_) < VideoFrame::rows * VideoFrame::rowBytes)
+                {
+                    WriteVram(address, value);
+                }
+                else
+                {
+                    memory_[address] = value;
+                }
+            }
+    };
+
+    /** Make a memory controller
+
+        Create the memory controller specialised for the memory layout of a game.
+
+        @param      memory          The game's memory section of the config file, the layout is given by its rom files.
+        @param      framePoolSize   The amount of video frames to allocate, see MemoryController.
+
+        @return     A MappedMemoryController when a compile time memory map matches the layout,
+                    otherwise a MemoryController.
+    */
+    std::shared_ptr<MemoryController> MakeMemoryController(const nlohmann::json& memory, int framePoolSize = 1);
+} // namespace i8080_arcade
+
+#endif // MAPPED_MEMORY_CONTROLLER_H
@@ -24,25 +24,73 @@ SOFTWARE.
 #define MEMORY_CONTROLLER_H
 
 #include <array>
+#include <atomic>
 #include <filesystem>
 #include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
+#include <span>
 #include <vector>
 
 #include "Base/Base.h"
 #include "Controller/IController.h"
 #include "meen_hw/MH_ResourcePool.h"
+#include "i8080_arcade/MemoryProfiler.h"
+#include "i8080_arcade/RomPack.h"
+
+// Count a memory access with the memory controller's profiler, it compiles to nothing unless the profiler is built in
+#ifdef I8080_ARCADE_MEMORY_PROFILE
+#define I8080_ARCADE_PROFILE_MEMORY(access, address) memoryProfiler_.Count(MemoryProfiler::Access::access, address)
+#else
+#define I8080_ARCADE_PROFILE_MEMORY(access, address)
+#endif
 
 namespace i8080_arcade
 {
+    /** Video frame
+
+        A copy of the video ram along with the rows that changed since the previous frame.
+    */
+    struct VideoFrame
+    {
+        /** The number of bytes in each row of video ram, each bit is one pixel. */
+        static constexpr size_t rowBytes{ 32 };
+
+        /** The number of rows in the video ram. */
+        static constexpr size_t rows{ 224 };
+
+        /** The video ram bytes. */
+        std::array<uint8_t, rows * rowBytes> vram;
+
+        /** A bitmap of the rows that changed since the previous frame, bit n of word n / 64 for row n. */
+        std::array<uint64_t, (rows + 63) / 64> dirtyRows;
+
+        /** The frame sequence number, the first frame generated is sequence number 1. */
+        uint64_t sequence;
+
+        /** The steady clock time in nanoseconds the render interrupt was raised, 0 when the frame is not timed. */
+        int64_t interruptTime;
+
+        /** The steady clock time in nanoseconds the video ram was copied, 0 when the frame is not timed. */
+        int64_t copiedTime;
+    };
+
+    /** Video frame pointer
+
+        A video frame taken from the memory controller frame pool, it returns to the pool when destroyed.
+    */
+    using VideoFramePtr = meen_hw::MH_ResourcePool<VideoFrame>::ResourcePtr;
+
 	/** Custom memory controller.
 
 		A custom memory controller targetting Space Invaders arcade hardware compatible ROMs.
+
+		The whole address space is writable, see MappedMemoryController for a controller which
+		follows the memory layout of a specific game.
 	*/
-	class MemoryController final : public MachEmu::IController
+	class MemoryController : public MachEmu::IController
 	{
-        private:
+        protected:
             /** Memory size
 
                 The size in bytes of the memory.
@@ -56,11 +104,108 @@ namespace i8080_arcade
             */
             std::unique_ptr<uint8_t[]> memory_;
 
+            /** VRAM offset
+
+                The address of the first byte of video ram.
+            */
+            static constexpr uint16_t vramOffset_{ 0x2400 };
+
+            /** Write to video ram
+
+                Write a byte of video ram, marking its row as dirty when the value changes.
+
+                @param      address     The address of the byte, it must lie within video ram.
+                @param      value       The value to write.
+            */
+            void WriteVram(uint16_t address, uint8_t value)
+            {
+                if (memory_[address] != value)
+                {
+                    auto row = static_cast<uint16_t>(address - vramOffset_) / VideoFrame::rowBytes;
+                    dirtyRows_[row >> 6] |= uint64_t{1} << (row & 63);
+                    memory_[address] = value;
+                }
+            }
+
+#ifdef I8080_ARCADE_MEMORY_PROFILE
+            /** Memory profiler
+
+                Counts the reads and writes of each address, see I8080_ARCADE_PROFILE_MEMORY.
+            */
+            MemoryProfiler memoryProfiler_;
+#endif
+
+        private:
+
             /** VRAM frame pool
 
                 A pool of recyclable video frames.
             */
-            meen_hw::MH_ResourcePool<std::array<uint8_t, 7168>> framePool_;
+            meen_hw::MH_ResourcePool<VideoFrame> framePool_;
+
+            /** Dirty rows
+
+                The rows of video ram written with a new value since the last video frame was taken.
+            */
+            std::array<uint64_t, 4> dirtyRows_{};
+
+            /** Dirty row history
+
+                The dirtyRows_ of the most recent frames indexed by frame sequence number, used to
+                bring a recycled frame up to date by copying only the rows that changed since
+                it was last filled.
+            */
+            std::array<std::array<uint64_t, 4>, 8> dirtyRowHistory_{};
+
+            /** Frame sequence
+
+                The sequence number of the last video frame taken.
+            */
+            //cppcheck-suppress unusedStructMember
+            uint64_t frameSequence_{};
+
+            /** Triple buffered video frames
+
+                The back, middle and front frames used by PublishVideoFrame and AcquireVideoFrame.
+            */
+            std::array<VideoFrame, 3> videoFrames_{};
+
+            /** Back frame
+
+                The index of the video frame filled by the machine thread.
+            */
+            //cppcheck-suppress unusedStructMember
+            uint8_t backFrame_{ 0 };
+
+            /** Middle frame
+
+                The index of the most recently published video frame, the freshFrame_ bit is set
+                while it has not been acquired. Exchanged between the machine and render threads.
+            */
+            std::atomic<uint8_t> middleFrame_{ 1 };
+
+            /** Front frame
+
+                The index of the video frame being read by the render thread.
+            */
+            //cppcheck-suppress unusedStructMember
+            uint8_t frontFrame_{ 2 };
+
+            /** Fresh frame
+
+                Set on middleFrame_ when it holds a frame that has not been acquired.
+            */
+            static constexpr uint8_t freshFrame_{ 0x04 };
+
+            /** Fill a video frame
+
+                Bring the video frame up to date with the video ram, only the rows which
+                changed since the frame was last filled are copied.
+
+                @param      frame           The video frame to fill.
+                @param      interruptTime   The time the render interrupt was raised, 0 if the frame is not timed.
+            */
+            void FillVideoFrame(VideoFrame& frame, int64_t interruptTime);
 
         public:
             /** Constructor
@@ -86,10 +231,50 @@ namespace i8080_arcade
             /** Get a copy of the current video ram
 
                 The VideoFrame containing the current video ram is taken from a finite frame pool.
+                Only the rows that changed since the frame was last taken from the pool are copied.
 
-                @return         The current video ram as a recyclable resource.
+                @param          interruptTime   The steady clock time in nanoseconds the render interrupt was raised,
+                                                0 if the frame is not being timed, see FrameTiming.
+
+                @return         The current video ram as a recyclable resource, nullptr if the pool is empty.
+
+                @remark         Must be called from the same thread as Write.
             */
-            meen_hw::MH_ResourcePool<std::array<uint8_t, 7168>>::ResourcePtr GetVideoFrame() const;
+            VideoFramePtr GetVideoFrame(int64_t interruptTime = 0);
+
+            /** Publish the current video ram
+
+                Triple buffered alternative to GetVideoFrame which never runs out of frames.
+                The back frame is brought up to date (only changed rows are copied) and atomically
+                swapped with the middle frame, overwriting it if it was never acquired.
+
+                @param          interruptTime   The steady clock time in nanoseconds the render interrupt was raised,
+                                                0 if the frame is not being timed, see FrameTiming.
+
+                @remark         Must be called from the same thread as Write.
+            */
+            void PublishVideoFrame(int64_t interruptTime = 0);
+
+            /** Acquire the latest published video ram
+
+                Swap the most recently published video frame into the front frame when a new one
+                is available. The render thread reads the front frame in place, it is not copied.
+
+                @return         The front frame which remains valid until the next call to AcquireVideoFrame,
+                                nullptr if no frame has been published.
+
+                @remark         Must be called from a single render thread, it may run concurrently
+                                with PublishVideoFrame.
+            */
+            VideoFrame* AcquireVideoFrame();
+
+            /** Video frame published
+
+                @return         true when a frame has been published which has not yet been acquired.
+
+                @remark         May be called from any thread, the result is a snapshot.
+            */
+            bool VideoFramePublished() const;
 
             /** Load ROM file
 
@@ -102,12 +287,46 @@ namespace i8080_arcade
             */
 		    void LoadRoms(const std::filesystem::path& romFilePath, const nlohmann::json& files);
 
+            /** Load a ROM pack
+
+                Copies the verified roms of a pack into memory at the offsets they were packed with.
+
+                @param      romPack         The rom pack to load, see RomPack.
+
+                @throw      std::length_error when a rom does not fit in memory at its offset.
+            */
+            void LoadRoms(const RomPack& romPack);
+
             /** Memory size
 
                 @return     The size of the memory, in this case 64k.
             */
             size_t Size() const;
 
+            /** Read a block of memory
+
+                Copy a contiguous block of memory without going through the IController interface.
+
+                @param      address     The address of the first byte to copy.
+                @param      dst         Receives the block, its size is the number of bytes to copy.
+
+                @throw      std::out_of_range when the block extends beyond the end of memory.
+
+                @remark     Must be called from the same thread as Write or once the machine has completed.
+            */
+            void ReadBlock(uint16_t address, std::span<uint8_t> dst) const;
+
+            /** Video ram hash
+
+                A 64 bit FNV-1a hash of the current contents of video ram, runs which are driven by
+                the same inputs produce the same hash at the same frame.
+
+                @return     The hash of video ram.
+
+                @remark     Must be called from the same thread as Write or once the machine has completed.
+            */
+            uint64_t VramHash() const;
+
             /** Read from controller
 
                 Reads 8 bits of data from the specifed 16 bit memory address.
@@ -119,10 +338,11 @@ namespace i8080_arcade
             /** Write to controller
 
                 Write 8 bits of data to the specifed 16 bit memory address.
+                Writes which change the value of a byte of video ram mark its row as dirty.
 
                 @see IController::Write for further details.
             */
-            void Write(uint16_t address, uint8_t value) final;
+            void Write(uint16_t address, uint8_t value) override;
 
             /** Service memory interrupts
 
@@ -139,6 +359,16 @@ namespace i8080_arcade
                 @return					The uuid as a 16 byte array.
             */
             std::array<uint8_t, 16> Uuid() const final;
+
+            /** Get the memory profiler
+
+                @return     The profiler counting the memory accesses, nullptr when the memory controller was
+                            built without I8080_ARCADE_MEMORY_PROFILE defined.
+
+                @remark     The counts may be read from any thread, the profiler must only be configured before
+                            the machine is run.
+            */
+            MemoryProfiler* GetMemoryProfiler();
         };
 } // namespace i8080_arcade
 
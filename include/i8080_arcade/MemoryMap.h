@@ -0,0 +1,161 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace i8080_arcade
+{
+    /** Page type
+
+        How the cpu may access a page of memory.
+    */
+    enum class PageType : uint8_t
+    {
+        Ram,    /**< Read and written. */
+        Rom,    /**< Read only, writes are ignored. */
+        Vram    /**< Read and written, writes mark the row of video ram as dirty. */
+    };
+
+    /** Memory region
+
+        A contiguous range of the address space.
+    */
+    struct MemoryRegion
+    {
+        uint32_t offset{};  /**< The address of the first byte of the region. */
+        uint32_t size{};    /**< The size of the region in bytes. */
+    };
+
+    /** Page bits
+
+        Each page is 2^pageBits bytes, small enough that every rom and the video ram
+        of the supported games start and end on a page boundary.
+    */
+    constexpr uint32_t pageBits{ 10 };
+
+    /** Page table
+
+        The type of each page of the 64k address space.
+    */
+    using PageTable = std::array<PageType, ((1 << 16) >> pageBits)>;
+
+    /** Video ram region
+
+        Where video ram lives, it is the same for every supported game.
+    */
+    constexpr MemoryRegion vramRegion{ 0x2400, 0x1C00 };
+
+    /** Make a page table
+
+        Memory is ram unless it is covered by a rom or video ram, a page partly covered by
+        a rom is rom.
+
+        @param  roms    The regions the roms are loaded at.
+
+        @return         The page table of the layout.
+    */
+    constexpr PageTable MakePageTable(std::span<const MemoryRegion> roms)
+    {
+        PageTable pages{};
+        auto mark = [&pages](const MemoryRegion& region, PageType type)
+        {
+            for (auto page = region.offset >> pageBits; region.size > 0 && page <= (region.offset + region.size - 1) >> pageBits && page < pages.size(); page++)
+            {
+                pages[page] = type;
+            }
+        };
+
+        mark(vramRegion, PageType::Vram);
+
+        for (const auto& rom : roms)
+        {
+            mark(rom, PageType::Rom);
+        }
+
+        return pages;
+    }
+
+    /** Page mask
+
+        @param  pages   A page table.
+        @param  type    The type of page to find.
+
+        @return         A bit per page, set when the page is of the type.
+    */
+    constexpr uint64_t PageMask(const PageTable& pages, PageType type)
+    {
+        static_assert(std::tuple_size_v<PageTable> <= 64, "The page mask must hold a bit per page");
+        uint64_t mask = 0;
+
+        for (size_t page = 0; page < pages.size(); page++)
+        {
+            mask |= static_cast<uint64_t>(pages[page] == type) << page;
+        }
+
+        return mask;
+    }
+
+    /** Invaders memory map
+
+        The layout of Space Invaders: 8k of rom at 0x0000 followed by work and video ram.
+    */
+    struct InvadersMemoryMap
+    {
+        /** The rom regions. */
+        static constexpr std::array<MemoryRegion, 1> roms{{ { 0x0000, 0x2000 } }};
+
+        /** The page table built from the rom regions at compile time. */
+        static constexpr PageTable pages{ MakePageTable(roms) };
+
+        /** The rom pages as a bit mask, the form tested on each write. */
+        static constexpr uint64_t romPages{ PageMask(pages, PageType::Rom) };
+    };
+
+    /** Extended memory map
+
+        The layout of the later games: 8k of rom at 0x0000, work and video ram at 0x2000
+        and a further RomSize bytes of rom at 0x4000.
+    */
+    template<uint32_t RomSize>
+    struct ExtendedMemoryMap
+    {
+        /** The rom regions. */
+        static constexpr std::array<MemoryRegion, 2> roms{{ { 0x0000, 0x2000 }, { 0x4000, RomSize } }};
+
+        /** The page table built from the rom regions at compile time. */
+        static constexpr PageTable pages{ MakePageTable(roms) };
+
+        /** The rom pages as a bit mask, the form tested on each write. */
+        static constexpr uint64_t romPages{ PageMask(pages, PageType::Rom) };
+    };
+
+    static_assert(InvadersMemoryMap::pages[0x1FFF >> pageBits] == PageType::Rom && InvadersMemoryMap::pages[0x2000 >> pageBits] == PageType::Ram);
+    static_assert(InvadersMemoryMap::pages[0x2400 >> pageBits] == PageType::Vram && InvadersMemoryMap::pages[0x4000 >> pageBits] == PageType::Ram);
+    static_assert(ExtendedMemoryMap<0x0800>::pages[0x4000 >> pageBits] == PageType::Rom && ExtendedMemoryMap<0x0800>::pages[0x4800 >> pageBits] == PageType::Ram);
+} // namespace i8080_arcade
+
+#endif // MEMORY_MAP_H
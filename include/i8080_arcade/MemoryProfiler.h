@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef MEMORY_PROFILER_H
+#define MEMORY_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+namespace i8080_arcade
+{
+	/** Memory profiler
+
+		Counts the reads and writes of each address of the 64k address space, with the counts
+		summarised per 256 byte page for a heatmap. Reads include instruction fetches, the memory
+		controller interface does not tell them apart.
+
+		The counters are only incremented by the machine thread, they are relaxed atomics so that
+		a heatmap can be drawn from them while the machine runs without the cost of a locked
+		increment. Every access is counted by default, a sample interval counts one access in
+		every interval to reduce the cost further.
+
+		It is only compiled into the memory controller when I8080_ARCADE_MEMORY_PROFILE is defined,
+		see the CMake option of the same name.
+	*/
+	class MemoryProfiler final
+	{
+		public:
+			/** Access
+
+				The kinds of memory access counted.
+			*/
+			enum class Access
+			{
+				Read,	/**< A read, including instruction fetches. */
+				Write	/**< A write, including writes to write protected rom. */
+			};
+
+			/** Page bits
+
+				Each heatmap page is 2^pageBits bytes.
+			*/
+			static constexpr uint32_t pageBits_{ 8 };
+
+			/** Pages
+
+				The number of heatmap pages in the address space.
+			*/
+			static constexpr size_t pages_{ (1 << 16) >> pageBits_ };
+
+		private:
+			/** Counters
+
+				The read and write count of each address, indexed by Access. They wrap after 2^32 accesses.
+			*/
+			std::array<std::array<std::atomic<uint32_t>, 1 << 16>, 2> counters_{};
+
+			/** Sample interval
+
+				One access in this many is counted.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint32_t sampleInterval_{ 1 };
+
+			/** Countdown
+
+				The number of accesses until the next one that is counted.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint32_t countdown_{ 1 };
+
+		public:
+			/** Count an access
+
+				@param	access		The kind of access.
+				@param	address		The address accessed.
+
+				@remark		Must be called from the machine thread only.
+			*/
+			void Count(Access access, uint16_t address)
+			{
+				if (--countdown_ != 0)
+				{
+					return;
+				}
+
+				countdown_ = sampleInterval_;
+				// The only writer, a load and store avoids the cost of an atomic increment
+				auto& counter = counters_[static_cast<size_t>(access)][address];
+				counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+
+			/** Set the sample interval
+
+				@param	sampleInterval	Count one access in this many, 1 counts every access. A prime avoids
+										sampling in step with the loops of the game.
+
+				@throw	std::invalid_argument when the interval is zero.
+
+				@remark		Must be called before the machine is run.
+			*/
+			void SetSampleInterval(uint32_t sampleInterval);
+
+			/** Sample interval
+
+				@return		One access in this many is counted.
+			*/
+			uint32_t SampleInterval() const;
+
+			/** Address count
+
+				@param	access		The kind of access.
+				@param	address		The address.
+
+				@return				The number of accesses of the address counted so far.
+			*/
+			uint32_t AddressCount(Access access, uint16_t address) const;
+
+			/** Page counts
+
+				@param	access		The kind of access.
+
+				@return				The number of accesses of each page counted so far.
+			*/
+			std::array<uint64_t, pages_> PageCounts(Access access) const;
+
+			/** Save
+
+				Write the counts to a file, CSV when its extension is .csv, otherwise JSON.
+
+				The CSV has a row per address which was accessed: the address, its page, its reads and its
+				writes. The JSON has the sample interval, the reads and writes of each page and the reads
+				and writes of each address which was accessed keyed by its hex address.
+
+				@param	path	The file to write, it is replaced if it exists.
+
+				@throw	std::runtime_error when the file can't be written.
+			*/
+			void Save(const std::filesystem::path& path) const;
+	};
+} // namespace i8080_arcade
+
+#endif // MEMORY_PROFILER_H
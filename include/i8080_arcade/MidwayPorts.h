@@ -0,0 +1,259 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef MIDWAY_PORTS_H
+#define MIDWAY_PORTS_H
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "meen_hw/MH_Factory.h"
+
+namespace i8080_arcade
+{
+	/** Midway ports
+
+		An inline implementation of the port map of the Midway 8080 boards that Space Invaders
+		and its compatible ROMs run on: the external shift register (the amount on one port, the
+		data on another and the shifted result read back from a third), the two sound latches
+		and the watchdog. The io controllers call it directly instead of making a virtual call
+		into the meen_hw hardware for every IN and OUT, the hardware is still used for the
+		interrupts and the video.
+
+		The port numbers are template parameters so that boards which wire the shift register and
+		latches to other ports can be described, the defaults are the Space Invaders port map.
+
+		@remark		Not thread safe, it is used from the machine thread only.
+	*/
+	template<uint16_t ShiftAmountPort = 2, uint16_t ShiftResultPort = 3, uint16_t ShiftDataPort = 4, uint16_t SoundPort1 = 3, uint16_t SoundPort2 = 5, uint16_t WatchdogPort = 6>
+	class MidwayPorts final
+	{
+		private:
+			/** Shift register
+
+				The last two bytes written to the shift data port, the newest in the high byte.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint16_t shiftRegister_{};
+
+			/** Shift amount
+
+				How many bits the shift register is shifted left by when it is read, 0 to 7.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint8_t shiftAmount_{};
+
+			/** Sound latches
+
+				The last byte written to each sound port.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint8_t soundLatch1_{};
+			//cppcheck-suppress unusedStructMember
+			uint8_t soundLatch2_{};
+
+			/** Latch
+
+				@param	latch	The sound latch being written.
+				@param	data	The byte written to it.
+
+				@return			The bits which were raised by the write, each starts a sound.
+			*/
+			static uint8_t Latch(uint8_t& latch, uint8_t data)
+			{
+				auto raised = static_cast<uint8_t>(data & ~latch);
+				latch = data;
+				return raised;
+			}
+
+		public:
+			/** Attach
+
+				The native ports keep their own state, they don't use the hardware.
+			*/
+			void Attach(meen_hw::MH_II8080ArcadeIO*)
+			{
+			}
+
+			/** Read port
+
+				@param	port	The port being read.
+
+				@return			The shifted result for the shift result port, 0 for every other port so
+								that the io controller can supply the inputs.
+			*/
+			uint8_t ReadPort(uint16_t port)
+			{
+				if (port == ShiftResultPort)
+				{
+					return static_cast<uint8_t>(shiftRegister_ >> (8 - shiftAmount_));
+				}
+
+				return 0;
+			}
+
+			/** Write port
+
+				@param	port	The port being written.
+				@param	data	The byte written to it.
+
+				@return			The bits raised on a sound port, 0 for every other port.
+			*/
+			uint8_t WritePort(uint16_t port, uint8_t data)
+			{
+				switch (port)
+				{
+					case ShiftAmountPort:
+					{
+						shiftAmount_ = data & 0x07;
+						break;
+					}
+					case ShiftDataPort:
+					{
+						shiftRegister_ = static_cast<uint16_t>((data << 8) | (shiftRegister_ >> 8));
+						break;
+					}
+					case SoundPort1:
+					{
+						return Latch(soundLatch1_, data);
+					}
+					case SoundPort2:
+					{
+						return Latch(soundLatch2_, data);
+					}
+					case WatchdogPort:
+					{
+						// The watchdog resets a board which stops writing to it, a stalled machine is left for the user to quit
+						break;
+					}
+					default:
+					{
+						break;
+					}
+				}
+
+				return 0;
+			}
+	};
+
+	/** meen_hw ports
+
+		Forwards port reads and writes to the meen_hw hardware, it has the same interface as MidwayPorts.
+	*/
+	class MeenHwPorts final
+	{
+		private:
+			/** i8080 arcade hardware
+
+				The hardware the ports are forwarded to, owned by the io controller.
+			*/
+			meen_hw::MH_II8080ArcadeIO* i8080ArcadeIO_{};
+
+		public:
+			/** Attach
+
+				@param	i8080ArcadeIO	The hardware to forward the ports to, it must outlive this object.
+			*/
+			void Attach(meen_hw::MH_II8080ArcadeIO* i8080ArcadeIO)
+			{
+				i8080ArcadeIO_ = i8080ArcadeIO;
+			}
+
+			/** Read port
+
+				@param	port	The port being read.
+
+				@return			The value returned by the hardware.
+			*/
+			uint8_t ReadPort(uint16_t port)
+			{
+				return i8080ArcadeIO_->ReadPort(port);
+			}
+
+			/** Write port
+
+				@param	port	The port being written.
+				@param	data	The byte written to it.
+
+				@return			The value returned by the hardware.
+			*/
+			uint8_t WritePort(uint16_t port, uint8_t data)
+			{
+				return i8080ArcadeIO_->WritePort(port, data);
+			}
+	};
+
+	/** Arcade ports
+
+		The port map used by the io controllers, selected by the I8080_ARCADE_NATIVE_PORTS build option.
+	*/
+#ifdef I8080_ARCADE_NATIVE_PORTS
+	using ArcadePorts = MidwayPorts<>;
+#else
+	using ArcadePorts = MeenHwPorts;
+#endif
+
+	/** Verify ports
+
+		Perform the same random sequence of port reads and writes on a port map and the meen_hw
+		hardware and compare every value returned.
+
+		@param	reference	The meen_hw hardware to compare against, it should be newly created.
+		@param	operations	The number of reads and writes to perform.
+		@param	seed		The seed of the random sequence.
+
+		@return				A description of the first operation which differed, std::nullopt when they all matched.
+	*/
+	template<typename Ports>
+	std::optional<std::string> VerifyPorts(meen_hw::MH_II8080ArcadeIO& reference, uint64_t operations, uint32_t seed = 1)
+	{
+		Ports ports;
+		std::mt19937 random(seed);
+		// Every port the 8080 addresses on the boards, including those with nothing wired to them
+		std::uniform_int_distribution<int> portDist(0, 7);
+		std::uniform_int_distribution<int> dataDist(0, 255);
+
+		ports.Attach(&reference);
+
+		for (uint64_t i = 0; i < operations; i++)
+		{
+			auto port = static_cast<uint16_t>(portDist(random));
+			auto write = (random() & 0x01) != 0;
+			auto data = static_cast<uint8_t>(dataDist(random));
+			auto expected = write == true ? reference.WritePort(port, data) : reference.ReadPort(port);
+			auto actual = write == true ? ports.WritePort(port, data) : ports.ReadPort(port);
+
+			if (actual != expected)
+			{
+				auto operation = write == true ? "OUT " + std::to_string(port) + ", " + std::to_string(data) : "IN " + std::to_string(port);
+				return "operation " + std::to_string(i) + ", " + operation + " returned " + std::to_string(actual) + ", meen_hw returned " + std::to_string(expected);
+			}
+		}
+
+		return std::nullopt;
+	}
+} // namespace i8080_arcade
+
+#endif // MIDWAY_PORTS_H
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PCM_ARENA_H
+#define PCM_ARENA_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** PCM arena
+
+		Every decoded audio sample in one contiguous allocation.
+
+		Each sample starts on a 16 bit boundary so it can be read as 8 or 16 bit PCM in place,
+		the views returned remain valid for the life of the arena.
+	*/
+	class PcmArena final
+	{
+		private:
+			/** Range
+
+				Where a sample lives in the arena.
+			*/
+			struct Range
+			{
+				size_t offset{};	/**< The offset of the sample in bytes. */
+				size_t size{};		/**< The size of the sample in bytes. */
+			};
+
+			/** Data
+
+				The samples back to back, held as 16 bit units to align them.
+			*/
+			std::vector<int16_t> data_;
+
+			/** Ranges
+
+				One range per sample, in the order they were added.
+			*/
+			std::vector<Range> ranges_;
+
+		public:
+			/** Default constructor
+
+				Creates an empty arena.
+			*/
+			PcmArena() = default;
+
+			/** Initialisation constructor
+
+				@param	samples		The PCM of each sample, copied into the arena. An empty entry is an empty sample.
+			*/
+			explicit PcmArena(const std::vector<std::vector<uint8_t>>& samples);
+
+			/** Count
+
+				@return		The number of samples in the arena.
+			*/
+			size_t Count() const;
+
+			/** Size
+
+				@return		The size of the arena in bytes.
+			*/
+			size_t Size() const;
+
+			/** Bytes
+
+				@param	index	The index of the sample.
+
+				@return			The PCM of the sample.
+
+				@throw	std::out_of_range when there is no sample at the index.
+			*/
+			std::span<const uint8_t> Bytes(size_t index) const;
+
+			/** 16 bit PCM
+
+				@param	index	The index of the sample.
+
+				@return			The PCM of the sample as 16 bit samples, a trailing odd byte is excluded.
+
+				@throw	std::out_of_range when there is no sample at the index.
+			*/
+			std::span<const int16_t> Pcm16(size_t index) const;
+	};
+} // namespace i8080_arcade
+
+#endif // PCM_ARENA_H
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PCM_CACHE_H
+#define PCM_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** PCM cache
+
+		An on disk cache of audio samples converted to the output device format.
+
+		Entries are keyed by a hash of the source file contents and the device format, so editing
+		a sample or changing the audio hardware options misses the cache rather than returning
+		stale PCM. Each entry is one file, written to a temporary file and renamed into place so
+		a partially written entry is never read. The cache may be shared by concurrent loaders.
+	*/
+	class PcmCache final
+	{
+		private:
+			/** Version
+
+				The version of the entry format, entries with a different version are ignored.
+			*/
+			static constexpr uint16_t version_{ 1 };
+
+			/** Directory
+
+				The directory holding the entries.
+			*/
+			std::filesystem::path directory_;
+
+			/** Entry path
+
+				@param	key		The key of the entry.
+
+				@return			The file holding the entry.
+			*/
+			std::filesystem::path EntryPath(uint64_t key) const;
+
+		public:
+			/** Initialisation constructor
+
+				@param	directory	The directory to hold the entries, it is created if it does not exist.
+
+				@throw	std::filesystem::filesystem_error when the directory can't be created.
+			*/
+			explicit PcmCache(const std::filesystem::path& directory);
+
+			/** Key
+
+				@param	file		The contents of the source audio file.
+				@param	format		The device sample format.
+				@param	channels	The device channel count.
+				@param	sampleRate	The device sample rate.
+
+				@return				The key of the converted PCM.
+			*/
+			static uint64_t Key(std::span<const uint8_t> file, uint16_t format, uint8_t channels, int sampleRate);
+
+			/** Load
+
+				@param	key		The key of the entry.
+				@param	pcm		Receives the converted PCM on a hit.
+
+				@return			true on a hit, false when there is no entry or it is unreadable.
+			*/
+			bool Load(uint64_t key, std::vector<uint8_t>& pcm) const;
+
+			/** Store
+
+				@param	key		The key of the entry.
+				@param	pcm		The converted PCM.
+
+				@throw	std::runtime_error when the entry can't be written.
+			*/
+			void Store(uint64_t key, std::span<const uint8_t> pcm) const;
+	};
+} // namespace i8080_arcade
+
+#endif // PCM_CACHE_H
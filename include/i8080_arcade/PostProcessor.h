@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef POST_PROCESSOR_H
+#define POST_PROCESSOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "i8080_arcade/VramBlitter.h"
+
+namespace i8080_arcade
+{
+	/** Post processor
+
+		Scales an ARGB8888 frame by a whole number and applies scanline and phosphor persistence
+		effects on the CPU, so that the renderer only has to copy the texture. The rows of the
+		frame are split into bands which are processed in parallel by a small pool of workers and
+		the thread calling Process.
+
+		The per channel arithmetic and the horizontal scaling are performed by a kernel selected at runtime based on the
+		features supported by the CPU, in the same way as the VramBlitter kernels.
+	*/
+	class PostProcessor final
+	{
+		public:
+			/** Options
+
+				The post processing to apply.
+			*/
+			struct Options
+			{
+				int scale{ 1 };			/**< The whole number each dimension of the frame is multiplied by. */
+				double scanlines{};		/**< How much the last row of each scaled row is darkened, 0 (off) to 1 (black), needs a scale of at least 2. */
+				double phosphor{};		/**< How much of the previous frame persists into the next, 0 (off) to 1. */
+				size_t threads{};		/**< The number of threads processing each frame including the calling thread, 0 picks a small number from the hardware threads. */
+
+				/** Enabled
+
+					@return		true when the options change the frame.
+				*/
+				bool Enabled() const;
+			};
+
+			/** Kernel
+
+				A set of functions which operate on each 8 bit channel of ARGB8888 pixels.
+			*/
+			struct Kernel
+			{
+				const char* name;	/**< The name of the kernel: scalar, sse2 or neon. */
+
+				/** Decay each channel of persist by decay / 256 and replace it with the channel of src when that is brighter. */
+				void (*phosphor)(const uint32_t* src, uint32_t* persist, size_t pixels, uint8_t decay);
+
+				/** Multiply the colour channels of src by level / 256 into dst, alpha is copied. */
+				void (*dim)(const uint32_t* src, uint32_t* dst, size_t pixels, uint8_t level);
+
+				/** Repeat each pixel of src scale times into dst, which holds pixels * scale pixels. */
+				void (*upscale)(const uint32_t* src, uint32_t* dst, size_t pixels, int scale);
+			};
+
+		private:
+			/** Job
+
+				The frame being processed.
+			*/
+			struct Job
+			{
+				const uint32_t* src{};			/**< The source frame. */
+				VramBlitter::Region region{};	/**< The region of the source frame to process. */
+				uint8_t* dst{};					/**< The top left pixel of the scaled region. */
+				int pitch{};					/**< The number of bytes between rows of dst. */
+			};
+
+			/** Source dimensions
+
+				The width and height of the source frame in pixels.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int width_{};
+			//cppcheck-suppress unusedStructMember
+			int height_{};
+
+			/** Scale
+
+				The whole number each dimension of the frame is multiplied by.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int scale_{};
+
+			/** Scanline level
+
+				The level the scanline rows are multiplied by, 0 when there are no scanlines.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint8_t scanlineLevel_{};
+
+			/** Phosphor decay
+
+				The level the previous frame is multiplied by, 0 when there is no persistence.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint8_t phosphorDecay_{};
+
+			/** Kernel
+
+				The per channel kernel in use.
+			*/
+			Kernel kernel_{};
+
+			/** Persistence
+
+				The previous output frame at source resolution, the phosphor effect decays it.
+			*/
+			std::vector<uint32_t> persistence_;
+
+			/** Scaled rows
+
+				One horizontally scaled row per band, it is copied to each row of the scaled output.
+			*/
+			std::vector<std::vector<uint32_t>> scaledRows_;
+
+			/** Workers
+
+				Each worker processes one band of every frame, the calling thread processes the first.
+			*/
+			std::vector<std::thread> workers_;
+
+			/** Work synchronisation
+
+				Process publishes the job and bumps the generation under the mutex, each worker
+				processes its band once per generation and the last to finish signals work done.
+			*/
+			std::mutex mutex_;
+			std::condition_variable workReady_;
+			std::condition_variable workDone_;
+			//cppcheck-suppress unusedStructMember
+			uint64_t generation_{};
+			//cppcheck-suppress unusedStructMember
+			size_t bandsPending_{};
+			//cppcheck-suppress unusedStructMember
+			bool stopping_{};
+
+			/** Job
+
+				The frame of the current generation.
+			*/
+			Job job_;
+
+			/** Process a band
+
+				@param	job		The frame being processed.
+				@param	band	The index of the band of rows to process.
+			*/
+			void ProcessBand(const Job& job, size_t band);
+
+		public:
+			/** Initialisation constructor
+
+				@param	width		The width of the source frame in pixels.
+				@param	height		The height of the source frame in pixels.
+				@param	options		The post processing to apply.
+				@param	kernel		The name of the kernel to use, "auto" selects the fastest the CPU supports.
+
+				@throw	std::invalid_argument when an option is out of range or the named kernel is unknown or not supported by the CPU.
+			*/
+			PostProcessor(int width, int height, const Options& options, const std::string& kernel = "auto");
+
+			PostProcessor(const PostProcessor&) = delete;
+			PostProcessor& operator=(const PostProcessor&) = delete;
+
+			/** Destructor
+
+				Stops the workers.
+			*/
+			~PostProcessor();
+
+			/** Width
+
+				@return		The width of the output frame in pixels.
+			*/
+			int Width() const;
+
+			/** Height
+
+				@return		The height of the output frame in pixels.
+			*/
+			int Height() const;
+
+			/** Kernel name
+
+				@return		The name of the kernel in use.
+			*/
+			const char* KernelName() const;
+
+			/** Bands
+
+				@return		The number of bands each frame is split into.
+			*/
+			size_t Bands() const;
+
+			/** Persistent
+
+				@return		true when each frame depends on the previous one, the whole frame must be processed every frame.
+			*/
+			bool Persistent() const;
+
+			/** Scale a region
+
+				@param	region	A region of the source frame.
+
+				@return			The region of the output frame it is scaled to.
+			*/
+			VramBlitter::Region Scale(const VramBlitter::Region& region) const;
+
+			/** Process
+
+				Post process a region of the source frame into the output frame, returns once every band is complete.
+
+				@param	src		The source frame, width * height ARGB8888 pixels.
+				@param	region	The region of the source frame to process, the whole frame when Persistent.
+				@param	dst		The location of the top left pixel of the scaled region.
+				@param	pitch	The number of bytes between rows of dst.
+
+				@remark		Must be called from a single thread.
+			*/
+			void Process(const uint32_t* src, const VramBlitter::Region& region, uint8_t* dst, int pitch);
+
+			/** Available kernels
+
+				@return		The kernels supported by this CPU, the scalar kernel is always first and the fastest last.
+			*/
+			static std::vector<Kernel> AvailableKernels();
+	};
+
+	/** SSE2 post processing kernel
+
+		@return		The SSE2 post processing kernel, std::nullopt if this is not an x86_64 build.
+	*/
+	std::optional<PostProcessor::Kernel> PostProcessSse2Kernel();
+
+	/** NEON post processing kernel
+
+		@return		The NEON post processing kernel, std::nullopt if this build does not target arm.
+
+		@remark		The caller must check the CPU supports NEON before using it.
+	*/
+	std::optional<PostProcessor::Kernel> PostProcessNeonKernel();
+} // namespace i8080_arcade
+
+#endif // POST_PROCESSOR_H
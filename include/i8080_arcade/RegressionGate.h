@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef REGRESSION_GATE_H
+#define REGRESSION_GATE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** Regression gate
+
+		Compares headless runs of each game against golden frame hashes and a throughput baseline.
+
+		Every game is run for the same number of frames under the same scripted inputs. The video
+		ram hash of every frame is folded into a chain which is checkpointed once a second, a run
+		matches its golden run when every checkpoint matches, and the first checkpoint that differs
+		locates the second the emulation diverged in.
+
+		The golden file is shared between hosts, the emulation is deterministic. The baseline file
+		holds the emulated cycles per second of each game on one host, a run fails when it is more
+		than the threshold slower. The games compete for the cores, so the throughput is only
+		compared when the same number of games were run at the same time as when the baseline
+		was recorded. Both files are json and are written by Update.
+	*/
+	class RegressionGate final
+	{
+		public:
+			/** Run
+
+				The results of a headless run of one game.
+			*/
+			struct Run
+			{
+				std::string game;					/**< The name of the game as defined in the config file. */
+				uint64_t frames{};					/**< The number of frames run. */
+				uint64_t cycles{};					/**< The number of emulated CPU cycles completed. */
+				uint64_t wallTime{};				/**< The real time in nanoseconds taken to run the frames. */
+				std::vector<uint64_t> checkpoints;	/**< The frame hash chain at each checkpoint, see HeadlessIoController::SetCheckpointInterval. */
+				size_t concurrency{};				/**< The number of games run at the same time, they compete for the cores. */
+			};
+
+			/** Verdict
+
+				The comparison of a run against the golden and baseline files.
+			*/
+			struct Verdict
+			{
+				bool hasGolden{};					/**< The golden file has hashes for the game at the same number of frames. */
+				int64_t firstMismatchFrame{ -1 };	/**< The last frame of the first checkpoint which differs, -1 when every checkpoint matches. */
+				double cyclesPerSecond{};			/**< The throughput of the run. */
+				double baselineCyclesPerSecond{};	/**< The baseline throughput, 0 when there is none for the game or it was recorded at another concurrency. */
+				size_t baselineConcurrency{};		/**< The number of games run at the same time when the baseline was recorded, 0 when there is none. */
+				bool regressed{};					/**< The run is slower than the baseline by more than the threshold. */
+
+				/** Passed
+
+					@return		true when the golden hashes match and the throughput has not regressed.
+				*/
+				bool Passed() const;
+			};
+
+			/** Checkpoint interval
+
+				The number of frames between checkpoints, one second of emulated time.
+			*/
+			static constexpr uint64_t checkpointInterval_{ 60 };
+
+			/** Skipped exit code
+
+				The --gate exit code when nothing failed but a game has no golden checkpoints or no game
+				could be run, CTest reports the test as skipped (SKIP_RETURN_CODE).
+			*/
+			static constexpr int skippedExitCode_{ 77 };
+
+		private:
+			/** File version
+
+				The version written to the golden and baseline files.
+			*/
+			static constexpr int version_{ 1 };
+
+			/** Golden
+
+				The games section of the golden file, empty when there is no golden file.
+			*/
+			nlohmann::json golden_;
+
+			/** Baseline
+
+				The games section of the baseline file, empty when there is no baseline file.
+			*/
+			nlohmann::json baseline_;
+
+			/** Threshold
+
+				The fraction of the baseline throughput a run may lose before it is a regression.
+			*/
+			//cppcheck-suppress unusedStructMember
+			double threshold_{};
+
+		public:
+			/** Initialisation constructor
+
+				@param	goldenFile		The golden hashes, it need not exist.
+				@param	baselineFile	The throughput baseline of this host, it need not exist.
+				@param	threshold		The fraction of the baseline throughput a run may lose, 0.1 fails a run more than 10% slower.
+
+				@throw	std::invalid_argument when the threshold is not from 0 to 1.
+				@throw	std::runtime_error when a file exists but is not a valid gate file of this version.
+			*/
+			RegressionGate(const std::filesystem::path& goldenFile, const std::filesystem::path& baselineFile, double threshold);
+
+			/** Scripted inputs
+
+				The inputs every game is run with: a coin, a one player start, then the player sweeps
+				left and right while firing.
+
+				@param	frame	The frame number, the first frame is frame 0.
+
+				@return			The port 1 (low byte) and port 2 (high byte) values to hold for the frame.
+			*/
+			static uint16_t ScriptedInputs(uint64_t frame);
+
+			/** Check a run
+
+				@param	run		The run to compare against the golden and baseline files.
+
+				@return			The verdict.
+			*/
+			Verdict Check(const Run& run) const;
+
+			/** Update
+
+				Replace the golden hashes and baseline throughput of each run, the other games in the files are kept.
+
+				@param	runs			The runs to record.
+				@param	goldenFile		The golden file to update.
+				@param	baselineFile	The baseline file to update.
+
+				@throw	std::runtime_error when a file can't be written.
+			*/
+			static void Update(const std::vector<Run>& runs, const std::filesystem::path& goldenFile, const std::filesystem::path& baselineFile);
+	};
+} // namespace i8080_arcade
+
+#endif // REGRESSION_GATE_H
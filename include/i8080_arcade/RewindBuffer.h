@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** Rewind buffer
+
+		A bounded history of machine save states, newest last.
+
+		Snapshots are held in groups: a keyframe stored in full followed by up to keyframeInterval - 1
+		deltas, each the run length encoded XOR of the snapshot with the group keyframe. A save state
+		is split into its payloads (the long string values holding the memory image) and the text
+		around them, and each is XORed with the same segment of the keyframe. A field which changes
+		length, a counter gaining a digit for example, then only misaligns the short text segment it
+		is in rather than the memory image after it. Consecutive frames differ in only a few bytes so
+		a delta is typically a small fraction of a keyframe. The oldest group is evicted whenever the
+		buffer exceeds its memory budget or snapshot limit.
+
+		Push and Pop may be called from different threads.
+	*/
+	class RewindBuffer final
+	{
+		private:
+			/** Group
+
+				A keyframe and the deltas encoded against it.
+			*/
+			struct Group
+			{
+				std::string keyframe;						/**< The keyframe snapshot. */
+				std::vector<std::vector<uint8_t>> deltas;	/**< The snapshots following the keyframe, oldest first. */
+			};
+
+			/** Groups
+
+				The snapshot history, oldest first.
+			*/
+			std::deque<Group> groups_;
+
+			/** Snapshots
+
+				The total number of snapshots held (keyframes and deltas).
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t snapshots_{};
+
+			/** Bytes
+
+				The total size of the keyframes and deltas held.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t bytes_{};
+
+			/** Maximum snapshots
+
+				The most snapshots to hold, 0 disables the buffer.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t maxSnapshots_{};
+
+			/** Budget
+
+				The most bytes of keyframes and deltas to hold.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t budget_{};
+
+			/** Keyframe interval
+
+				The number of snapshots in each group.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t keyframeInterval_{};
+
+			/** Mutex
+
+				Guards all of the above, Push and Pop are called from the machine save and load threads.
+			*/
+			mutable std::mutex mutex_;
+
+			/** Evict
+
+				Drop the oldest groups until the buffer is within its limits, the newest group is always kept.
+			*/
+			void Evict();
+
+		public:
+			/** Initialisation constructor
+
+				@param	maxSnapshots		The most snapshots to hold, 0 disables the buffer.
+				@param	budget				The most bytes of keyframes and deltas to hold.
+				@param	keyframeInterval	The number of snapshots in each group, 1 stores every snapshot as a keyframe.
+
+				@throw	std::invalid_argument when the keyframe interval is zero.
+			*/
+			RewindBuffer(size_t maxSnapshots, size_t budget, size_t keyframeInterval);
+
+			/** Enabled
+
+				@return		true if the buffer holds snapshots, false if it was created with a snapshot limit of 0.
+			*/
+			bool Enabled() const;
+
+			/** Empty
+
+				@return		true if there are no snapshots to rewind to.
+			*/
+			bool Empty() const;
+
+			/** Push
+
+				Add a snapshot to the history.
+
+				@param	snapshot	The nul terminated save state.
+			*/
+			void Push(const char* snapshot);
+
+			/** Pop
+
+				Remove the newest snapshot from the history.
+
+				@param	snapshot	Receives the newest save state.
+
+				@return				true if a snapshot was removed, false if the history is empty.
+			*/
+			bool Pop(std::string& snapshot);
+
+			/** Clear
+
+				Discard the history, after loading a saved game for example.
+			*/
+			void Clear();
+
+			/** Encode a delta
+
+				@param	keyframe	The keyframe to encode against.
+				@param	snapshot	The snapshot to encode.
+
+				@return				The number of segments the snapshot is split into, then for each segment its size
+									followed by the zero run length and literal length (all LEB128) and literals of
+									each run of the segment XOR the same segment of the keyframe.
+			*/
+			static std::vector<uint8_t> EncodeDelta(const std::string& keyframe, const std::string& snapshot);
+
+			/** Decode a delta
+
+				@param	keyframe	The keyframe the delta was encoded against.
+				@param	delta		The delta returned by EncodeDelta.
+
+				@return				The snapshot.
+
+				@throw	std::runtime_error when the delta is corrupt.
+			*/
+			static std::string DecodeDelta(const std::string& keyframe, const std::vector<uint8_t>& delta);
+	};
+} // namespace i8080_arcade
+
+#endif // REWIND_BUFFER_H
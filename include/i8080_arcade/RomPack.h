@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ROM_PACK_H
+#define ROM_PACK_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "i8080_arcade/MappedFile.h"
+
+namespace i8080_arcade
+{
+	/** Rom pack
+
+		All of the rom files of a game in a single file which is memory mapped when loaded.
+
+		The file starts with a header and an index of the roms: the name, load address and size of
+		each along with its CRC32 (the same as is published for arcade rom dumps) and SHA-1. Every
+		rom is verified against both when the pack is opened so a corrupted dump is rejected before
+		it is loaded.
+	*/
+	class RomPack final
+	{
+		public:
+			/** Rom
+
+				One rom in the pack.
+			*/
+			struct Rom
+			{
+				std::string name;				/**< The name of the rom file it was packed from. */
+				uint16_t offset{};				/**< The address the rom is loaded at. */
+				uint32_t crc32{};				/**< The CRC32 of the rom. */
+				std::array<uint8_t, 20> sha1{};	/**< The SHA-1 of the rom. */
+				std::span<const uint8_t> data;	/**< The rom bytes in the mapped pack. */
+			};
+
+		private:
+			/** Version
+
+				The version of the pack format, packs with a newer version are rejected.
+			*/
+			static constexpr uint16_t version_{ 1 };
+
+			/** Mapped file
+
+				The pack file, the roms are read in place.
+			*/
+			MappedFile mappedFile_;
+
+			/** Game
+
+				The name of the game the roms were packed for.
+			*/
+			std::string game_;
+
+			/** Roms
+
+				The roms in the order they were packed.
+			*/
+			std::vector<Rom> roms_;
+
+		public:
+			/** Initialisation constructor
+
+				Map the pack and verify every rom in it.
+
+				@param	path	The rom pack file.
+
+				@throw	std::runtime_error when the file isn't a rom pack, is corrupt or any rom fails its CRC32 or SHA-1 check.
+			*/
+			explicit RomPack(const std::filesystem::path& path);
+
+			/** Path
+
+				@param	romFilePath		The rom files directory.
+				@param	game			The name of the game as defined in the config file.
+
+				@return					The file the roms of the game are packed to.
+			*/
+			static std::filesystem::path Path(const std::filesystem::path& romFilePath, const std::string& game);
+
+			/** Pack
+
+				Pack the rom files of a game.
+
+				@param	romFilePath		The rom files directory.
+				@param	game			The name of the game as defined in the config file.
+				@param	files			The rom files of the game from the config file, each has a name and an offset.
+				@param	path			The rom pack file to write, it is written to a temporary file and renamed into place.
+
+				@throw	std::runtime_error when a rom file can't be read or the pack can't be written.
+				@throw	std::length_error when a rom does not fit in memory at its offset.
+			*/
+			static void Pack(const std::filesystem::path& romFilePath, const std::string& game, const nlohmann::json& files, const std::filesystem::path& path);
+
+			/** CRC32
+
+				@param	data	The bytes to check.
+
+				@return			The CRC32 (IEEE 802.3 polynomial, as used by zip) of the bytes.
+			*/
+			static uint32_t Crc32(std::span<const uint8_t> data);
+
+			/** SHA-1
+
+				@param	data	The bytes to hash.
+
+				@return			The SHA-1 digest of the bytes.
+			*/
+			static std::array<uint8_t, 20> Sha1(std::span<const uint8_t> data);
+
+			/** Game
+
+				@return		The name of the game the roms were packed for.
+			*/
+			const std::string& Game() const;
+
+			/** Roms
+
+				@return		The verified roms, their data remains valid for the life of the pack.
+			*/
+			const std::vector<Rom>& Roms() const;
+
+			/** Check against the config
+
+				The memory map is built from the config, a pack made before the config was edited would load
+				the roms at different offsets or sizes than the map protects.
+
+				@param	game	The name of the game as defined in the config file.
+				@param	files	The rom files of the game from the config file, each has a name, an offset and a size.
+
+				@throw	std::runtime_error when the pack was made for a different game or its roms differ
+						from the files in name, offset, size or order.
+			*/
+			void CheckConfig(const std::string& game, const nlohmann::json& files) const;
+	};
+} // namespace i8080_arcade
+
+#endif // ROM_PACK_H
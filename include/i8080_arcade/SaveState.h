@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "i8080_arcade/MappedFile.h"
+
+namespace i8080_arcade
+{
+	/** Binary save state
+
+		A versioned container for a machine save state, loaded via a memory mapping.
+
+		The file starts with a 16 byte header: the magic "i8080sav", a 16 bit version, a 16 bit section
+		count and 4 reserved bytes. The header is followed by a 40 byte entry for each section: a 32 bit
+		type, a 32 bit compression method, then 64 bit values for the offset of the section data from the
+		start of the file, the stored size, the uncompressed size and the FNV-1a hash of the uncompressed
+		data. All values are little endian. Sections of an unknown type are ignored.
+
+		The machine section holds the mach-emu save state JSON, including the memory it manages, with a
+		terminating nul so an uncompressed section can be handed to the machine straight from the mapping.
+	*/
+	class SaveState final
+	{
+		public:
+			/** Compression
+
+				The compression method applied to a section.
+			*/
+			enum class Compression : uint32_t
+			{
+				None,	/**< The section is stored as is. */
+				Lz		/**< The section is compressed with a byte oriented LZ77 coder, see Compress. */
+			};
+
+			/** Section type
+
+				The type of data held by a section.
+			*/
+			enum class SectionType : uint32_t
+			{
+				Machine = 1		/**< The nul terminated mach-emu save state JSON. */
+			};
+
+			/** Version
+
+				The version of the container written by Save, files with a newer version are rejected.
+			*/
+			static constexpr uint16_t version_{ 1 };
+
+		private:
+			/** Mapped file
+
+				The save state file.
+			*/
+			MappedFile mappedFile_;
+
+			/** Decompressed machine JSON
+
+				Holds the machine JSON and its nul when the machine section is compressed.
+			*/
+			std::string machineJson_;
+
+			/** Machine offset
+
+				The offset of the machine JSON in the mapped file when the machine section is uncompressed.
+			*/
+			//cppcheck-suppress unusedStructMember
+			size_t machineOffset_{};
+
+		public:
+			/** Initialisation constructor
+
+				Map a save state file and validate it.
+
+				@param	path	The save state file to load.
+
+				@throw	std::runtime_error when the file can't be mapped, is not a save state, is a newer
+						version, is truncated, claims an implausible decompressed size, fails its hash
+						check or has no machine section.
+			*/
+			explicit SaveState(const std::filesystem::path& path);
+
+			/** Machine JSON
+
+				@return		The nul terminated mach-emu save state JSON, valid for the lifetime of this object.
+			*/
+			const char* MachineJson() const;
+
+			/** Save
+
+				Write a save state file, the file is written in full alongside the destination and then
+				renamed over it so an existing save is never left half written.
+
+				@param	path			The save state file to write.
+				@param	machineJson		The mach-emu save state JSON.
+				@param	compression		The compression method to apply to the machine section.
+
+				@throw	std::runtime_error when the file can't be written.
+			*/
+			static void Save(const std::filesystem::path& path, std::string_view machineJson, Compression compression);
+
+			/** Parse compression
+
+				@param	compression		"none" or "lz".
+
+				@return					The compression method.
+
+				@throw	std::invalid_argument when the compression method is unknown.
+			*/
+			static Compression ParseCompression(const std::string& compression);
+
+			/** Compress
+
+				Compress a buffer as a series of sequences: a token holding the literal length in the high nibble
+				and the match length (less 4) in the low nibble, the literals, then a 16 bit little endian match
+				offset. A length of 15 continues in the following bytes, each adding up to 255, the literal length
+				before the literals and the match length after the offset. The final sequence holds literals only.
+
+				@param	src		The data to compress.
+				@param	size	The size of the data in bytes.
+
+				@return			The compressed data.
+			*/
+			static std::vector<uint8_t> Compress(const uint8_t* src, size_t size);
+
+			/** Decompress
+
+				@param	src			The data to decompress.
+				@param	size		The size of the compressed data in bytes.
+				@param	dst			Receives the decompressed data.
+				@param	dstSize		The size of the decompressed data in bytes.
+
+				@throw	std::runtime_error when the compressed data is corrupt.
+			*/
+			static void Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize);
+	};
+} // namespace i8080_arcade
+
+#endif // SAVE_STATE_H
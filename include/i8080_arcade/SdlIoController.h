@@ -24,12 +24,26 @@ SOFTWARE.
 #define SDL_IO_CONTROLLER_H
 
 #include <atomic>
+#include <chrono>
+#include <functional>
 #include <nlohmann/json.hpp>
 #include <SDL.h>
 #include <SDL_mixer.h>
 
 #include "meen_hw/MH_Factory.h"
+#include "i8080_arcade/AudioMixer.h"
+#include "i8080_arcade/DisplayPacer.h"
+#include "i8080_arcade/FrameTiming.h"
+#include "i8080_arcade/InputLog.h"
 #include "i8080_arcade/MemoryController.h"
+#include "i8080_arcade/MidwayPorts.h"
+#include "i8080_arcade/PcmArena.h"
+#include "i8080_arcade/PostProcessor.h"
+#include "i8080_arcade/RewindBuffer.h"
+#include "i8080_arcade/SpscRing.h"
+#include "i8080_arcade/Tracer.h"
+#include "i8080_arcade/VideoRecorder.h"
+#include "i8080_arcade/VramBlitter.h"
 
 namespace i8080_arcade
 {
@@ -67,19 +81,76 @@ namespace i8080_arcade
 			*/
 			std::unique_ptr<meen_hw::MH_II8080ArcadeIO> i8080ArcadeIO_;
 
+			/** Ports
+
+				The port map, inline or forwarded to the hardware emulator depending on the build.
+			*/
+			ArcadePorts ports_;
+
 			/** i8080 arcade memory
 
 				Holds the underlying memory and vram frame pool.
 			*/
 			std::shared_ptr<MemoryController> memoryController_;
 
+			/** PCM arena
+
+				Every audio sample converted to the output format, the SDL Mixer chunks and the native mixer refer to it.
+			*/
+			PcmArena pcmArena_;
+
 			/** Audio samples
 
-				The various audio samples to be played.
+				The various audio samples to be played when the SDL Mixer is used.
 			*/
 			//cppcheck-suppress unusedStructMember
 			std::vector<Mix_Chunk*> mixChunk_;
 
+			/** Audio mixer
+
+				The native mixer run from the audio device callback, empty when the SDL Mixer is used.
+			*/
+			std::unique_ptr<AudioMixer> audioMixer_;
+
+			/** Audio device
+
+				The device the audioMixer_ renders to, 0 when the SDL Mixer is used.
+			*/
+			//cppcheck-suppress unusedStructMember
+			SDL_AudioDeviceID audioDevice_{};
+
+			/** Looping samples
+
+				A bit per sample which plays repeatedly for as long as its port bit is held (the ufo),
+				only honoured by the native mixer.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint16_t loopingSamples_{};
+
+			/** Audio port levels
+
+				The last value written to audio ports 3 and 5, used to find when a looping sample's bit is raised and lowered.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			std::array<uint8_t, 2> audioPortLevels_{};
+
+			/** Emulated time
+
+				The CPU run time in nanoseconds at the last call to ServiceInterrupts, audio triggers are timestamped with it.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t emulatedTime_{};
+
+			/** SDL Mixer trigger time
+
+				The wall clock time (see FrameTiming::Now) of the oldest sample played on the SDL Mixer
+				which has not been mixed yet, 0 if there is none. Used to measure the audio latency.
+			*/
+			std::atomic<int64_t> mixTriggerTime_{};
+
 			/** The custom i8080 arcade SDL event type
 
 				Event codes are defined in the EventCode enumeration.
@@ -96,32 +167,203 @@ namespace i8080_arcade
 			*/
 			enum EventCode
 			{
-				RenderVideo,	/**< The next video frame is ready to be rendered. This event drives the control loop */
-				RenderAudio,	/**< Audio is ready to be played. The siEvent data1 type is the index into the mixChunk_ to be played. */
-				ReadInput		/**< Check if there is any input from the user. The siEvent data1 type is the type of input to be checked. */
+				RenderVideo,	/**< The next video frame has been queued on the videoFrameRing_. This event drives the control loop */
+				RenderAudio		/**< Audio is ready to be played on the SDL Mixer. The siEvent data1 is the port in the high byte and the samples in the low byte, data2 is the time the samples were triggered. */
 			};
 
-			/** VideoFrameWrapper
+			/** Render pending
+
+				Set by the machine thread when it pushes a RenderVideo event and cleared by the main thread
+				when it handles it, so at most one is queued. The machine runs at 60Hz, on a display with a
+				slower refresh one event per emulated frame would back up the SDL event queue without bound.
+
+				@remark		This value is set from the machine thread and cleared from the main thread, hence it is atomic.
+			*/
+			std::atomic_bool renderPending_{};
+
+			/** videoFrameRing_
+
+				A bounded queue of video frames passed from the machine thread to the main thread.
+				The machine thread drops (and counts) the frame when the main thread has fallen behind.
+			*/
+			SpscRing<VideoFramePtr> videoFrameRing_;
+
+			/** Triple buffering
+
+				When true video frames are published via the memory controller triple buffer
+				and read in place, otherwise they are copied from its frame pool and queued on
+				the videoFrameRing_.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool tripleBuffering_{};
+
+			/** Blit kernel
+
+				The name of the native blit kernel to use, "auto", "scalar", "sse2", "avx2" or "neon",
+				or "meen-hw" to use the meen-hw blitter.
+			*/
+			std::string blitKernel_;
+
+			/** Pixel format
+
+				The texture pixel format requested for the native blitter, the meen-hw blitter is always RGB332.
+			*/
+			VramBlitter::PixelFormat pixelFormat_{};
+
+			/** Display pacer
+
+				Aligns presents with the display refresh according to the vsync video config option
+				and measures the judder of the frames presented.
+
+				@remark		Only accessed from the main thread.
+			*/
+			DisplayPacer displayPacer_;
+
+			/** Post process options
+
+				The post processing requested by the post-process video config option, it needs the
+				native blitter and forces the ARGB8888 pixel format when enabled.
+			*/
+			PostProcessor::Options postProcessOptions_;
+
+			/** Native blitter
+
+				Blits the changed rows of video ram straight into the texture, nullptr when the meen-hw blitter is in use.
+			*/
+			std::unique_ptr<VramBlitter> blitter_;
+
+			/** Post processor
+
+				Scales the blitted frame into the texture and applies the scanline and phosphor effects,
+				nullptr when post processing is disabled.
+			*/
+			std::unique_ptr<PostProcessor> postProcessor_;
+
+			/** Source frame
+
+				The frame the native blitter blits into when post processing, it is the input of the post processor.
+			*/
+			std::vector<uint32_t> sourceFrame_;
+
+			/** Staging frame
+
+				The frame blitted by the meen-hw blitter, only the rows of it which changed are uploaded to the texture.
+			*/
+			std::vector<uint8_t> stagingFrame_;
+
+			/** Last rendered sequence
+
+				The sequence number of the video frame last uploaded to the texture, 0 if none has been.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t lastRenderedSequence_{};
+
+			/** Frame timing
+
+				The latency histograms of each stage of the video frames presented.
+
+				@remark		The copy stage is recorded by the machine thread, the rest by the main thread.
+			*/
+			FrameTiming frameTiming_;
+
+			/** Show frame timing
+
+				When true the frame timing overlay is drawn over each frame, toggled with the F1 key.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool showFrameTiming_{};
+
+			/** Frame timing title time
+
+				When the window title last showed the frame timing percentiles.
+			*/
+			std::chrono::steady_clock::time_point frameTimingTitleTime_{};
+
+			/** Show memory heatmap
 
-			 	A convenience wrapper used to pass unique pointers through SDL's event structure.
+				When true the memory access heatmap is drawn over each frame, toggled with the F2 key.
 			*/
-			struct VideoFrameWrapper
+			//cppcheck-suppress unusedStructMember
+			bool showMemoryHeatmap_{};
+
+			/** Memory heatmap counts
+
+				The read and write counts of each page when the heatmap was last drawn, so that each
+				drawing shows the accesses since the one before.
+			*/
+			std::array<std::array<uint64_t, MemoryProfiler::pages_>, 2> memoryHeatmapCounts_{};
+
+			/** Row mapping
+
+				Describes where a row of video ram lands in the texture when using the meen-hw blitter: on
+				texture column (or row when columns is false) origin + step * row. Derived from the meen-hw
+				blitter at texture load time so it follows the configured orientation.
+			*/
+			struct RowMapping
 			{
-				meen_hw::MH_ResourcePool<std::array<uint8_t, 7168>>::ResourcePtr videoFrame;
-			};
+				bool valid{};		/**< When false the mapping could not be derived and every frame is uploaded in full. */
+				bool columns{};		/**< When true a video ram row maps to a texture column, otherwise a texture row. */
+				int origin{};		/**< The texture column or row of video ram row 0. */
+				int step{};			/**< The distance between the texture columns or rows of adjacent video ram rows, 1 or -1. */
+			} rowMapping_;
+
+			/** Input ports
 
-			/** videoFrameWrapperPool_
+				The pre-encoded port 1 (low byte) and port 2 (high byte) input bitfields.
 
-				An array of frame wrappers used to pass video frames from the machine thread
-				to the main thread.
+				@remark		Published by the main thread whenever the keyboard state changes and
+							read by the machine thread without waiting, hence it is atomic.
 			*/
-			std::vector<std::unique_ptr<VideoFrameWrapper>> videoFrameWrapperPool_;
+			std::atomic<uint16_t> inputPorts_{ 0x0008 };
 
-			/** videoFrameWrapperMutex_
+			/** Latched input ports
 
-				Video frame mutual exclusion between the main thread and the machine thread.
+				A copy of inputPorts_ taken at each render interrupt when sampling per frame.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			uint16_t latchedInputPorts_{ 0x0008 };
+
+			/** Sample input per frame
+
+				When true the input ports are sampled once per frame at the render interrupt
+				rather than every time they are read. This makes the input seen by the CPU
+				independent of main thread scheduling, which is useful for deterministic runs.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool sampleInputPerFrame_{};
+
+			/** Input log
+
+				When set the input ports latched at each frame are recorded to it, or replayed from it.
+
+				@remark		Only accessed from the machine thread once the machine is running.
 			*/
-			std::mutex videoFrameWrapperMutex_;
+			std::shared_ptr<InputLog> inputLog_;
+
+			/** Video recorder
+
+				When set every emulated frame is queued to it, including frames which are skipped rather than rendered.
+
+				@remark		Only accessed from the machine thread once the machine is running.
+			*/
+			std::shared_ptr<VideoRecorder> videoRecorder_;
+
+			/** Tracer
+
+				When set the machine, event loop and audio threads record their activity to it.
+
+				@remark		Set before the machine is run and the audio device is started, it is only read after that.
+			*/
+			std::shared_ptr<Tracer> tracer_;
+
+			/** On first frame
+
+				Called once when the first video frame has been presented, then cleared.
+
+				@remark		Only accessed from the render thread.
+			*/
+			std::function<void()> onFirstFrame_;
 
 			/** Exit control loop.
 
@@ -145,12 +387,299 @@ namespace i8080_arcade
 			*/
 			std::atomic<MachEmu::ISR> loadSaveInterrupt_{ MachEmu::ISR::NoInterrupt };
 
+			/** Pending state
+
+				The kind of save or load the machine has been asked to perform and which has not yet
+				reached the OnSave or OnLoad handler. Only one is requested at a time so the handlers
+				know whether the state belongs to the user or to the rewind buffer.
+			*/
+			enum class PendingState
+			{
+				None,		/**< No save or load is in flight. */
+				UserSave,	/**< The user asked to save the game. */
+				UserLoad,	/**< The user asked to load the game. */
+				RewindSave,	/**< A per frame snapshot for the rewind buffer. */
+				RewindLoad	/**< A step back to the newest snapshot in the rewind buffer. */
+			};
+
+			/** Pending state
+
+				@see PendingState
+
+				@remark		Set from the machine thread and cleared from the machine save and load threads, hence it is atomic.
+			*/
+			std::atomic<PendingState> pendingState_{ PendingState::None };
+
+			/** Abandoned state
+
+				A pending state which did not reach the OnSave or OnLoad handler in time, see pendingTimeout_.
+				It is still routed correctly if the machine hands it over late.
+
+				@remark		Set from the machine thread and cleared from the machine save and load threads, hence it is atomic.
+			*/
+			std::atomic<PendingState> abandonedState_{ PendingState::None };
+
+			/** Pending frames
+
+				The number of render interrupts since the pending state was requested.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t pendingFrames_{};
+
+			/** Pending timeout
+
+				The number of frames a save or load may be in flight before it is abandoned, the machine may
+				not hand over every request it is given (when it is still busy with an asynchronous one).
+			*/
+			static constexpr uint64_t pendingTimeout_{ 60 };
+
+			/** Rewind buffer
+
+				The per frame snapshot history.
+			*/
+			RewindBuffer rewindBuffer_;
+
+			/** Rewind snapshot
+
+				The snapshot handed to the machine by LoadRewindSnapshot, it must outlive the load.
+
+				@remark		Only accessed from the machine load thread.
+			*/
+			std::string rewindSnapshot_;
+
+			/** Capture rewind
+
+				Set at each render interrupt to request a snapshot for the rewind buffer.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool captureRewind_{};
+
+			/** Rewinding
+
+				Set while the rewind key is held, snapshots are not captured while rewinding.
+
+				@remark		This value is set from the main thread and read from the machine thread, hence it is atomic.
+			*/
+			std::atomic_bool rewinding_{};
+
+			/** Rewind step
+
+				Set by the main thread once per presented frame while rewinding to step back one snapshot.
+
+				@remark		This value is set from the main thread and cleared from the machine thread, hence it is atomic.
+			*/
+			std::atomic_bool rewindStep_{};
+
+			/** Frame interval
+
+				The emulated time between render interrupts, frames are presented no faster than this in real time.
+			*/
+			static constexpr std::chrono::nanoseconds frameInterval_{ 16666667 };
+
+			/** Maximum lag
+
+				How far the machine can drift from the wall clock before pacing restarts from the current
+				time rather than trying to catch up, after a load for example.
+			*/
+			static constexpr std::chrono::milliseconds maxLag_{ 100 };
+
+			/** Speed
+
+				The real time multiplier the machine runs at, 0 runs the machine as fast as possible.
+			*/
+			//cppcheck-suppress unusedStructMember
+			double speed_{ 1.0 };
+
+			/** Fast forward speed
+
+				The real time multiplier the machine runs at while the fast forward key is held, 0 runs the machine as fast as possible.
+			*/
+			//cppcheck-suppress unusedStructMember
+			double fastForwardSpeed_{ 4.0 };
+
+			/** Fast forward
+
+				Set while the fast forward key is held.
+
+				@remark		This value is set from the main thread and read from the machine thread, hence it is atomic.
+			*/
+			std::atomic_bool fastForward_{};
+
+			/** Pacing speed
+
+				The multiplier the machine is currently being paced at, negative until the first interrupt.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			double pacingSpeed_{ -1.0 };
+
+			/** Pacing anchor
+
+				The emulated and wall clock times from which the machine is paced, reset whenever the pacing speed changes.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t anchorTime_{};
+			std::chrono::steady_clock::time_point anchorWallTime_{};
+
+			/** Frame credit
+
+				The fraction of a display interval that has elapsed in real time since the last frame was taken,
+				accumulated each render interrupt. Frames in between are skipped when running faster than real time.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			//cppcheck-suppress unusedStructMember
+			double frameCredit_{};
+
+			/** Last frame wall time
+
+				The wall clock time the last frame was taken, used to skip frames when running as fast as possible.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			std::chrono::steady_clock::time_point lastFrameWallTime_{};
+
+			/** Sample durations
+
+				The play time of each of the audio samples in mixChunk_.
+			*/
+			std::vector<std::chrono::nanoseconds> sampleDuration_;
+
+			/** Sample triggered
+
+				The wall clock time each audio sample was last played, used to throttle audio when running faster than real time.
+
+				@remark		Only accessed from the machine thread.
+			*/
+			std::array<std::chrono::steady_clock::time_point, 16> sampleTriggered_{};
+
+			/** Encode the input ports
+
+				Convert the keyboard state into the port 1 and port 2 bitfields.
+
+				@param	state	The SDL keyboard state.
+
+				@return			The port 1 bitfield in the low byte and the port 2 bitfield in the high byte.
+			*/
+			static uint16_t EncodeInputPorts(const Uint8* state);
+
+			/** Create the native blitter
+
+				Create the native blitter when the video options allow for it and it is bit exact with the
+				meen-hw blitter, otherwise leave blitter_ empty so the meen-hw blitter is used.
+
+				@param	videoTextures	JSON object describing the video texture.
+			*/
+			void CreateBlitter(const nlohmann::json& videoTextures);
+
+			/** Derive the row mapping
+
+				Blit probe frames through the hardware to find where video ram rows land in the texture.
+
+				@see rowMapping_
+			*/
+			void DeriveRowMapping();
+
+			/** Upload a video frame
+
+				Blit the video frame and upload the rows which changed since the last uploaded frame to the texture.
+
+				@param	videoFrame	The video frame to upload.
+
+				@return				true if the texture was modified, false if the frame was identical to the last one.
+			*/
+			bool UploadVideoFrame(VideoFrame& videoFrame);
+
+			/** Draw the frame timing overlay
+
+				Draw a bar per stage over the frame, the solid part is the median latency and the faint part
+				the 99th percentile, the full width of the window is one 60Hz frame interval. The percentiles
+				are shown in the window title, it is refreshed once per second.
+			*/
+			void DrawFrameTiming();
+
+			/** Draw the memory heatmap overlay
+
+				Draw a 16 x 16 grid of the 256 byte pages of the address space in the bottom right of the
+				window, page 0 top left. The green of a page is its reads and the red its writes since the
+				heatmap was last drawn, on a log scale relative to the busiest page.
+			*/
+			void DrawMemoryHeatmap();
+
+			/** Next load or save interrupt
+
+				Choose the load or save to request of the machine, if any, when none is in flight. A user
+				request takes priority over a rewind step which takes priority over a rewind snapshot. A
+				request still in flight after pendingTimeout_ frames is abandoned so that new ones can be made.
+
+				@return		MachEmu::ISR::Load, MachEmu::ISR::Save or MachEmu::ISR::NoInterrupt.
+			*/
+			MachEmu::ISR NextLoadSaveInterrupt();
+
+			/** Take the pending state
+
+				Called from the OnSave and OnLoad handlers to find out what the state they were handed was
+				requested for.
+
+				@return		The pending state, or the abandoned state if none is pending, which is cleared.
+			*/
+			PendingState TakePendingState();
+
+			/** Pace the machine
+
+				Sleep the machine thread until the wall clock catches up with the emulated time divided by the
+				current speed. Called from the machine thread at each hardware interrupt.
+
+				@param	currTime	The current CPU run time in nanoseconds.
+			*/
+			void Pace(uint64_t currTime);
+
+			/** Take a frame
+
+				Decide whether the frame generated by this render interrupt should be handed to the main thread.
+
+				@return		true when a display interval has elapsed since the last frame was taken, false if the frame should be skipped.
+			*/
+			bool TakeFrame();
+
+			/** Throttle audio
+
+				Drop retriggers of audio samples which are still playing when running faster than real time so
+				the mixer channels are not flooded.
+
+				@param	port	The audio port written to, 3 or 5.
+				@param	audio	The audio samples to play.
+
+				@return			The audio samples to play after throttling.
+			*/
+			uint8_t ThrottleAudio(uint16_t port, uint8_t audio);
+
+			/** Trigger audio
+
+				Queue the samples for a write to an audio port on the native mixer, or post them to the main thread for the SDL Mixer.
+
+				@param	port	The audio port written to, 3 or 5.
+				@param	data	The value written to the port.
+				@param	audio	The samples whose port bits were raised by the write.
+			*/
+			void TriggerAudio(uint16_t port, uint8_t data, uint8_t audio);
+
 		public:
 			/** Initialisation constructor
 
 				Creates an SDL specific i8080 arcade IO controller.
+
+				@remark		The memory controller frame pool should hold at least one more frame than the
+							videoHardware "frame-queue-depth" so a frame can be rendered while the queue is full.
 			*/
-			SdlIoController(const std::shared_ptr<MemoryController>& memoryController, const nlohmann::json& audioHardware, const nlohmann::json& videoHardware);
+			SdlIoController(const std::shared_ptr<MemoryController>& memoryController, const nlohmann::json& audioHardware, const nlohmann::json& videoHardware, const nlohmann::json& inputHardware, const nlohmann::json& rewindHardware);
 			
 			/** Destructor
 
@@ -160,7 +689,9 @@ namespace i8080_arcade
 
 			/** IController Read override
 
-				Sample the keyboard so the CPU can take any required action.
+				Return the most recently published input snapshot so the CPU can take any required action.
+
+				@remark		This never waits on the main thread.
 
 				@param	port	The device to read from.
 
@@ -179,7 +710,7 @@ namespace i8080_arcade
 
 			/** IController::ServiceInterrupts override
 
-				Render the video ram texture to the window via the rendering context.
+				Pace the machine to the current speed and hand video frames to the main thread at the display rate.
 
 				@param	currTime	The current CPU run time in nanoseconds.
 				@param	cycles		The number of CPU cycles completed.
@@ -199,17 +730,20 @@ namespace i8080_arcade
 				Process all incoming events.
 
 				Events include audio/video rendering, keyboard processing and window close.
+				A summary of the frame timing is printed when the loop exits.
 			*/
 			void EventLoop();
 
 			/** Load Audio Samples
 
-				Use SDL Mixer to load the audio samples.
+				Decode the audio samples in parallel into the PCM arena, converting them to the output format, and
+				hand them to the native mixer or the SDL Mixer.
 
 				@param	audioFilePath	The audio samples root directory.
 				@param	audioSamples	JSON object representing the audio sample files.
+				@param	audioCachePath	The directory to cache the converted samples in, empty to always convert them.
 			*/
-			void LoadAudioSamples(const std::filesystem::path& audioFilePath, const nlohmann::json& audioSamples);
+			void LoadAudioSamples(const std::filesystem::path& audioFilePath, const nlohmann::json& audioSamples, const std::filesystem::path& audioCachePath);
 
 			/** Load Video Textures
 
@@ -218,6 +752,82 @@ namespace i8080_arcade
 				@param	videoTextures	JSON object describing the video texture.
 			*/
 			void LoadVideoTextures(const nlohmann::json& videoTextures);
+
+			/** Save a rewind snapshot
+
+				Route a save made by the machine, call this from the machine OnSave handler.
+
+				@param	json	The machine save state.
+
+				@return			true if the save was a rewind snapshot and has been stored, false if it
+								was requested by the user and should be written to disk.
+			*/
+			bool SaveRewindSnapshot(const char* json);
+
+			/** Load a rewind snapshot
+
+				Route a load made by the machine, call this from the machine OnLoad handler.
+
+				@return			The newest rewind snapshot if the load was a rewind step, valid until the
+								next call, or nullptr if it was requested by the user and should be read
+								from disk. The rewind history is discarded on a user load.
+			*/
+			const char* LoadRewindSnapshot();
+
+			/** Set the speed
+
+				Set the real time multipliers the machine runs at.
+
+				@param	speed				The normal speed, 1 is real time, 0 runs the machine as fast as possible.
+				@param	fastForwardSpeed	The speed while the fast forward (tab) key is held, 0 runs the machine as fast as possible.
+
+				@throw	std::invalid_argument when either speed is negative.
+
+				@remark		The machine must be configured with a clockResolution of -1 so it is paced by this controller.
+			*/
+			void SetSpeed(double speed, double fastForwardSpeed);
+
+			/** Set the input log
+
+				Record the inputs to, or replay them from, an input log. Input is sampled once per frame,
+				and rewinding and loading games are disabled, so that the run can be reproduced. When a
+				replay ends the machine quits.
+
+				@param	inputLog	The log to record to or replay from.
+
+				@remark		Must be called before the machine is run.
+			*/
+			void SetInputLog(const std::shared_ptr<InputLog>& inputLog);
+
+			/** Set the video recorder
+
+				Record every emulated frame to a video.
+
+				@param	videoRecorder	The recorder to queue the frames to.
+
+				@remark		Must be called before the machine is run.
+			*/
+			void SetVideoRecorder(const std::shared_ptr<VideoRecorder>& videoRecorder);
+
+			/** Set the tracer
+
+				Record the activity of the machine, event loop and audio threads to a trace.
+
+				@param	tracer	The tracer to record the events to.
+
+				@remark		Must be called before the audio samples are loaded and the machine is run.
+			*/
+			void SetTracer(const std::shared_ptr<Tracer>& tracer);
+
+			/** On first frame
+
+				Set a handler to call once the first video frame has been presented.
+
+				@param	onFirstFrame	The handler, it is called from the render thread.
+
+				@remark		Must be called before the event loop is run.
+			*/
+			void OnFirstFrame(std::function<void()> onFirstFrame);
 	};
 } // namespace i8080_arcade
 
@@ -0,0 +1,183 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** Single producer single consumer ring
+
+		A bounded, wait-free queue of slots that are allocated once at construction.
+
+		Exactly one thread may call Push and Drop and exactly one (other) thread may call Pop.
+		The counters may be read from any thread.
+	*/
+	template<typename T>
+	class SpscRing final
+	{
+		private:
+			/** Cache line size
+
+				Used to keep the producer and consumer indices from sharing a cache line.
+			*/
+			static constexpr size_t cacheLineSize_{ 64 };
+
+			/** Slots
+
+				The preallocated storage for the queued items.
+			*/
+			std::vector<T> slots_;
+
+			/** Head
+
+				The total number of items pushed, only written by the producer.
+			*/
+			alignas(cacheLineSize_) std::atomic<uint64_t> head_{};
+
+			/** Tail
+
+				The total number of items popped, only written by the consumer.
+			*/
+			alignas(cacheLineSize_) std::atomic<uint64_t> tail_{};
+
+			/** Dropped
+
+				The total number of items the producer failed to queue.
+			*/
+			alignas(cacheLineSize_) std::atomic<uint64_t> dropped_{};
+
+		public:
+			/** Initialisation constructor
+
+				@param	capacity	The maximum number of items that can be queued at any one time.
+
+				@throw	std::invalid_argument when the capacity is zero.
+			*/
+			explicit SpscRing(size_t capacity)
+			{
+				if (capacity == 0)
+				{
+					throw std::invalid_argument("The ring capacity must be greater than zero");
+				}
+
+				slots_.resize(capacity);
+			}
+
+			/** Push an item
+
+				Called from the producer thread only.
+
+				@param	item	The item to move into the ring, it is left untouched if the ring is full.
+
+				@return			true if the item was queued, false (and the drop counter incremented) otherwise.
+			*/
+			bool Push(T&& item)
+			{
+				auto head = head_.load(std::memory_order_relaxed);
+
+				if (head - tail_.load(std::memory_order_acquire) == slots_.size())
+				{
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+
+				slots_[head % slots_.size()] = std::move(item);
+				head_.store(head + 1, std::memory_order_release);
+				return true;
+			}
+
+			/** Drop an item
+
+				Called from the producer thread only when an item could not be produced at all.
+			*/
+			void Drop()
+			{
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			/** Pop an item
+
+				Called from the consumer thread only.
+
+				@param	item	Receives the oldest queued item.
+
+				@return			true if an item was dequeued, false if the ring was empty.
+			*/
+			bool Pop(T& item)
+			{
+				auto tail = tail_.load(std::memory_order_relaxed);
+
+				if (tail == head_.load(std::memory_order_acquire))
+				{
+					return false;
+				}
+
+				item = std::move(slots_[tail % slots_.size()]);
+				tail_.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			/** Capacity
+
+				@return		The maximum number of items that can be queued at any one time.
+			*/
+			size_t Capacity() const
+			{
+				return slots_.size();
+			}
+
+			/** Produced
+
+				@return		The total number of items queued.
+			*/
+			uint64_t Produced() const
+			{
+				return head_.load(std::memory_order_relaxed);
+			}
+
+			/** Consumed
+
+				@return		The total number of items dequeued.
+			*/
+			uint64_t Consumed() const
+			{
+				return tail_.load(std::memory_order_relaxed);
+			}
+
+			/** Dropped
+
+				@return		The total number of items that could not be queued.
+			*/
+			uint64_t Dropped() const
+			{
+				return dropped_.load(std::memory_order_relaxed);
+			}
+	};
+} // namespace i8080_arcade
+
+#endif // SPSC_RING_H
@@ -0,0 +1,295 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "i8080_arcade/SpscRing.h"
+
+namespace i8080_arcade
+{
+	/** Tracer
+
+		Records spans and instants of the machine, event loop and audio threads to a trace in the
+		Chrome trace event JSON format, which loads in chrome://tracing and Perfetto.
+
+		Each thread records to its own bounded ring which is registered the first time the thread
+		records an event, after that recording an event is a clock read and a push with no locks
+		taken. A dedicated writer thread drains the rings and writes the events to disk. When the
+		writer falls behind a ring fills and the events which don't fit are dropped and counted
+		rather than stalling the thread recording them.
+	*/
+	class Tracer final
+	{
+		public:
+			/** Event
+
+				The traced activities, each is recorded from a single thread.
+			*/
+			enum class Event : uint8_t
+			{
+				Pace,				/**< Machine thread, waiting for real time to catch up with the emulated time. */
+				ServiceInterrupts,	/**< Machine thread, handling an interrupt after pacing. */
+				FramePublish,		/**< Machine thread, copying a video frame and handing it to the event loop. */
+				InputRead,			/**< Machine thread, the game read an input port. */
+				AudioTrigger,		/**< Machine thread, the game raised sound port bits. */
+				Save,				/**< Machine thread, saving the machine state. */
+				Load,				/**< Machine thread, loading the machine state. */
+				EventDequeue,		/**< Event loop thread, a render event was taken from the queue. */
+				Blit,				/**< Event loop thread, expanding and uploading a video frame. */
+				Present,			/**< Event loop thread, drawing and presenting a video frame. */
+				AudioMix,			/**< Audio thread, mixing an audio buffer. */
+				Count				/**< The number of events. */
+			};
+
+			/** Statistics
+
+				The events recorded over the lifetime of the trace.
+			*/
+			struct Statistics
+			{
+				uint64_t recorded{};	/**< The number of events queued by the traced threads. */
+				uint64_t written{};		/**< The number of events written to the trace. */
+				uint64_t dropped{};		/**< The number of events the rings were too full to take. */
+			};
+
+			/** Scope
+
+				Records a span from its construction to its destruction, nothing when there is no tracer.
+			*/
+			class Scope final
+			{
+				private:
+					/** Tracer
+
+						The tracer to record the span to, may be nullptr.
+					*/
+					Tracer* tracer_{};
+
+					/** Event
+
+						The span being recorded.
+					*/
+					Event event_{};
+
+					/** Start
+
+						When the span started.
+					*/
+					//cppcheck-suppress unusedStructMember
+					int64_t start_{};
+
+				public:
+					/** Initialisation constructor
+
+						@param	tracer	The tracer to record the span to, may be nullptr.
+						@param	event	The span to record.
+					*/
+					Scope(Tracer* tracer, Event event);
+
+					Scope(const Scope&) = delete;
+					Scope& operator=(const Scope&) = delete;
+
+					/** Destructor
+
+						Records the span.
+					*/
+					~Scope();
+			};
+
+		private:
+			/** Ring capacity
+
+				The number of events each thread can have waiting for the writer.
+			*/
+			static constexpr size_t ringCapacity_{ 1 << 16 };
+
+			/** Record
+
+				A span or an instant recorded by a traced thread.
+			*/
+			struct Record
+			{
+				int64_t start{};	/**< When the event started. */
+				int64_t duration{};	/**< How long the span lasted, -1 for an instant. */
+				Event event{};		/**< The event recorded. */
+			};
+
+			/** Thread ring
+
+				The events recorded by one thread.
+			*/
+			struct ThreadRing
+			{
+				SpscRing<Record> records{ ringCapacity_ };	/**< Pushed by the traced thread and popped by the writer thread. */
+				uint32_t tid{};								/**< The thread id written to the trace, in order of registration. */
+				Event firstEvent{};							/**< The first event recorded, it names the thread in the trace. */
+			};
+
+			/** Path
+
+				The trace file being written.
+			*/
+			std::filesystem::path path_;
+
+			/** Id
+
+				Identifies this tracer to the threads caching their ring, unique for the lifetime of the process.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint64_t id_{};
+
+			/** Start time
+
+				The time of the start of the trace, the event times are written relative to it.
+			*/
+			//cppcheck-suppress unusedStructMember
+			int64_t startTime_{};
+
+			/** Rings
+
+				The ring of each registered thread, guarded by the mutex. The rings are never
+				released before the tracer so the traced threads can keep a pointer to theirs.
+			*/
+			std::mutex mutex_;
+			std::vector<std::unique_ptr<ThreadRing>> rings_;
+
+			/** Output file
+
+				Only accessed by the writer thread once it has started.
+			*/
+			std::ofstream fout_;
+
+			/** Written
+
+				The number of events written, updated by the writer thread.
+			*/
+			std::atomic<uint64_t> written_{};
+
+			/** Failed
+
+				Set by the writer thread when a write fails, no more events are written.
+			*/
+			std::atomic<bool> failed_{};
+
+			/** Stopping
+
+				Set by Close, the writer thread writes the events still queued and exits.
+			*/
+			std::atomic<bool> stopping_{};
+
+			/** Writer
+
+				Drains the rings and writes the events.
+			*/
+			std::thread writer_;
+
+			/** Ring
+
+				@param	event	The event about to be recorded, it names the thread when it is the first.
+
+				@return			The ring of the calling thread, it is registered on first use.
+			*/
+			ThreadRing& Ring(Event event);
+
+			/** Push
+
+				@param	record	The event to queue to the ring of the calling thread.
+			*/
+			void Push(const Record& record);
+
+			/** Write the queued events
+
+				The writer thread body, it polls the rings until the trace is closed.
+			*/
+			void WriteEvents();
+
+		public:
+			/** Initialisation constructor
+
+				Creates the trace file and starts the writer thread.
+
+				@param	path	The trace file to write, it is replaced if it exists.
+
+				@throw	std::runtime_error when the trace file fails to open.
+			*/
+			explicit Tracer(const std::filesystem::path& path);
+
+			Tracer(const Tracer&) = delete;
+			Tracer& operator=(const Tracer&) = delete;
+
+			/** Destructor
+
+				Closes the trace if Close was not called.
+			*/
+			~Tracer();
+
+			/** Span
+
+				Record an event which lasted from start to end.
+
+				@param	event	The event to record.
+				@param	start	When the event started, see FrameTiming::Now.
+				@param	end		When the event ended.
+			*/
+			void Span(Event event, int64_t start, int64_t end);
+
+			/** Instant
+
+				Record an event which happened at a point in time.
+
+				@param	event	The event to record.
+				@param	time	When the event happened, see FrameTiming::Now.
+			*/
+			void Instant(Event event, int64_t time);
+
+			/** Close
+
+				Write the events still queued and complete the trace file.
+
+				@return		The events recorded.
+
+				@throw	std::runtime_error when the trace file could not be written.
+
+				@remark		Events recorded after the trace is closed are not written.
+			*/
+			Statistics Close();
+
+			/** Path
+
+				@return		The trace file being written.
+			*/
+			const std::filesystem::path& Path() const;
+	};
+} // namespace i8080_arcade
+
+#endif // TRACER_H
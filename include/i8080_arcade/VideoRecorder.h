@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef VIDEO_RECORDER_H
+#define VIDEO_RECORDER_H
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <thread>
+#include <vector>
+
+#include "i8080_arcade/MemoryController.h"
+#include "i8080_arcade/SpscRing.h"
+#include "i8080_arcade/VramBlitter.h"
+
+namespace i8080_arcade
+{
+	/** Video recorder
+
+		Records every emulated frame to a lossless YUV4MPEG2 (.y4m) video which can be played or
+		transcoded by most video tools (ffmpeg, mpv, vlc).
+
+		The machine thread only copies the 7168 bytes of video ram into a bounded queue. A dedicated
+		writer thread expands the pixels to the configured colour, converts them to full range
+		4:4:4 YUV and writes them to disk. When the writer falls behind the queue fills and the
+		frames which don't fit are dropped and counted rather than stalling the machine.
+	*/
+	class VideoRecorder final
+	{
+		public:
+			/** Statistics
+
+				The frames recorded over the lifetime of the recording.
+			*/
+			struct Statistics
+			{
+				uint64_t captured{};	/**< The number of frames queued by the machine thread. */
+				uint64_t written{};		/**< The number of frames written to the video. */
+				uint64_t dropped{};		/**< The number of frames the queue was too full to take. */
+			};
+
+		private:
+			/** Video ram
+
+				A copy of video ram, one bit per pixel.
+			*/
+			using Vram = std::array<uint8_t, VideoFrame::rows * VideoFrame::rowBytes>;
+
+			/** Video ram address
+
+				The address of the first byte of video ram, see MemoryController.
+			*/
+			static constexpr uint16_t vramAddress_{ 0x2400 };
+
+			/** Queue depth
+
+				The number of frames that can be waiting for the writer, two seconds of video.
+			*/
+			static constexpr size_t queueDepth_{ 120 };
+
+			/** Path
+
+				The video file being written.
+			*/
+			std::filesystem::path path_;
+
+			/** Blitter
+
+				Expands video ram to one RGB332 byte per pixel in the configured orientation and colour.
+			*/
+			VramBlitter blitter_;
+
+			/** Planes
+
+				The RGB332 value of each pixel mapped to its Y, U and V, in that order.
+			*/
+			std::array<std::array<uint8_t, 256>, 3> planes_{};
+
+			/** Output file
+
+				Only accessed by the writer thread once it has started.
+			*/
+			std::ofstream fout_;
+
+			/** Frame queue
+
+				Video ram copies pushed by the machine thread and popped by the writer thread.
+			*/
+			SpscRing<Vram> frameQueue_{ queueDepth_ };
+
+			/** Written
+
+				The number of frames written, updated by the writer thread.
+			*/
+			std::atomic<uint64_t> written_{};
+
+			/** Failed
+
+				Set by the writer thread when a write fails, no more frames are written.
+			*/
+			std::atomic<bool> failed_{};
+
+			/** Stopping
+
+				Set by Close, the writer thread writes the frames still queued and exits.
+			*/
+			std::atomic<bool> stopping_{};
+
+			/** Writer
+
+				Encodes and writes the queued frames.
+			*/
+			std::thread writer_;
+
+			/** Write the queued frames
+
+				The writer thread body, it polls the queue until the recording is closed.
+			*/
+			void WriteFrames();
+
+		public:
+			/** Initialisation constructor
+
+				Creates the video file, writes its header and starts the writer thread.
+
+				@param	path			The video file to write, it is replaced if it exists.
+				@param	videoOptions	JSON object describing the video texture, the "orientation" and "colour" are recorded.
+
+				@throw	std::invalid_argument when the colour can't be recorded.
+				@throw	std::runtime_error when the video file fails to open.
+			*/
+			VideoRecorder(const std::filesystem::path& path, const nlohmann::json& videoOptions);
+
+			VideoRecorder(const VideoRecorder&) = delete;
+			VideoRecorder& operator=(const VideoRecorder&) = delete;
+
+			/** Destructor
+
+				Closes the recording if Close was not called.
+			*/
+			~VideoRecorder();
+
+			/** Capture a frame
+
+				Queue a copy of the current video ram, it is dropped when the queue is full unless waiting.
+
+				@param	memoryController	The memory controller to copy video ram from.
+				@param	wait				Wait for the writer to make room in a full queue rather than drop the frame,
+											for runs which aren't paced to real time.
+
+				@remark		Must be called from the same thread as the memory controller's Write, once per render interrupt.
+			*/
+			void Capture(const MemoryController& memoryController, bool wait = false);
+
+			/** Close
+
+				Write the frames still queued and close the video file.
+
+				@return		The frames recorded.
+
+				@throw	std::runtime_error when the video file could not be written.
+
+				@remark		Call once the machine has completed, no more frames may be captured.
+			*/
+			Statistics Close();
+
+			/** Path
+
+				@return		The video file being written.
+			*/
+			const std::filesystem::path& Path() const;
+	};
+} // namespace i8080_arcade
+
+#endif // VIDEO_RECORDER_H
@@ -0,0 +1,223 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef VRAM_BLITTER_H
+#define VRAM_BLITTER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace i8080_arcade
+{
+	/** Video ram blitter
+
+		Expands the 1bpp i8080 arcade video ram into an 8bpp RGB332 or a 32bpp ARGB8888 frame buffer,
+		rotating it for upright orientation.
+
+		Rotation is performed as a series of 8x8 bit matrix transposes, which produces a packed 1bpp
+		row for each output row. The packed rows are then expanded by a kernel selected at runtime
+		based on the features supported by the CPU.
+	*/
+	class VramBlitter final
+	{
+		public:
+			/** Pixel format
+
+				The format of the frame buffer being blitted to.
+			*/
+			enum class PixelFormat
+			{
+				RGB332,		/**< 8 bits per pixel, SDL_PIXELFORMAT_RGB332. */
+				ARGB8888	/**< 32 bits per pixel, SDL_PIXELFORMAT_ARGB8888. */
+			};
+
+			/** Kernel
+
+				A set of functions which expand a packed 1bpp row, least significant bit first, into pixels.
+			*/
+			struct Kernel
+			{
+				const char* name;	/**< The name of the kernel: scalar, sse2, avx2 or neon. */
+
+				/** Expand bytes * 8 pixels to RGB332, set bits become colour and clear bits become 0. */
+				void (*expand8)(const uint8_t* bits, size_t bytes, uint8_t* dst, uint8_t colour);
+
+				/** Expand bytes * 8 pixels to ARGB8888, set bits become colour and clear bits become background. */
+				void (*expand32)(const uint8_t* bits, size_t bytes, uint32_t* dst, uint32_t colour, uint32_t background);
+			};
+
+			/** Region
+
+				A rectangle of the frame buffer, in pixels.
+			*/
+			struct Region
+			{
+				int x;
+				int y;
+				int w;
+				int h;
+			};
+
+		private:
+			/** Video ram dimensions
+
+				The number of rows (in bytes) and the number of bytes in each row of video ram.
+			*/
+			static constexpr size_t vramRows_{ 224 };
+			static constexpr size_t vramRowBytes_{ 32 };
+
+			/** Upright
+
+				When true the video ram is rotated 90 degrees counter clockwise to give a 224x256 frame,
+				otherwise it is blitted as is to give a 256x224 frame.
+			*/
+			//cppcheck-suppress unusedStructMember
+			bool upright_{};
+
+			/** Pixel format
+
+				The format of the frame buffer being blitted to.
+			*/
+			PixelFormat pixelFormat_{};
+
+			/** Colour
+
+				The foreground colour in RGB332, it is expanded for ARGB8888.
+			*/
+			//cppcheck-suppress unusedStructMember
+			uint8_t colour_{};
+
+			/** Kernel
+
+				The expansion kernel in use.
+			*/
+			Kernel kernel_{};
+
+			/** Packed rows
+
+				Scratch space holding the rotated 1bpp output rows, 256 rows of 28 bytes.
+			*/
+			std::array<uint8_t, vramRows_ * vramRowBytes_> packedRows_{};
+
+		public:
+			/** Initialisation constructor
+
+				@param	upright			Rotate the video ram for an upright cabinet.
+				@param	colour			The RGB332 foreground colour.
+				@param	pixelFormat		The format of the frame buffer.
+				@param	kernel			The name of the kernel to use, "auto" selects the fastest the CPU supports.
+
+				@throw	std::invalid_argument when the named kernel is unknown or not supported by the CPU.
+			*/
+			VramBlitter(bool upright, uint8_t colour, PixelFormat pixelFormat, const std::string& kernel = "auto");
+
+			/** Width
+
+				@return		The width of the frame buffer in pixels.
+			*/
+			int Width() const;
+
+			/** Height
+
+				@return		The height of the frame buffer in pixels.
+			*/
+			int Height() const;
+
+			/** Bytes per pixel
+
+				@return		The number of bytes in each pixel of the frame buffer.
+			*/
+			int BytesPerPixel() const;
+
+			/** Kernel name
+
+				@return		The name of the kernel in use.
+			*/
+			const char* KernelName() const;
+
+			/** Get a region
+
+				Get the region of the frame buffer that is drawn from a range of video ram rows.
+
+				@param	firstRow	The first video ram row.
+				@param	lastRow		The last video ram row (inclusive).
+
+				@return				The region of the frame buffer to blit.
+			*/
+			Region GetRegion(size_t firstRow, size_t lastRow) const;
+
+			/** Blit
+
+				Blit a region of the frame buffer from video ram.
+
+				@param	vram		The 7168 bytes of video ram.
+				@param	region		The region to blit, as returned by GetRegion.
+				@param	dst			The location of the top left pixel of the region.
+				@param	pitch		The number of bytes between rows of dst.
+			*/
+			void Blit(const uint8_t* vram, const Region& region, uint8_t* dst, int pitch);
+
+			/** Parse a colour
+
+				Convert a meen_hw colour option into RGB332.
+
+				@param	colour		"white", "red", "green", "blue" or an 8 bit hex value.
+
+				@return				The RGB332 colour, std::nullopt when the colour can't be reproduced, "random" for example.
+			*/
+			static std::optional<uint8_t> ParseColour(const std::string& colour);
+
+			/** Available kernels
+
+				@return		The kernels supported by this CPU, the scalar kernel is always first and the fastest last.
+			*/
+			static std::vector<Kernel> AvailableKernels();
+	};
+
+	/** SSE2 kernel
+
+		@return		The SSE2 expansion kernel, std::nullopt if this is not an x86_64 build.
+	*/
+	std::optional<VramBlitter::Kernel> Sse2Kernel();
+
+	/** AVX2 kernel
+
+		@return		The AVX2 expansion kernel, std::nullopt if this is not an x86_64 build.
+
+		@remark		The caller must check the CPU supports AVX2 before using it.
+	*/
+	std::optional<VramBlitter::Kernel> Avx2Kernel();
+
+	/** NEON kernel
+
+		@return		The NEON expansion kernel, std::nullopt if this build does not target arm.
+
+		@remark		The caller must check the CPU supports NEON before using it.
+	*/
+	std::optional<VramBlitter::Kernel> NeonKernel();
+} // namespace i8080_arcade
+
+#endif // VRAM_BLITTER_H
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <fstream>
+#include <stdexcept>
+
+#include "i8080_arcade/ArcadeConfig.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		nlohmann::json Parse(const std::filesystem::path& configFile)
+		{
+			std::ifstream fin(configFile);
+
+			if (!fin)
+			{
+				throw std::runtime_error("The config file failed to open");
+			}
+
+			return nlohmann::json::parse(fin);
+		}
+	} // namespace
+
+	ArcadeConfig ArcadeConfig::Load(const std::filesystem::path& configFile, const std::string& game)
+	{
+		auto config = Parse(configFile);
+		auto& arcade = config.at("i8080-arcade");
+		auto& hardware = arcade.at("hardware");
+		auto& software = arcade.at("software");
+
+		if (software.contains(game) == false)
+		{
+			throw std::invalid_argument("The game " + game + " does not exist in the software section of the config file");
+		}
+
+		ArcadeConfig arcadeConfig;
+		auto& machEmu = hardware.at("mach-emu");
+		// The io controllers pace the machine, or run it as fast as possible
+		machEmu["clockResolution"] = -1;
+
+		arcadeConfig.game = game;
+		arcadeConfig.machineOptions = machEmu.dump();
+		// Moved out of the parsed config, it is not used again
+		arcadeConfig.memory = std::move(software.at(game).at("memory"));
+		arcadeConfig.memoryOptions = arcadeConfig.memory.dump();
+		arcadeConfig.audioHardware = std::move(hardware.at("audio"));
+		arcadeConfig.videoHardware = std::move(hardware.at("video"));
+		arcadeConfig.inputHardware = std::move(hardware.at("input"));
+		arcadeConfig.rewindHardware = std::move(hardware.at("rewind"));
+		arcadeConfig.audioSoftware = std::move(software.at("audio"));
+		arcadeConfig.videoSoftware = std::move(software.at("video"));
+		arcadeConfig.frameQueueDepth = arcadeConfig.videoHardware.at("frame-queue-depth").get<int>();
+		return arcadeConfig;
+	}
+
+	std::vector<std::string> ArcadeConfig::Games(const std::filesystem::path& configFile)
+	{
+		auto config = Parse(configFile);
+		std::vector<std::string> games;
+
+		// The shared audio and video sections sit alongside the games, a game is any section with a memory layout
+		for (const auto& [name, section] : config.at("i8080-arcade").at("software").items())
+		{
+			if (section.is_object() == true && section.contains("memory") == true)
+			{
+				games.push_back(name);
+			}
+		}
+
+		return games;
+	}
+} // namespace i8080_arcade
@@ -0,0 +1,218 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "i8080_arcade/AudioMixer.h"
+
+namespace i8080_arcade
+{
+	AudioMixer::AudioMixer(int sampleRate, int channels, size_t bufferFrames, size_t queueCapacity)
+		: triggers_{ queueCapacity },
+		sampleRate_{ sampleRate },
+		channels_{ channels },
+		bufferFrames_{ bufferFrames }
+	{
+		if (sampleRate <= 0 || channels <= 0 || bufferFrames == 0)
+		{
+			throw std::invalid_argument("The audio sample rate, channels and buffer size must be greater than zero");
+		}
+
+		scheduled_.reserve(queueCapacity);
+		accumulator_.resize(bufferFrames);
+	}
+
+	void AudioMixer::SetSample(size_t index, std::span<const int16_t> pcm)
+	{
+		if (index >= samples_.size())
+		{
+			samples_.resize(index + 1);
+			voices_.resize(index + 1);
+		}
+
+		samples_[index] = pcm;
+	}
+
+	int AudioMixer::SampleRate() const
+	{
+		return sampleRate_;
+	}
+
+	uint64_t AudioMixer::SampleDuration(size_t index) const
+	{
+		return index < samples_.size() ? samples_[index].size() * uint64_t{1000000000} / sampleRate_ : 0;
+	}
+
+	void AudioMixer::SetFrameTiming(FrameTiming* frameTiming)
+	{
+		frameTiming_ = frameTiming;
+	}
+
+	bool AudioMixer::QueueTrigger(uint8_t sample, Action action, int64_t time)
+	{
+		return triggers_.Push({ time, FrameTiming::Now(), sample, action });
+	}
+
+	uint64_t AudioMixer::DroppedTriggers() const
+	{
+		return triggers_.Dropped();
+	}
+
+	uint64_t AudioMixer::Schedule(const Trigger& trigger, uint64_t bufferStart)
+	{
+		// Triggers are raised in bursts as the machine runs ahead of real time between frames, allow up to two buffers of lead
+		auto maxLead = 2 * bufferFrames_;
+
+		if (anchored_ == true)
+		{
+			auto offset = (trigger.time - anchorTime_) * sampleRate_ / 1000000000;
+			auto position = static_cast<int64_t>(anchorPosition_) + offset;
+
+			if (position >= static_cast<int64_t>(bufferStart) && position < static_cast<int64_t>(bufferStart + bufferFrames_ + maxLead))
+			{
+				return static_cast<uint64_t>(position);
+			}
+		}
+
+		// The trigger is late, too far ahead (the speed changed or a game was loaded) or the first, play it now
+		anchored_ = true;
+		anchorTime_ = trigger.time;
+		anchorPosition_ = bufferStart;
+		return bufferStart;
+	}
+
+	void AudioMixer::Apply(const Trigger& trigger)
+	{
+		if (trigger.sample >= voices_.size() || samples_[trigger.sample].empty() == true)
+		{
+			return;
+		}
+
+		auto& voice = voices_[trigger.sample];
+
+		switch (trigger.action)
+		{
+			case Action::Play:
+			case Action::Loop:
+			{
+				voice.position = 0;
+				voice.active = true;
+				voice.looping = trigger.action == Action::Loop;
+				break;
+			}
+			case Action::Stop:
+			{
+				voice.active = false;
+				break;
+			}
+		}
+	}
+
+	void AudioMixer::Render(size_t begin, size_t end)
+	{
+		for (size_t i = 0; i < voices_.size(); i++)
+		{
+			auto& voice = voices_[i];
+			const auto& pcm = samples_[i];
+			auto frame = begin;
+
+			while (voice.active == true && frame < end)
+			{
+				auto count = std::min(end - frame, pcm.size() - voice.position);
+
+				for (size_t j = 0; j < count; j++)
+				{
+					accumulator_[frame + j] += pcm[voice.position + j];
+				}
+
+				frame += count;
+				voice.position += count;
+
+				if (voice.position == pcm.size())
+				{
+					voice.position = 0;
+					voice.active = voice.looping;
+				}
+			}
+		}
+	}
+
+	void AudioMixer::Mix(std::span<int16_t> out)
+	{
+		auto frames = out.size() / channels_;
+		auto bufferStart = position_;
+		auto now = frameTiming_ != nullptr ? FrameTiming::Now() : 0;
+		Trigger trigger;
+
+		// Don't allocate in the callback, triggers which don't fit stay on the ring until the next buffer
+		while (scheduled_.size() < scheduled_.capacity() && triggers_.Pop(trigger) == true)
+		{
+			// Keep the schedule in order, a trigger never takes effect before one raised earlier
+			auto position = std::max(Schedule(trigger, bufferStart), scheduled_.empty() == true ? bufferStart : scheduled_.back().position);
+			scheduled_.push_back({ trigger, position });
+		}
+
+		if (accumulator_.size() < frames)
+		{
+			// The device asked for more than it was opened with, render the rest as silence
+			std::fill(out.begin() + accumulator_.size() * channels_, out.end(), 0);
+			frames = accumulator_.size();
+		}
+
+		std::fill_n(accumulator_.begin(), frames, 0);
+
+		size_t rendered = 0;
+		size_t applied = 0;
+
+		for (; applied < scheduled_.size() && scheduled_[applied].position < bufferStart + frames; applied++)
+		{
+			auto offset = static_cast<size_t>(scheduled_[applied].position - bufferStart);
+			Render(rendered, offset);
+			rendered = offset;
+			Apply(scheduled_[applied].trigger);
+
+			if (frameTiming_ != nullptr)
+			{
+				// The time the trigger was raised until the device was handed the frame it starts at
+				frameTiming_->Record(FrameTiming::Stage::Audio, now - scheduled_[applied].trigger.wallTime + static_cast<int64_t>(offset) * 1000000000 / sampleRate_);
+			}
+		}
+
+		Render(rendered, frames);
+		scheduled_.erase(scheduled_.begin(), scheduled_.begin() + applied);
+
+		auto output = out.begin();
+
+		for (size_t i = 0; i < frames; i++)
+		{
+			auto sample = static_cast<int16_t>(std::clamp(accumulator_[i], -32768, 32767));
+
+			for (int channel = 0; channel < channels_; channel++)
+			{
+				*output++ = sample;
+			}
+		}
+
+		position_ += frames;
+	}
+} // namespace i8080_arcade
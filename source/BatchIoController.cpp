@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+
+#include "i8080_arcade/BatchIoController.h"
+
+namespace i8080_arcade
+{
+	BatchIoController::BatchIoController(const std::shared_ptr<MemoryController>& memoryController, const nlohmann::json& videoOptions, std::counting_semaphore<>& running, uint32_t framesPerStep, std::span<uint8_t> observation)
+		: memoryController_{ memoryController },
+		running_{ running },
+		observation_{ observation },
+		framesPerStep_{ framesPerStep }
+	{
+		if (framesPerStep == 0)
+		{
+			throw std::invalid_argument("The number of frames per step must be greater than zero");
+		}
+
+		if (observation.size() < observationSize_)
+		{
+			throw std::invalid_argument("The observation is too small");
+		}
+
+		i8080ArcadeIO_ = meen_hw::MakeI8080ArcadeIO();
+
+		if(i8080ArcadeIO_ == nullptr)
+		{
+			throw std::runtime_error("Failed to create i8080 arcade hardware");
+		}
+
+		i8080ArcadeIO_->SetOptions(videoOptions.dump().c_str());
+		ports_.Attach(i8080ArcadeIO_.get());
+	}
+
+	uint8_t BatchIoController::Read(uint16_t port)
+	{
+		auto ret = ports_.ReadPort(port);
+
+		if (ret == 0)
+		{
+			if (port == 1)
+			{
+				// Bit 3 of port 1 is always set
+				ret = (inputPorts_ & 0xFF) | 0x08;
+			}
+			else if (port == 2)
+			{
+				ret = inputPorts_ >> 8;
+			}
+		}
+
+		return ret;
+	}
+
+	void BatchIoController::Write(uint16_t port, uint8_t data)
+	{
+		ports_.WritePort(port, data);
+	}
+
+	MachEmu::ISR BatchIoController::ServiceInterrupts(uint64_t currTime, uint64_t cycles)
+	{
+		if (quit_ == true)
+		{
+			// Don't take a thread the machine will never give back
+			return MachEmu::ISR::Quit;
+		}
+
+		if (holdingThread_ == false)
+		{
+			running_.acquire();
+			holdingThread_ = true;
+		}
+
+		auto isr = MachEmu::ISR::NoInterrupt;
+		auto interrupt = i8080ArcadeIO_->GenerateInterrupt(currTime, cycles);
+
+		switch(interrupt)
+		{
+			case 0:
+			{
+				break;
+			}
+			case 1:
+			{
+				isr = MachEmu::ISR::One;
+				break;
+			}
+			case 2:
+			{
+				isr = MachEmu::ISR::Two;
+
+				if (++frames_ < framesPerStep_)
+				{
+					break;
+				}
+
+				frames_ = 0;
+				memoryController_->ReadBlock(0x2400, observation_.subspan(0, vramSize_));
+				memoryController_->ReadBlock(0x2000, observation_.subspan(vramSize_, ramSize_));
+
+				// Give the thread to another machine while this one waits for the next step
+				holdingThread_ = false;
+				running_.release();
+				done_.release();
+				go_.acquire();
+
+				if (quit_ == true)
+				{
+					isr = MachEmu::ISR::Quit;
+				}
+				break;
+			}
+			default:
+			{
+				assert(interrupt >= 0 && interrupt <= 2);
+				break;
+			}
+		}
+
+		return isr;
+	}
+
+	std::array<uint8_t, 16> BatchIoController::Uuid() const
+	{
+		return{ 0x3D, 0x8E, 0x41, 0x07, 0xB2, 0x5A, 0x4C, 0x93, 0xA6, 0x1F, 0xE8, 0x70, 0x2C, 0x95, 0xD4, 0x6B };
+	}
+
+	void BatchIoController::Go(uint16_t inputPorts)
+	{
+		inputPorts_ = inputPorts;
+		go_.release();
+	}
+
+	void BatchIoController::WaitUntilDone()
+	{
+		done_.acquire();
+	}
+
+	void BatchIoController::Quit()
+	{
+		quit_ = true;
+		go_.release();
+	}
+} // namespace i8080_arcade
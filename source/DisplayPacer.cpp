@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "i8080_arcade/DisplayPacer.h"
+
+namespace i8080_arcade
+{
+	DisplayPacer::DisplayPacer(Mode mode, int64_t frameInterval)
+		: mode_{ mode },
+		frameInterval_{ frameInterval },
+		refreshInterval_{ frameInterval },
+		nominalRefreshInterval_{ frameInterval }
+	{
+		if (frameInterval <= 0)
+		{
+			throw std::invalid_argument("The frame interval must be greater than zero");
+		}
+	}
+
+	DisplayPacer::Mode DisplayPacer::ParseMode(const std::string& mode)
+	{
+		if (mode == "off")
+		{
+			return Mode::Off;
+		}
+		else if (mode == "low-latency")
+		{
+			return Mode::LowLatency;
+		}
+		else if (mode == "smooth")
+		{
+			return Mode::Smooth;
+		}
+
+		throw std::invalid_argument("The vsync mode must be off, low-latency or smooth");
+	}
+
+	DisplayPacer::Mode DisplayPacer::GetMode() const
+	{
+		return mode_;
+	}
+
+	void DisplayPacer::SetRefreshInterval(int64_t refreshInterval)
+	{
+		if (refreshInterval > 0)
+		{
+			refreshInterval_ = refreshInterval;
+			nominalRefreshInterval_ = refreshInterval;
+		}
+	}
+
+	int64_t DisplayPacer::RefreshInterval() const
+	{
+		return refreshInterval_;
+	}
+
+	int64_t DisplayPacer::NominalRefreshInterval() const
+	{
+		return nominalRefreshInterval_;
+	}
+
+	int64_t DisplayPacer::PresentDeadline(int64_t now) const
+	{
+		if (mode_ != Mode::LowLatency || lastVblankTime_ == 0 || now < lastVblankTime_)
+		{
+			return now;
+		}
+
+		// The first vblank after now, predicted from the last one
+		auto nextVblank = lastVblankTime_ + ((now - lastVblankTime_) / refreshInterval_ + 1) * refreshInterval_;
+		auto deadline = nextVblank - prepareTime_ - presentMargin_;
+
+		// Too late to make it, the frame would be shown at the following vblank anyway so wait for a newer one
+		if (deadline < now)
+		{
+			deadline += refreshInterval_;
+		}
+
+		return deadline;
+	}
+
+	void DisplayPacer::Prepared(int64_t prepareTime)
+	{
+		prepareTime_ += (std::max<int64_t>(prepareTime, 0) - prepareTime_) / 8;
+	}
+
+	int64_t DisplayPacer::Presented(int64_t presentedTime, bool newFrame)
+	{
+		if (mode_ != Mode::Off)
+		{
+			// A vsynced present returns at a vblank, refine the refresh interval from the time since the last one.
+			// Presents may be several vblanks apart when there was no new frame for some of them.
+			auto sinceVblank = presentedTime - lastVblankTime_;
+			auto vblanks = std::llround(static_cast<double>(sinceVblank) / refreshInterval_);
+
+			if (lastVblankTime_ != 0 && vblanks >= 1 && vblanks <= 4 && std::abs(sinceVblank - vblanks * refreshInterval_) < refreshInterval_ / 4)
+			{
+				refreshInterval_ += (sinceVblank / vblanks - refreshInterval_) / 16;
+			}
+
+			lastVblankTime_ = presentedTime;
+		}
+
+		if (newFrame == false)
+		{
+			return -1;
+		}
+
+		auto sinceFrame = presentedTime - lastFrameTime_;
+		auto previousFrameTime = lastFrameTime_;
+		lastFrameTime_ = presentedTime;
+
+		// Long gaps are pauses in the frames (rewinding, a stalled machine) rather than judder
+		if (previousFrameTime == 0 || sinceFrame > frameInterval_ * 4)
+		{
+			return -1;
+		}
+
+		return std::abs(sinceFrame - frameInterval_);
+	}
+} // namespace i8080_arcade
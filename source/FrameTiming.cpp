@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+
+#include "i8080_arcade/FrameTiming.h"
+
+namespace i8080_arcade
+{
+	size_t FrameTiming::Bucket(uint64_t value)
+	{
+		constexpr uint64_t subBuckets = uint64_t{1} << subBucketBits_;
+
+		// Values below the first power of two with a full set of sub-buckets are exact
+		if (value < subBuckets)
+		{
+			return static_cast<size_t>(value);
+		}
+
+		auto exponent = std::bit_width(value) - 1;
+		auto subBucket = (value >> (exponent - subBucketBits_)) & (subBuckets - 1);
+		return static_cast<size_t>(((exponent - subBucketBits_ + 1) << subBucketBits_) + subBucket);
+	}
+
+	int64_t FrameTiming::BucketUpperBound(size_t bucket)
+	{
+		constexpr size_t subBuckets = size_t{1} << subBucketBits_;
+
+		if (bucket < subBuckets)
+		{
+			return static_cast<int64_t>(bucket);
+		}
+
+		auto exponent = (bucket >> subBucketBits_) + subBucketBits_ - 1;
+		auto subBucket = bucket & (subBuckets - 1);
+		auto width = uint64_t{1} << (exponent - subBucketBits_);
+		auto lower = (uint64_t{1} << exponent) + subBucket * width;
+		return static_cast<int64_t>(std::min<uint64_t>(lower + width - 1, INT64_MAX));
+	}
+
+	int64_t FrameTiming::Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	const char* FrameTiming::StageName(Stage stage)
+	{
+		switch (stage)
+		{
+			case Stage::Copy: return "copy";
+			case Stage::Queue: return "queue";
+			case Stage::Blit: return "blit";
+			case Stage::PostProcess: return "post";
+			case Stage::Present: return "present";
+			case Stage::Total: return "total";
+			case Stage::Audio: return "audio";
+			case Stage::Judder: return "judder";
+			default: return "unknown";
+		}
+	}
+
+	void FrameTiming::Record(Stage stage, int64_t latency)
+	{
+		auto& histogram = histograms_[static_cast<size_t>(stage)];
+		latency = std::max<int64_t>(latency, 0);
+
+		histogram.buckets[Bucket(static_cast<uint64_t>(latency))].fetch_add(1, std::memory_order_relaxed);
+		histogram.count.fetch_add(1, std::memory_order_relaxed);
+
+		auto max = histogram.max.load(std::memory_order_relaxed);
+
+		while (latency > max && histogram.max.compare_exchange_weak(max, latency, std::memory_order_relaxed) == false)
+		{
+		}
+	}
+
+	FrameTiming::Summary FrameTiming::Summarise(Stage stage) const
+	{
+		const auto& histogram = histograms_[static_cast<size_t>(stage)];
+		Summary summary{};
+		std::array<uint64_t, bucketCount_> buckets{};
+
+		// Take a copy so the percentiles are consistent with each other while recording continues
+		for (size_t i = 0; i < bucketCount_; i++)
+		{
+			buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+			summary.count += buckets[i];
+		}
+
+		summary.max = histogram.max.load(std::memory_order_relaxed);
+
+		if (summary.count == 0)
+		{
+			return summary;
+		}
+
+		auto percentile = [&](uint64_t numerator)
+		{
+			// The rank of the percentile, rounded up
+			auto rank = std::max<uint64_t>((summary.count * numerator + 99) / 100, 1);
+			uint64_t seen = 0;
+
+			for (size_t i = 0; i < bucketCount_; i++)
+			{
+				seen += buckets[i];
+
+				if (seen >= rank)
+				{
+					return std::min(BucketUpperBound(i), summary.max);
+				}
+			}
+
+			return summary.max;
+		};
+
+		summary.p50 = percentile(50);
+		summary.p99 = percentile(99);
+		return summary;
+	}
+
+	void FrameTiming::PrintSummary() const
+	{
+		printf("Frame timing (ms)    count      p50      p99      max\n");
+
+		for (size_t i = 0; i < static_cast<size_t>(Stage::Count); i++)
+		{
+			auto stage = static_cast<Stage>(i);
+			auto summary = Summarise(stage);
+			printf("  %-10s %12llu %8.3f %8.3f %8.3f\n", StageName(stage), static_cast<unsigned long long>(summary.count),
+				summary.p50 / 1e6, summary.p99 / 1e6, summary.max / 1e6);
+		}
+	}
+} // namespace i8080_arcade
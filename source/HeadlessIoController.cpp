@@ -0,0 +1,204 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <assert.h>
+
+#include "i8080_arcade/HeadlessIoController.h"
+
+namespace i8080_arcade
+{
+	HeadlessIoController::HeadlessIoController(const std::shared_ptr<MemoryController>& memoryController, uint64_t frameLimit, const nlohmann::json& videoHardware)
+		: memoryController_{ memoryController },
+		frameLimit_{ frameLimit },
+		tripleBuffering_{ videoHardware["frame-buffering"].get<std::string>() == "triple" }
+	{
+		i8080ArcadeIO_ = meen_hw::MakeI8080ArcadeIO();
+
+		if(i8080ArcadeIO_ == nullptr)
+		{
+			throw std::runtime_error("Failed to create i8080 arcade hardware");
+		}
+
+		ports_.Attach(i8080ArcadeIO_.get());
+	}
+
+	void HeadlessIoController::SetVideoOptions(const nlohmann::json& videoOptions)
+	{
+		i8080ArcadeIO_->SetOptions(videoOptions.dump().c_str());
+	}
+
+	uint8_t HeadlessIoController::Read(uint16_t port)
+	{
+		auto ret = ports_.ReadPort(port);
+
+		// Mirror the SDL controller with no keys held (bit 3 of port 1 is always set) or the inputs being replayed
+		if (ret == 0 && (port == 1 || port == 2))
+		{
+			ret = port == 1 ? latchedInputPorts_ & 0xFF : latchedInputPorts_ >> 8;
+		}
+
+		return ret;
+	}
+
+	void HeadlessIoController::Write(uint16_t port, uint8_t data)
+	{
+		ports_.WritePort(port, data);
+	}
+
+	MachEmu::ISR HeadlessIoController::ServiceInterrupts(uint64_t currTime, uint64_t cycles)
+	{
+		if (statistics_.frames >= frameLimit_)
+		{
+			return MachEmu::ISR::Quit;
+		}
+
+		auto isr = MachEmu::ISR::NoInterrupt;
+
+		if (statistics_.frames == 0 && statistics_.cycles == 0)
+		{
+			startTime_ = std::chrono::steady_clock::now();
+		}
+
+		statistics_.cycles = cycles;
+		statistics_.emulatedTime = currTime;
+
+		auto interrupt = i8080ArcadeIO_->GenerateInterrupt(currTime, cycles);
+
+		switch(interrupt)
+		{
+			case 0:
+			{
+				if (savePending_ == true)
+				{
+					savePending_ = false;
+					isr = MachEmu::ISR::Save;
+				}
+				break;
+			}
+			case 1:
+			{
+				isr = MachEmu::ISR::One;
+				break;
+			}
+			case 2:
+			{
+				isr = MachEmu::ISR::Two;
+				// Take the frame and release it straight back, this keeps the cost of
+				// the vram copy in the measurement without the cost of rendering it
+				if (tripleBuffering_ == true)
+				{
+					memoryController_->PublishVideoFrame();
+					memoryController_->AcquireVideoFrame();
+				}
+				else
+				{
+					[[maybe_unused]] auto videoFrame = memoryController_->GetVideoFrame();
+				}
+
+				// Nothing paces a headless run, wait for the writer rather than drop frames
+				if (videoRecorder_ != nullptr)
+				{
+					videoRecorder_->Capture(*memoryController_, true);
+				}
+
+				if (inputLog_ != nullptr)
+				{
+					latchedInputPorts_ = inputLog_->Latch(latchedInputPorts_);
+				}
+				else if (inputScript_ != nullptr)
+				{
+					latchedInputPorts_ = inputScript_(statistics_.frames);
+				}
+
+				savePending_ = saveEveryFrame_;
+
+				if (checkpointInterval_ > 0)
+				{
+					// FNV-1a over the frame hashes
+					frameHashChain_ = (frameHashChain_ ^ memoryController_->VramHash()) * 0x100000001B3;
+
+					if ((statistics_.frames + 1) % checkpointInterval_ == 0)
+					{
+						checkpoints_.push_back(frameHashChain_);
+					}
+				}
+
+				if (++statistics_.frames >= frameLimit_)
+				{
+					statistics_.frameHash = memoryController_->VramHash();
+					statistics_.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime_).count();
+					isr = MachEmu::ISR::Quit;
+				}
+				break;
+			}
+			default:
+			{
+				assert(interrupt >= 0 && interrupt <= 2);
+				break;
+			}
+		}
+
+		return isr;
+	}
+
+	std::array<uint8_t, 16> HeadlessIoController::Uuid() const
+	{
+		return{ 0x7E, 0x0A, 0x3B, 0x51, 0xC4, 0x29, 0x4F, 0x6D, 0x9B, 0x12, 0x58, 0xE3, 0x06, 0xAF, 0x71, 0xD4 };
+	}
+
+	HeadlessIoController::Statistics HeadlessIoController::GetStatistics() const
+	{
+		return statistics_;
+	}
+
+	void HeadlessIoController::SetInputLog(const std::shared_ptr<InputLog>& inputLog)
+	{
+		inputLog_ = inputLog;
+	}
+
+	void HeadlessIoController::SetVideoRecorder(const std::shared_ptr<VideoRecorder>& videoRecorder)
+	{
+		videoRecorder_ = videoRecorder;
+	}
+
+	void HeadlessIoController::SetInputScript(std::function<uint16_t(uint64_t frame)> inputScript)
+	{
+		inputScript_ = std::move(inputScript);
+	}
+
+	void HeadlessIoController::SetCheckpointInterval(uint64_t checkpointInterval)
+	{
+		checkpointInterval_ = checkpointInterval;
+		frameHashChain_ = 0xCBF29CE484222325;
+		checkpoints_.clear();
+	}
+
+	void HeadlessIoController::SetSaveEveryFrame(bool saveEveryFrame)
+	{
+		saveEveryFrame_ = saveEveryFrame;
+	}
+
+	const std::vector<uint64_t>& HeadlessIoController::GetCheckpoints() const
+	{
+		return checkpoints_;
+	}
+} // namespace i8080_arcade
@@ -0,0 +1,258 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include "i8080_arcade/InputLog.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		constexpr std::array<char, 8> magic{ 'i', '8', '0', '8', '0', 'i', 'n', 'p' };
+		constexpr size_t headerSize = 32;
+
+		template<typename T>
+		void Put(std::vector<uint8_t>& out, T value)
+		{
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+			}
+		}
+
+		template<typename T>
+		T Get(const uint8_t* in)
+		{
+			uint64_t value = 0;
+
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				value |= uint64_t{in[i]} << (i * 8);
+			}
+
+			return static_cast<T>(value);
+		}
+
+		void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+		{
+			while (value >= 0x80)
+			{
+				out.push_back(static_cast<uint8_t>(value | 0x80));
+				value >>= 7;
+			}
+
+			out.push_back(static_cast<uint8_t>(value));
+		}
+
+		// Returns false when the varint runs past the end of the data
+		bool GetVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& value)
+		{
+			value = 0;
+
+			for (size_t shift = 0; shift < 64 && pos < size; shift += 7)
+			{
+				auto byte = data[pos++];
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+				if ((byte & 0x80) == 0)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+	} // namespace
+
+	InputLog::InputLog(const std::filesystem::path& path)
+		: mappedFile_{ path }
+	{
+		auto data = mappedFile_.Data();
+		auto size = mappedFile_.Size();
+
+		if (size < headerSize || std::memcmp(data, magic.data(), magic.size()) != 0)
+		{
+			throw std::runtime_error("The file is not an i8080 arcade input log");
+		}
+
+		if (Get<uint16_t>(data + 8) > version_)
+		{
+			throw std::runtime_error("The input log was written by a newer version of i8080 arcade");
+		}
+
+		frames_ = Get<uint64_t>(data + 16);
+		recordedFrameHash_ = Get<uint64_t>(data + 24);
+
+		// Validate the changes up front so that replaying them on the machine thread can't fail
+		size_t pos = headerSize;
+		uint64_t frame = 0;
+
+		while (pos < size)
+		{
+			uint64_t delta = 0;
+
+			// The frame delta is followed by the port and its value
+			if (GetVarint(data, size, pos, delta) == false || size - pos < 2)
+			{
+				throw std::runtime_error("The input log is truncated");
+			}
+
+			auto port = data[pos];
+			frame += delta;
+			pos += 2;
+
+			if ((port != 1 && port != 2) || frame == 0 || frame > frames_)
+			{
+				throw std::runtime_error("The input log is corrupt");
+			}
+		}
+
+		position_ = headerSize;
+		ReadNextFrame();
+	}
+
+	void InputLog::ReadNextFrame()
+	{
+		uint64_t delta = 0;
+
+		if (GetVarint(mappedFile_.Data(), mappedFile_.Size(), position_, delta) == true)
+		{
+			nextFrame_ += delta;
+		}
+		else
+		{
+			nextFrame_ = std::numeric_limits<uint64_t>::max();
+		}
+	}
+
+	bool InputLog::Replaying() const
+	{
+		return mappedFile_.Data() != nullptr;
+	}
+
+	uint16_t InputLog::Latch(uint16_t inputPorts)
+	{
+		frame_++;
+
+		if (Replaying() == true)
+		{
+			auto data = mappedFile_.Data();
+
+			while (nextFrame_ == frame_)
+			{
+				auto port = data[position_];
+				auto value = data[position_ + 1];
+				position_ += 2;
+				inputPorts_ = port == 1 ? (inputPorts_ & 0xFF00) | value : (inputPorts_ & 0x00FF) | (value << 8);
+				ReadNextFrame();
+			}
+
+			return inputPorts_;
+		}
+
+		for (uint8_t port = 1; port <= 2; port++)
+		{
+			auto shift = (port - 1) * 8;
+			uint8_t value = inputPorts >> shift;
+
+			if (value != static_cast<uint8_t>(inputPorts_ >> shift))
+			{
+				PutVarint(entries_, frame_ - lastFrame_);
+				entries_.push_back(port);
+				entries_.push_back(value);
+				lastFrame_ = frame_;
+			}
+		}
+
+		inputPorts_ = inputPorts;
+		return inputPorts_;
+	}
+
+	bool InputLog::Finished() const
+	{
+		return Replaying() == true && frame_ >= frames_;
+	}
+
+	uint64_t InputLog::Frame() const
+	{
+		return frame_;
+	}
+
+	uint64_t InputLog::Frames() const
+	{
+		return frames_;
+	}
+
+	void InputLog::SetFrameHash(uint64_t frameHash)
+	{
+		frameHash_ = frameHash;
+	}
+
+	uint64_t InputLog::FrameHash() const
+	{
+		return frameHash_;
+	}
+
+	uint64_t InputLog::RecordedFrameHash() const
+	{
+		return recordedFrameHash_;
+	}
+
+	void InputLog::Save(const std::filesystem::path& path) const
+	{
+		std::vector<uint8_t> header;
+
+		header.insert(header.end(), magic.begin(), magic.end());
+		Put<uint16_t>(header, version_);
+		Put<uint16_t>(header, 0);
+		Put<uint32_t>(header, 0);
+		Put<uint64_t>(header, frame_);
+		Put<uint64_t>(header, frameHash_);
+
+		auto tmpPath = path;
+		tmpPath += ".tmp";
+
+		{
+			std::ofstream fout(tmpPath, std::ios::binary | std::ios::trunc);
+
+			if (!fout)
+			{
+				throw std::runtime_error("The input log file failed to open");
+			}
+
+			fout.write(reinterpret_cast<const char*>(header.data()), header.size());
+			fout.write(reinterpret_cast<const char*>(entries_.data()), entries_.size());
+
+			if (!fout)
+			{
+				throw std::runtime_error("Failed to write the input log");
+			}
+		}
+
+		std::filesystem::rename(tmpPath, path);
+	}
+} // namespace i8080_arcade
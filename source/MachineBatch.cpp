@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include "i8080_arcade/MachineBatch.h"
+#include "i8080_arcade/MappedMemoryController.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		ptrdiff_t ThreadCount(size_t threads)
+		{
+			if (threads == 0)
+			{
+				threads = std::max(1u, std::thread::hardware_concurrency());
+			}
+
+			return static_cast<ptrdiff_t>(std::min<size_t>(threads, std::counting_semaphore<>::max()));
+		}
+	} // namespace
+
+	MachineBatch::MachineBatch(const nlohmann::json& hardware, const nlohmann::json& software, const std::string& game, const std::filesystem::path& romFilePath, size_t instances, size_t threads, uint32_t framesPerStep)
+		: observations_(instances * BatchIoController::observationSize_),
+		running_{ ThreadCount(threads) },
+		framesPerStep_{ framesPerStep }
+	{
+		if (instances == 0)
+		{
+			throw std::invalid_argument("A machine batch must have at least one instance");
+		}
+
+		const auto& arcadeGame = software.at(game);
+		auto machEmu = hardware["mach-emu"];
+		// The instances are paced by Step, run them as fast as possible
+		machEmu["clockResolution"] = -1;
+		// Step relies on the machine running on its own thread
+		machEmu["runAsync"] = true;
+		// Serialised once rather than per instance
+		const auto machineOptions = machEmu.dump();
+		const auto memoryOptions = arcadeGame["memory"].dump();
+
+		instances_.reserve(instances);
+
+		// Every instance loads from the same rom pack when there is one, it is mapped and verified once
+		std::optional<RomPack> romPack;
+		auto romPackFile = RomPack::Path(romFilePath, game);
+
+		if (std::filesystem::exists(romPackFile) == true)
+		{
+			romPack.emplace(romPackFile);
+			romPack->CheckConfig(game, arcadeGame["memory"]["rom"]["file"]);
+		}
+
+		// Create every instance before running any, a machine which is running can't be abandoned
+		for (size_t i = 0; i < instances; i++)
+		{
+			auto memoryController = MakeMemoryController(arcadeGame["memory"]);
+			auto observation = std::span(observations_).subspan(i * BatchIoController::observationSize_, BatchIoController::observationSize_);
+			auto ioController = std::make_shared<BatchIoController>(memoryController, software["video"], running_, framesPerStep, observation);
+			auto machine = MachEmu::MakeMachine(machineOptions.c_str());
+
+			if (romPack.has_value() == true)
+			{
+				memoryController->LoadRoms(*romPack);
+			}
+			else
+			{
+				memoryController->LoadRoms(romFilePath, arcadeGame["memory"]["rom"]["file"]);
+			}
+
+			machine->SetOptions(memoryOptions.c_str());
+			machine->SetMemoryController(memoryController);
+			machine->SetIoController(ioController);
+			instances_.push_back({ std::move(machine), std::move(ioController) });
+		}
+
+		for (auto& instance : instances_)
+		{
+			instance.machine->Run(0x00);
+		}
+
+		for (auto& instance : instances_)
+		{
+			instance.ioController->WaitUntilDone();
+		}
+
+		frames_ = framesPerStep_;
+	}
+
+	MachineBatch::~MachineBatch()
+	{
+		for (auto& instance : instances_)
+		{
+			instance.ioController->Quit();
+		}
+
+		for (auto& instance : instances_)
+		{
+			instance.machine->WaitForCompletion();
+		}
+	}
+
+	size_t MachineBatch::Size() const
+	{
+		return instances_.size();
+	}
+
+	void MachineBatch::Step(std::span<const uint16_t> inputPorts)
+	{
+		if (inputPorts.size() != instances_.size())
+		{
+			throw std::invalid_argument("Step requires one set of inputs per instance");
+		}
+
+		for (size_t i = 0; i < instances_.size(); i++)
+		{
+			instances_[i].ioController->Go(inputPorts[i]);
+		}
+
+		for (auto& instance : instances_)
+		{
+			instance.ioController->WaitUntilDone();
+		}
+
+		frames_ += framesPerStep_;
+	}
+
+	std::span<const uint8_t> MachineBatch::Observations() const
+	{
+		return observations_;
+	}
+
+	std::span<const uint8_t> MachineBatch::Observation(size_t instance) const
+	{
+		if (instance >= instances_.size())
+		{
+			throw std::out_of_range("The instance does not exist");
+		}
+
+		return std::span(observations_).subspan(instance * BatchIoController::observationSize_, BatchIoController::observationSize_);
+	}
+
+	uint64_t MachineBatch::Frames() const
+	{
+		return frames_;
+	}
+} // namespace i8080_arcade
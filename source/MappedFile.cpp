@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "i8080_arcade/MappedFile.h"
+
+namespace i8080_arcade
+{
+	MappedFile::MappedFile(const std::filesystem::path& path)
+	{
+#ifdef _WIN32
+		auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("The file to map failed to open");
+		}
+
+		LARGE_INTEGER size{};
+
+		if (GetFileSizeEx(file, &size) == FALSE || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("The file to map is empty");
+		}
+
+		// The mapping holds its own reference to the file
+		mapping_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+
+		if (mapping_ == nullptr)
+		{
+			throw std::runtime_error("Failed to map the file");
+		}
+
+		data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+		if (data_ == nullptr)
+		{
+			CloseHandle(mapping_);
+			mapping_ = nullptr;
+			throw std::runtime_error("Failed to map the file");
+		}
+
+		size_ = static_cast<size_t>(size.QuadPart);
+#else
+		auto fd = open(path.c_str(), O_RDONLY);
+
+		if (fd < 0)
+		{
+			throw std::runtime_error("The file to map failed to open");
+		}
+
+		struct stat st{};
+
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close(fd);
+			throw std::runtime_error("The file to map is empty");
+		}
+
+		// The mapping holds its own reference to the file
+		auto data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		if (data == MAP_FAILED)
+		{
+			throw std::runtime_error("Failed to map the file");
+		}
+
+		data_ = static_cast<const uint8_t*>(data);
+		size_ = static_cast<size_t>(st.st_size);
+#endif
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Unmap();
+			data_ = std::exchange(other.data_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+			mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+		}
+
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Unmap();
+	}
+
+	void MappedFile::Unmap()
+	{
+		if (data_ != nullptr)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(data_);
+			CloseHandle(mapping_);
+			mapping_ = nullptr;
+#else
+			munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+			data_ = nullptr;
+			size_ = 0;
+		}
+	}
+
+	const uint8_t* MappedFile::Data() const
+	{
+		return data_;
+	}
+
+	size_t MappedFile::Size() const
+	{
+		return size_;
+	}
+} // namespace i8080_arcade
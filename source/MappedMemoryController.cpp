@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <vector>
+
+#include "i8080_arcade/MappedMemoryController.h"
+
+namespace i8080_arcade
+{
+	std::shared_ptr<MemoryController> MakeMemoryController(const nlohmann::json& memory, int framePoolSize)
+	{
+		std::vector<MemoryRegion> roms;
+
+		for (const auto& file : memory["rom"]["file"])
+		{
+			roms.push_back({ file["offset"].get<uint32_t>(), file["size"].get<uint32_t>() });
+		}
+
+		// The same function builds the compile time tables, a layout matches when every page has the same type
+		auto pages = MakePageTable(roms);
+
+		if (pages == InvadersMemoryMap::pages)
+		{
+			return std::make_shared<MappedMemoryController<InvadersMemoryMap>>(framePoolSize);
+		}
+		else if (pages == ExtendedMemoryMap<0x0800>::pages)
+		{
+			return std::make_shared<MappedMemoryController<ExtendedMemoryMap<0x0800>>>(framePoolSize);
+		}
+		else if (pages == ExtendedMemoryMap<0x1000>::pages)
+		{
+			return std::make_shared<MappedMemoryController<ExtendedMemoryMap<0x1000>>>(framePoolSize);
+		}
+
+		// An unknown layout, leave the whole address space writable
+		return std::make_shared<MemoryController>(framePoolSize);
+	}
+} // namespace i8080_arcade
@@ -24,6 +24,7 @@ SOFTWARE.
 #include <cstring>
 #include <fstream>
 
+#include "i8080_arcade/FrameTiming.h"
 #include "i8080_arcade/MemoryController.h"
 
 namespace i8080_arcade
@@ -31,26 +32,93 @@ namespace i8080_arcade
 	MemoryController::MemoryController(int framePoolSize)
 		: memory_{ std::make_unique<uint8_t[]>(memorySize_) }
 	{
-		framePool_ = meen_hw::MH_ResourcePool<std::array<uint8_t, 7168>>();
+		framePool_ = meen_hw::MH_ResourcePool<VideoFrame>();
 
 		for(int i = 0; i < framePoolSize; i++)
 		{
-			framePool_.AddResource(new std::array<uint8_t, 7168>);
+			// A sequence number of 0 marks the frame as never filled
+			framePool_.AddResource(new VideoFrame{});
 		}
 	}
 
-	meen_hw::MH_ResourcePool<std::array<uint8_t, 7168>>::ResourcePtr MemoryController::GetVideoFrame() const
+	void MemoryController::FillVideoFrame(VideoFrame& frame, int64_t interruptTime)
+	{
+		auto sequence = ++frameSequence_;
+		dirtyRowHistory_[sequence % dirtyRowHistory_.size()] = dirtyRows_;
+
+		// Gather the rows that changed since this frame was last filled
+		std::array<uint64_t, 4> staleRows{};
+
+		if (frame.sequence == 0 || sequence - frame.sequence > dirtyRowHistory_.size())
+		{
+			staleRows.fill(~uint64_t{0});
+		}
+		else
+		{
+			for (auto s = frame.sequence + 1; s <= sequence; s++)
+			{
+				const auto& dirtyRows = dirtyRowHistory_[s % dirtyRowHistory_.size()];
+
+				for (size_t i = 0; i < staleRows.size(); i++)
+				{
+					staleRows[i] |= dirtyRows[i];
+				}
+			}
+		}
+
+		for (size_t row = 0; row < VideoFrame::rows; row++)
+		{
+			if (staleRows[row >> 6] & (uint64_t{1} << (row & 63)))
+			{
+				auto offset = row * VideoFrame::rowBytes;
+				std::copy_n(memory_.get() + vramOffset_ + offset, VideoFrame::rowBytes, frame.vram.begin() + offset);
+			}
+		}
+
+		frame.dirtyRows = dirtyRows_;
+		frame.sequence = sequence;
+		frame.interruptTime = interruptTime;
+		// Only read the clock when the frame is being timed
+		frame.copiedTime = interruptTime == 0 ? 0 : FrameTiming::Now();
+		dirtyRows_.fill(0);
+	}
+
+	VideoFramePtr MemoryController::GetVideoFrame(int64_t interruptTime)
 	{
 		auto frame = framePool_.GetResource();
 
 		if(frame != nullptr)
 		{
-			std::copy_n(memory_.get() + 0x2400, frame->size(), frame->begin());
+			FillVideoFrame(*frame, interruptTime);
 		}
 
 		return frame;
 	}
 
+	void MemoryController::PublishVideoFrame(int64_t interruptTime)
+	{
+		auto& frame = videoFrames_[backFrame_];
+		FillVideoFrame(frame, interruptTime);
+		// Hand the back frame over to the consumer, the previous middle frame becomes the new back frame
+		backFrame_ = middleFrame_.exchange(backFrame_ | freshFrame_, std::memory_order_acq_rel) & ~freshFrame_;
+	}
+
+	VideoFrame* MemoryController::AcquireVideoFrame()
+	{
+		if ((middleFrame_.load(std::memory_order_relaxed) & freshFrame_) != 0)
+		{
+			frontFrame_ = middleFrame_.exchange(frontFrame_, std::memory_order_acq_rel) & ~freshFrame_;
+		}
+
+		auto& frame = videoFrames_[frontFrame_];
+		return frame.sequence == 0 ? nullptr : &frame;
+	}
+
+	bool MemoryController::VideoFramePublished() const
+	{
+		return (middleFrame_.load(std::memory_order_relaxed) & freshFrame_) != 0;
+	}
+
 	size_t MemoryController::Size() const
 	{
 		return memorySize_;
@@ -89,14 +157,61 @@ namespace i8080_arcade
 		}
 	}
 
+	void MemoryController::LoadRoms(const RomPack& romPack)
+	{
+		for (const auto& rom : romPack.Roms())
+		{
+			if (rom.data.size() > memorySize_ - rom.offset)
+			{
+				throw std::length_error("The length of the program is too big to fit at the specified offset");
+			}
+
+			std::memcpy(&memory_[rom.offset], rom.data.data(), rom.data.size());
+		}
+	}
+
+	void MemoryController::ReadBlock(uint16_t address, std::span<uint8_t> dst) const
+	{
+		if (dst.size() > memorySize_ - address)
+		{
+			throw std::out_of_range("The memory block extends beyond the end of memory");
+		}
+
+		std::copy_n(memory_.get() + address, dst.size(), dst.begin());
+	}
+
+	uint64_t MemoryController::VramHash() const
+	{
+		uint64_t hash = 0xCBF29CE484222325;
+		auto vram = memory_.get() + vramOffset_;
+
+		for (size_t i = 0; i < VideoFrame::rows * VideoFrame::rowBytes; i++)
+		{
+			hash = (hash ^ vram[i]) * 0x00000100000001B3;
+		}
+
+		return hash;
+	}
+
 	uint8_t MemoryController::Read(uint16_t addr)
 	{
+		I8080_ARCADE_PROFILE_MEMORY(Read, addr);
 		return memory_[addr];
 	}
 
 	void MemoryController::Write(uint16_t addr, uint8_t data)
 	{
-		memory_[addr] = data;
+		I8080_ARCADE_PROFILE_MEMORY(Write, addr);
+		uint16_t vramAddr = addr - vramOffset_;
+
+		if (vramAddr < VideoFrame::rows * VideoFrame::rowBytes)
+		{
+			WriteVram(addr, data);
+		}
+		else
+		{
+			memory_[addr] = data;
+		}
 	}
 
 	MachEmu::ISR MemoryController::ServiceInterrupts([[maybe_unused]] uint64_t currTime, [[maybe_unused]] uint64_t cycles)
@@ -108,4 +223,13 @@ namespace i8080_arcade
 	{
 		return{ 0x5C, 0x64, 0x7C, 0xCB, 0x71, 0x2E, 0x4A, 0x0B, 0x8A, 0x26, 0x1D, 0xE2, 0x95, 0x44, 0xA1, 0xE9 };
 	}
+
+	MemoryProfiler* MemoryController::GetMemoryProfiler()
+	{
+#ifdef I8080_ARCADE_MEMORY_PROFILE
+		return &memoryProfiler_;
+#else
+		return nullptr;
+#endif
+	}
 } // namespace i8080_arcade
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+#include "i8080_arcade/MemoryProfiler.h"
+
+namespace i8080_arcade
+{
+	void MemoryProfiler::SetSampleInterval(uint32_t sampleInterval)
+	{
+		if (sampleInterval == 0)
+		{
+			throw std::invalid_argument("The memory profile sample interval must be greater than zero");
+		}
+
+		sampleInterval_ = sampleInterval;
+		countdown_ = sampleInterval;
+	}
+
+	uint32_t MemoryProfiler::SampleInterval() const
+	{
+		return sampleInterval_;
+	}
+
+	uint32_t MemoryProfiler::AddressCount(Access access, uint16_t address) const
+	{
+		return counters_[static_cast<size_t>(access)][address].load(std::memory_order_relaxed);
+	}
+
+	std::array<uint64_t, MemoryProfiler::pages_> MemoryProfiler::PageCounts(Access access) const
+	{
+		std::array<uint64_t, pages_> pageCounts{};
+		const auto& counters = counters_[static_cast<size_t>(access)];
+
+		for (size_t address = 0; address < counters.size(); address++)
+		{
+			pageCounts[address >> pageBits_] += counters[address].load(std::memory_order_relaxed);
+		}
+
+		return pageCounts;
+	}
+
+	void MemoryProfiler::Save(const std::filesystem::path& path) const
+	{
+		std::ofstream fout(path, std::ios::trunc);
+
+		if (!fout)
+		{
+			throw std::runtime_error("The memory profile file " + path.string() + " failed to open");
+		}
+
+		if (path.extension() == ".csv")
+		{
+			fout << "address,page,reads,writes\n";
+
+			for (uint32_t address = 0; address < (1 << 16); address++)
+			{
+				auto reads = AddressCount(Access::Read, static_cast<uint16_t>(address));
+				auto writes = AddressCount(Access::Write, static_cast<uint16_t>(address));
+
+				if (reads != 0 || writes != 0)
+				{
+					char row[64];
+					snprintf(row, sizeof(row), "0x%04x,0x%02x,%u,%u\n", address, address >> pageBits_, reads, writes);
+					fout << row;
+				}
+			}
+		}
+		else
+		{
+			auto pageReads = PageCounts(Access::Read);
+			auto pageWrites = PageCounts(Access::Write);
+			auto pages = nlohmann::json::array();
+			auto addresses = nlohmann::json::object();
+
+			for (size_t page = 0; page < pages_; page++)
+			{
+				pages.push_back({ { "reads", pageReads[page] }, { "writes", pageWrites[page] } });
+			}
+
+			for (uint32_t address = 0; address < (1 << 16); address++)
+			{
+				auto reads = AddressCount(Access::Read, static_cast<uint16_t>(address));
+				auto writes = AddressCount(Access::Write, static_cast<uint16_t>(address));
+
+				if (reads != 0 || writes != 0)
+				{
+					char key[8];
+					snprintf(key, sizeof(key), "%04x", address);
+					addresses[key] = { { "reads", reads }, { "writes", writes } };
+				}
+			}
+
+			nlohmann::json profile
+			{
+				{ "sample-interval", sampleInterval_ },
+				{ "page-size", 1 << pageBits_ },
+				{ "pages", pages },
+				{ "addresses", addresses }
+			};
+
+			fout << profile.dump(4) << '\n';
+		}
+
+		if (!fout)
+		{
+			throw std::runtime_error("Failed to write the memory profile file " + path.string());
+		}
+	}
+} // namespace i8080_arcade
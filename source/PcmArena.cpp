@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+#include <stdexcept>
+
+#include "i8080_arcade/PcmArena.h"
+
+namespace i8080_arcade
+{
+	PcmArena::PcmArena(const std::vector<std::vector<uint8_t>>& samples)
+	{
+		size_t units = 0;
+
+		for (const auto& sample : samples)
+		{
+			ranges_.push_back({ units * sizeof(int16_t), sample.size() });
+			units += (sample.size() + sizeof(int16_t) - 1) / sizeof(int16_t);
+		}
+
+		// One allocation for every sample
+		data_.resize(units);
+
+		for (size_t i = 0; i < samples.size(); i++)
+		{
+			if (samples[i].empty() == false)
+			{
+				std::memcpy(reinterpret_cast<uint8_t*>(data_.data()) + ranges_[i].offset, samples[i].data(), samples[i].size());
+			}
+		}
+	}
+
+	size_t PcmArena::Count() const
+	{
+		return ranges_.size();
+	}
+
+	size_t PcmArena::Size() const
+	{
+		return data_.size() * sizeof(int16_t);
+	}
+
+	std::span<const uint8_t> PcmArena::Bytes(size_t index) const
+	{
+		const auto& range = ranges_.at(index);
+		return { reinterpret_cast<const uint8_t*>(data_.data()) + range.offset, range.size };
+	}
+
+	std::span<const int16_t> PcmArena::Pcm16(size_t index) const
+	{
+		const auto& range = ranges_.at(index);
+		return { data_.data() + range.offset / sizeof(int16_t), range.size / sizeof(int16_t) };
+	}
+} // namespace i8080_arcade
@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "i8080_arcade/MappedFile.h"
+#include "i8080_arcade/PcmCache.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		constexpr std::array<char, 8> magic{ 'i', '8', '0', '8', '0', 'p', 'c', 'm' };
+		constexpr size_t headerSize = 32;
+
+		template<typename T>
+		void Put(uint8_t* out, T value)
+		{
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				out[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8));
+			}
+		}
+
+		template<typename T>
+		T Get(const uint8_t* in)
+		{
+			uint64_t value = 0;
+
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				value |= uint64_t{in[i]} << (i * 8);
+			}
+
+			return static_cast<T>(value);
+		}
+	} // namespace
+
+	PcmCache::PcmCache(const std::filesystem::path& directory)
+		: directory_{ directory }
+	{
+		std::filesystem::create_directories(directory_);
+	}
+
+	std::filesystem::path PcmCache::EntryPath(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.pcm", static_cast<unsigned long long>(key));
+		return directory_ / name;
+	}
+
+	uint64_t PcmCache::Key(std::span<const uint8_t> file, uint16_t format, uint8_t channels, int sampleRate)
+	{
+		// FNV-1a over the file followed by the device format
+		uint64_t hash = 0xCBF29CE484222325;
+
+		auto add = [&hash](uint8_t byte)
+		{
+			hash ^= byte;
+			hash *= 0x100000001B3;
+		};
+
+		for (auto byte : file)
+		{
+			add(byte);
+		}
+
+		std::array<uint8_t, 7> deviceFormat{};
+		Put<uint16_t>(deviceFormat.data(), format);
+		Put<uint8_t>(deviceFormat.data() + 2, channels);
+		Put<uint32_t>(deviceFormat.data() + 3, static_cast<uint32_t>(sampleRate));
+
+		for (auto byte : deviceFormat)
+		{
+			add(byte);
+		}
+
+		return hash;
+	}
+
+	bool PcmCache::Load(uint64_t key, std::vector<uint8_t>& pcm) const
+	{
+		auto path = EntryPath(key);
+
+		if (std::filesystem::exists(path) == false)
+		{
+			return false;
+		}
+
+		try
+		{
+			MappedFile entry(path);
+			auto data = entry.Data();
+			auto size = entry.Size();
+
+			// A corrupt or foreign entry is a miss, it is replaced when the sample is stored
+			if (size < headerSize || std::memcmp(data, magic.data(), magic.size()) != 0 || Get<uint16_t>(data + 8) != version_
+				|| Get<uint64_t>(data + 16) != key || Get<uint64_t>(data + 24) != size - headerSize)
+			{
+				return false;
+			}
+
+			pcm.assign(data + headerSize, data + size);
+			return true;
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+	}
+
+	void PcmCache::Store(uint64_t key, std::span<const uint8_t> pcm) const
+	{
+		std::array<uint8_t, headerSize> header{};
+
+		std::memcpy(header.data(), magic.data(), magic.size());
+		Put<uint16_t>(header.data() + 8, version_);
+		Put<uint64_t>(header.data() + 16, key);
+		Put<uint64_t>(header.data() + 24, pcm.size());
+
+		auto path = EntryPath(key);
+		// Unique per thread so that loaders storing the same entry don't write over each other
+		auto tmpPath = path;
+		tmpPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+		{
+			std::ofstream fout(tmpPath, std::ios::binary | std::ios::trunc);
+
+			if (!fout)
+			{
+				throw std::runtime_error("The audio cache file failed to open");
+			}
+
+			fout.write(reinterpret_cast<const char*>(header.data()), header.size());
+			fout.write(reinterpret_cast<const char*>(pcm.data()), pcm.size());
+
+			if (!fout)
+			{
+				throw std::runtime_error("Failed to write the audio cache file");
+			}
+		}
+
+		std::filesystem::rename(tmpPath, path);
+	}
+} // namespace i8080_arcade
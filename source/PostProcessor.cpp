@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "i8080_arcade/PostProcessor.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		void PhosphorScalar(const uint32_t* src, uint32_t* persist, size_t pixels, uint8_t decay)
+		{
+			for (size_t i = 0; i < pixels; i++)
+			{
+				uint32_t out = 0;
+
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					auto lit = (src[i] >> shift) & 0xFF;
+					auto decayed = (((persist[i] >> shift) & 0xFF) * decay) >> 8;
+					out |= std::max(lit, decayed) << shift;
+				}
+
+				persist[i] = out;
+			}
+		}
+
+		void DimScalar(const uint32_t* src, uint32_t* dst, size_t pixels, uint8_t level)
+		{
+			for (size_t i = 0; i < pixels; i++)
+			{
+				uint32_t out = src[i] & 0xFF000000;
+
+				for (int shift = 0; shift < 24; shift += 8)
+				{
+					out |= ((((src[i] >> shift) & 0xFF) * level) >> 8) << shift;
+				}
+
+				dst[i] = out;
+			}
+		}
+
+		void UpscaleScalar(const uint32_t* src, uint32_t* dst, size_t pixels, int scale)
+		{
+			for (size_t x = 0; x < pixels; x++)
+			{
+				std::fill_n(dst + x * scale, scale, src[x]);
+			}
+		}
+
+		// A fraction from 0 to 1 as a level out of 256, saturated to 255
+		uint8_t Level(double fraction)
+		{
+			return static_cast<uint8_t>(std::lround(std::clamp(fraction, 0.0, 1.0) * 255));
+		}
+	} // namespace
+
+	bool PostProcessor::Options::Enabled() const
+	{
+		return scale > 1 || scanlines > 0 || phosphor > 0;
+	}
+
+	PostProcessor::PostProcessor(int width, int height, const Options& options, const std::string& kernel)
+		: width_{ width },
+		height_{ height },
+		scale_{ options.scale }
+	{
+		if (width <= 0 || height <= 0 || options.scale < 1 || options.scale > 8)
+		{
+			throw std::invalid_argument("The post process scale must be from 1 to 8");
+		}
+
+		if (options.scanlines < 0 || options.scanlines > 1 || options.phosphor < 0 || options.phosphor > 1)
+		{
+			throw std::invalid_argument("The post process scanlines and phosphor must be from 0 to 1");
+		}
+
+		// There is no row to darken at a scale of 1
+		scanlineLevel_ = options.scanlines > 0 && options.scale > 1 ? Level(1 - options.scanlines) : 0;
+		phosphorDecay_ = Level(options.phosphor);
+
+		auto kernels = AvailableKernels();
+
+		if (kernel == "auto")
+		{
+			kernel_ = kernels.back();
+		}
+		else
+		{
+			auto it = std::find_if(kernels.begin(), kernels.end(), [&kernel](const Kernel& k) { return kernel == k.name; });
+
+			if (it == kernels.end())
+			{
+				throw std::invalid_argument("The post process kernel is unknown or not supported by this CPU");
+			}
+
+			kernel_ = *it;
+		}
+
+		if (phosphorDecay_ > 0)
+		{
+			persistence_.resize(static_cast<size_t>(width) * height);
+		}
+
+		auto bands = options.threads;
+
+		if (bands == 0)
+		{
+			// Leave a hardware thread each for the machine and the renderer, a few bands are enough for a frame this size
+			bands = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 2u) - 2, 3) + 1;
+		}
+
+		bands = std::min<size_t>(bands, static_cast<size_t>(height));
+		scaledRows_.resize(bands, std::vector<uint32_t>(static_cast<size_t>(width) * scale_));
+
+		for (size_t band = 1; band < bands; band++)
+		{
+			workers_.emplace_back([this, band]()
+			{
+				uint64_t generation = 0;
+
+				for (;;)
+				{
+					std::unique_lock lock(mutex_);
+					workReady_.wait(lock, [this, generation] { return stopping_ == true || generation_ != generation; });
+
+					if (stopping_ == true)
+					{
+						return;
+					}
+
+					generation = generation_;
+					auto job = job_;
+					lock.unlock();
+
+					ProcessBand(job, band);
+
+					lock.lock();
+
+					if (--bandsPending_ == 0)
+					{
+						workDone_.notify_one();
+					}
+				}
+			});
+		}
+	}
+
+	PostProcessor::~PostProcessor()
+	{
+		{
+			std::scoped_lock lock(mutex_);
+			stopping_ = true;
+		}
+
+		workReady_.notify_all();
+
+		for (auto& worker : workers_)
+		{
+			worker.join();
+		}
+	}
+
+	int PostProcessor::Width() const
+	{
+		return width_ * scale_;
+	}
+
+	int PostProcessor::Height() const
+	{
+		return height_ * scale_;
+	}
+
+	const char* PostProcessor::KernelName() const
+	{
+		return kernel_.name;
+	}
+
+	size_t PostProcessor::Bands() const
+	{
+		return workers_.size() + 1;
+	}
+
+	bool PostProcessor::Persistent() const
+	{
+		return phosphorDecay_ > 0;
+	}
+
+	VramBlitter::Region PostProcessor::Scale(const VramBlitter::Region& region) const
+	{
+		return { region.x * scale_, region.y * scale_, region.w * scale_, region.h * scale_ };
+	}
+
+	void PostProcessor::ProcessBand(const Job& job, size_t band)
+	{
+		auto bands = Bands();
+		auto firstRow = job.region.y + static_cast<int>(job.region.h * band / bands);
+		auto lastRow = job.region.y + static_cast<int>(job.region.h * (band + 1) / bands);
+		auto pixels = static_cast<size_t>(job.region.w);
+		auto& scaledRow = scaledRows_[band];
+
+		for (auto y = firstRow; y < lastRow; y++)
+		{
+			auto offset = static_cast<size_t>(y) * width_ + job.region.x;
+			auto row = job.src + offset;
+
+			if (phosphorDecay_ > 0)
+			{
+				kernel_.phosphor(row, persistence_.data() + offset, pixels, phosphorDecay_);
+				row = persistence_.data() + offset;
+			}
+
+			// Scale into system memory, the texture may be write combined and slow to read back
+			auto scaled = scaledRow.data();
+			kernel_.upscale(row, scaled, pixels, scale_);
+
+			auto out = job.dst + static_cast<ptrdiff_t>(y - job.region.y) * scale_ * job.pitch;
+			auto bytes = pixels * scale_ * sizeof(uint32_t);
+
+			for (int subRow = 0; subRow < scale_; subRow++, out += job.pitch)
+			{
+				if (subRow == scale_ - 1 && scanlineLevel_ > 0)
+				{
+					kernel_.dim(scaled, reinterpret_cast<uint32_t*>(out), pixels * scale_, scanlineLevel_);
+				}
+				else
+				{
+					std::memcpy(out, scaled, bytes);
+				}
+			}
+		}
+	}
+
+	void PostProcessor::Process(const uint32_t* src, const VramBlitter::Region& region, uint8_t* dst, int pitch)
+	{
+		Job job{ src, region, dst, pitch };
+
+		if (workers_.empty() == true)
+		{
+			ProcessBand(job, 0);
+			return;
+		}
+
+		{
+			std::scoped_lock lock(mutex_);
+			job_ = job;
+			bandsPending_ = workers_.size();
+			generation_++;
+		}
+
+		workReady_.notify_all();
+		ProcessBand(job, 0);
+
+		std::unique_lock lock(mutex_);
+		workDone_.wait(lock, [this] { return bandsPending_ == 0; });
+	}
+
+	std::vector<PostProcessor::Kernel> PostProcessor::AvailableKernels()
+	{
+		std::vector<Kernel> kernels{ { "scalar", PhosphorScalar, DimScalar, UpscaleScalar } };
+		// The blitter has already checked what the CPU supports
+		auto blitKernels = VramBlitter::AvailableKernels();
+		auto supported = [&blitKernels](const char* name)
+		{
+			return std::any_of(blitKernels.begin(), blitKernels.end(), [name](const VramBlitter::Kernel& k) { return std::strcmp(k.name, name) == 0; });
+		};
+
+		if (auto sse2 = PostProcessSse2Kernel(); sse2.has_value() == true)
+		{
+			kernels.push_back(*sse2);
+		}
+
+		if (auto neon = PostProcessNeonKernel(); neon.has_value() == true && supported("neon") == true)
+		{
+			kernels.push_back(*neon);
+		}
+
+		return kernels;
+	}
+} // namespace i8080_arcade
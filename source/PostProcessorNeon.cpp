@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "i8080_arcade/PostProcessor.h"
+
+// On armv7 this translation unit is compiled with NEON code generation enabled, its kernel
+// must only be called after checking that the CPU supports NEON.
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		// Multiply each 8 bit channel by level / 256
+		uint8x16_t Scale8(uint8x16_t v, uint8x8_t level)
+		{
+			auto lo = vshrn_n_u16(vmull_u8(vget_low_u8(v), level), 8);
+			auto hi = vshrn_n_u16(vmull_u8(vget_high_u8(v), level), 8);
+			return vcombine_u8(lo, hi);
+		}
+
+		void PhosphorNeon(const uint32_t* src, uint32_t* persist, size_t pixels, uint8_t decay)
+		{
+			const auto level = vdup_n_u8(decay);
+			size_t i = 0;
+
+			for (; i + 4 <= pixels; i += 4)
+			{
+				auto lit = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+				auto decayed = Scale8(vld1q_u8(reinterpret_cast<const uint8_t*>(persist + i)), level);
+				vst1q_u8(reinterpret_cast<uint8_t*>(persist + i), vmaxq_u8(lit, decayed));
+			}
+
+			for (; i < pixels; i++)
+			{
+				uint32_t out = 0;
+
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					auto lit = (src[i] >> shift) & 0xFF;
+					auto decayed = (((persist[i] >> shift) & 0xFF) * decay) >> 8;
+					out |= (lit > decayed ? lit : decayed) << shift;
+				}
+
+				persist[i] = out;
+			}
+		}
+
+		void DimNeon(const uint32_t* src, uint32_t* dst, size_t pixels, uint8_t level)
+		{
+			const auto levels = vdup_n_u8(level);
+			const auto alpha = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000));
+			size_t i = 0;
+
+			for (; i + 4 <= pixels; i += 4)
+			{
+				auto v = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+				vst1q_u8(reinterpret_cast<uint8_t*>(dst + i), vbslq_u8(alpha, v, Scale8(v, levels)));
+			}
+
+			for (; i < pixels; i++)
+			{
+				uint32_t out = src[i] & 0xFF000000;
+
+				for (int shift = 0; shift < 24; shift += 8)
+				{
+					out |= ((((src[i] >> shift) & 0xFF) * level) >> 8) << shift;
+				}
+
+				dst[i] = out;
+			}
+		}
+
+		void UpscaleNeon(const uint32_t* src, uint32_t* dst, size_t pixels, int scale)
+		{
+			size_t i = 0;
+
+			// The common window scales, the interleaving stores write each lane 2 or 3 times in a row
+			if (scale == 2)
+			{
+				for (; i + 4 <= pixels; i += 4)
+				{
+					auto v = vld1q_u32(src + i);
+					vst2q_u32(dst + i * 2, (uint32x4x2_t{ { v, v } }));
+				}
+			}
+			else if (scale == 3)
+			{
+				for (; i + 4 <= pixels; i += 4)
+				{
+					auto v = vld1q_u32(src + i);
+					vst3q_u32(dst + i * 3, (uint32x4x3_t{ { v, v, v } }));
+				}
+			}
+
+			for (; i < pixels; i++)
+			{
+				for (int j = 0; j < scale; j++)
+				{
+					dst[i * scale + j] = src[i];
+				}
+			}
+		}
+	} // namespace
+
+	std::optional<PostProcessor::Kernel> PostProcessNeonKernel()
+	{
+		return PostProcessor::Kernel{ "neon", PhosphorNeon, DimNeon, UpscaleNeon };
+	}
+} // namespace i8080_arcade
+#else
+namespace i8080_arcade
+{
+	std::optional<PostProcessor::Kernel> PostProcessNeonKernel()
+	{
+		return std::nullopt;
+	}
+} // namespace i8080_arcade
+#endif
@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "i8080_arcade/PostProcessor.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		// Multiply each 8 bit channel by level / 256
+		__m128i Scale8(__m128i v, __m128i level)
+		{
+			const auto zero = _mm_setzero_si128();
+			auto lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), level), 8);
+			auto hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), level), 8);
+			return _mm_packus_epi16(lo, hi);
+		}
+
+		void PhosphorSse2(const uint32_t* src, uint32_t* persist, size_t pixels, uint8_t decay)
+		{
+			const auto level = _mm_set1_epi16(decay);
+			size_t i = 0;
+
+			for (; i + 4 <= pixels; i += 4)
+			{
+				auto lit = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				auto decayed = Scale8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(persist + i)), level);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(persist + i), _mm_max_epu8(lit, decayed));
+			}
+
+			for (; i < pixels; i++)
+			{
+				uint32_t out = 0;
+
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					auto lit = (src[i] >> shift) & 0xFF;
+					auto decayed = (((persist[i] >> shift) & 0xFF) * decay) >> 8;
+					out |= (lit > decayed ? lit : decayed) << shift;
+				}
+
+				persist[i] = out;
+			}
+		}
+
+		void DimSse2(const uint32_t* src, uint32_t* dst, size_t pixels, uint8_t level)
+		{
+			const auto levels = _mm_set1_epi16(level);
+			const auto alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+			size_t i = 0;
+
+			for (; i + 4 <= pixels; i += 4)
+			{
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				auto dimmed = _mm_andnot_si128(alpha, Scale8(v, levels));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(dimmed, _mm_and_si128(v, alpha)));
+			}
+
+			for (; i < pixels; i++)
+			{
+				uint32_t out = src[i] & 0xFF000000;
+
+				for (int shift = 0; shift < 24; shift += 8)
+				{
+					out |= ((((src[i] >> shift) & 0xFF) * level) >> 8) << shift;
+				}
+
+				dst[i] = out;
+			}
+		}
+
+		void UpscaleSse2(const uint32_t* src, uint32_t* dst, size_t pixels, int scale)
+		{
+			size_t i = 0;
+
+			// The common window scales, any other scale is handled by the tail loop
+			if (scale == 2)
+			{
+				for (; i + 4 <= pixels; i += 4)
+				{
+					auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_unpacklo_epi32(v, v));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 + 4), _mm_unpackhi_epi32(v, v));
+				}
+			}
+			else if (scale == 3)
+			{
+				for (; i + 4 <= pixels; i += 4)
+				{
+					auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 8), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+				}
+			}
+
+			for (; i < pixels; i++)
+			{
+				for (int j = 0; j < scale; j++)
+				{
+					dst[i * scale + j] = src[i];
+				}
+			}
+		}
+	} // namespace
+
+	std::optional<PostProcessor::Kernel> PostProcessSse2Kernel()
+	{
+		return PostProcessor::Kernel{ "sse2", PhosphorSse2, DimSse2, UpscaleSse2 };
+	}
+} // namespace i8080_arcade
+#else
+namespace i8080_arcade
+{
+	std::optional<PostProcessor::Kernel> PostProcessSse2Kernel()
+	{
+		return std::nullopt;
+	}
+} // namespace i8080_arcade
+#endif
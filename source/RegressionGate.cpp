@@ -0,0 +1,195 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "i8080_arcade/RegressionGate.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		std::string Hex(uint64_t value)
+		{
+			char hex[17];
+			snprintf(hex, sizeof(hex), "%016" PRIx64, value);
+			return hex;
+		}
+
+		nlohmann::json LoadFile(const std::filesystem::path& file, int version)
+		{
+			if (std::filesystem::exists(file) == false)
+			{
+				return nlohmann::json{ { "version", version }, { "games", nlohmann::json::object() } };
+			}
+
+			std::ifstream fin(file);
+			auto json = nlohmann::json::parse(fin, nullptr, false);
+
+			if (json.is_discarded() == true || json.is_object() == false || json.value("version", 0) != version || json.contains("games") == false)
+			{
+				throw std::runtime_error("The gate file " + file.string() + " is not a valid version " + std::to_string(version) + " gate file");
+			}
+
+			return json;
+		}
+
+		void SaveFile(const std::filesystem::path& file, const nlohmann::json& json)
+		{
+			// Replaced in full so that a failed update never leaves a truncated file behind
+			auto tmpPath = file;
+			tmpPath += ".tmp";
+
+			{
+				std::ofstream fout(tmpPath, std::ios::trunc);
+
+				if (!fout)
+				{
+					throw std::runtime_error("The gate file " + file.string() + " failed to open");
+				}
+
+				fout << json.dump(4) << '\n';
+
+				if (!fout)
+				{
+					throw std::runtime_error("Failed to write the gate file " + file.string());
+				}
+			}
+
+			std::filesystem::rename(tmpPath, file);
+		}
+	} // namespace
+
+	bool RegressionGate::Verdict::Passed() const
+	{
+		return hasGolden == true && firstMismatchFrame < 0 && regressed == false;
+	}
+
+	RegressionGate::RegressionGate(const std::filesystem::path& goldenFile, const std::filesystem::path& baselineFile, double threshold)
+		// Braces would wrap the sections in an array
+		: golden_( LoadFile(goldenFile, version_)["games"] ),
+		baseline_( LoadFile(baselineFile, version_)["games"] ),
+		threshold_{ threshold }
+	{
+		if (threshold < 0 || threshold > 1)
+		{
+			throw std::invalid_argument("The gate threshold must be from 0 to 1");
+		}
+	}
+
+	uint16_t RegressionGate::ScriptedInputs(uint64_t frame)
+	{
+		// Bit 3 of port 1 is always set, port 2 is left at 0 for 3 ships
+		uint8_t port1 = 0x08;
+
+		if (frame >= 60 && frame < 66)
+		{
+			port1 |= 0x01; // Credit
+		}
+		else if (frame >= 180 && frame < 186)
+		{
+			port1 |= 0x04; // 1P
+		}
+		else if (frame >= 300)
+		{
+			auto sweep = (frame - 300) % 240;
+
+			if (sweep < 90)
+			{
+				port1 |= 0x20; // 1P Left
+			}
+			else if (sweep >= 120 && sweep < 210)
+			{
+				port1 |= 0x40; // 1P Right
+			}
+
+			if (frame % 30 < 4)
+			{
+				port1 |= 0x10; // 1P Fire
+			}
+		}
+
+		return port1;
+	}
+
+	RegressionGate::Verdict RegressionGate::Check(const Run& run) const
+	{
+		Verdict verdict;
+		verdict.cyclesPerSecond = run.wallTime > 0 ? run.cycles / (run.wallTime / 1e9) : 0;
+
+		if (golden_.contains(run.game) == true && golden_[run.game].value("frames", uint64_t{}) == run.frames)
+		{
+			const auto& checkpoints = golden_[run.game].at("checkpoints");
+			verdict.hasGolden = true;
+
+			for (size_t i = 0; i < std::max(checkpoints.size(), run.checkpoints.size()); i++)
+			{
+				if (i >= checkpoints.size() || i >= run.checkpoints.size() || checkpoints[i].get<std::string>() != Hex(run.checkpoints[i]))
+				{
+					verdict.firstMismatchFrame = static_cast<int64_t>((i + 1) * checkpointInterval_ - 1);
+					break;
+				}
+			}
+		}
+
+		if (baseline_.contains(run.game) == true)
+		{
+			verdict.baselineConcurrency = baseline_[run.game].value("concurrency", size_t{});
+
+			// The throughput depends on how many games were competing for the cores
+			if (verdict.baselineConcurrency == run.concurrency)
+			{
+				verdict.baselineCyclesPerSecond = baseline_[run.game].at("cycles-per-second").get<double>();
+				verdict.regressed = verdict.cyclesPerSecond < verdict.baselineCyclesPerSecond * (1 - threshold_);
+			}
+		}
+
+		return verdict;
+	}
+
+	void RegressionGate::Update(const std::vector<Run>& runs, const std::filesystem::path& goldenFile, const std::filesystem::path& baselineFile)
+	{
+		auto golden = LoadFile(goldenFile, version_);
+		auto baseline = LoadFile(baselineFile, version_);
+
+		for (const auto& run : runs)
+		{
+			auto checkpoints = nlohmann::json::array();
+
+			for (auto checkpoint : run.checkpoints)
+			{
+				checkpoints.push_back(Hex(checkpoint));
+			}
+
+			golden["games"][run.game] = { { "frames", run.frames }, { "checkpoints", checkpoints } };
+			baseline["games"][run.game] = { { "frames", run.frames }, { "concurrency", run.concurrency }, { "cycles-per-second", run.wallTime > 0 ? run.cycles / (run.wallTime / 1e9) : 0.0 } };
+		}
+
+		SaveFile(goldenFile, golden);
+		SaveFile(baselineFile, baseline);
+	}
+} // namespace i8080_arcade
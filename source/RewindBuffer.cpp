@@ -0,0 +1,350 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+#include "i8080_arcade/RewindBuffer.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		// A literal run ends at a run of at least this many zeros, shorter runs are cheaper as literals
+		constexpr size_t minZeroRun = 4;
+		// String values at least this long are payloads, the memory image the save state holds
+		constexpr size_t minPayloadSize = 64;
+
+		struct Segment
+		{
+			size_t offset;
+			size_t size;
+		};
+
+		void PutVarint(std::vector<uint8_t>& out, size_t value)
+		{
+			while (value >= 0x80)
+			{
+				out.push_back(static_cast<uint8_t>(value | 0x80));
+				value >>= 7;
+			}
+
+			out.push_back(static_cast<uint8_t>(value));
+		}
+
+		size_t GetVarint(const std::vector<uint8_t>& in, size_t& pos)
+		{
+			size_t value = 0;
+
+			for (size_t shift = 0; shift < 64; shift += 7)
+			{
+				if (pos == in.size())
+				{
+					break;
+				}
+
+				auto byte = in[pos++];
+				value |= static_cast<size_t>(byte & 0x7F) << shift;
+
+				if ((byte & 0x80) == 0)
+				{
+					return value;
+				}
+			}
+
+			throw std::runtime_error("The rewind delta is corrupt");
+		}
+
+		uint8_t XorAt(std::string_view key, std::string_view data, size_t i)
+		{
+			auto k = i < key.size() ? key[i] : 0;
+			return static_cast<uint8_t>(data[i] ^ k);
+		}
+
+		bool Escaped(std::string_view json, size_t quote)
+		{
+			size_t backslashes = 0;
+
+			while (backslashes < quote && json[quote - backslashes - 1] == '\\')
+			{
+				backslashes++;
+			}
+
+			return backslashes % 2 == 1;
+		}
+
+		// Split a save state into text and payload segments, alternating and starting and ending with text. Each
+		// payload is compared with the same payload of the keyframe wherever it starts, so a register or counter
+		// gaining a digit earlier in the save does not shift every byte of the memory image after it.
+		std::vector<Segment> Split(std::string_view json)
+		{
+			std::vector<Segment> segments;
+			size_t textStart = 0;
+			auto pos = json.find('"');
+
+			while (pos != std::string_view::npos)
+			{
+				auto end = json.find('"', pos + 1);
+
+				// Skip escaped quotes, a quote preceded by an odd number of backslashes
+				while (end != std::string_view::npos && Escaped(json, end) == true)
+				{
+					end = json.find('"', end + 1);
+				}
+
+				if (end == std::string_view::npos)
+				{
+					break;
+				}
+
+				if (end - pos - 1 >= minPayloadSize)
+				{
+					segments.push_back({ textStart, pos + 1 - textStart });
+					segments.push_back({ pos + 1, end - pos - 1 });
+					textStart = end;
+				}
+
+				pos = json.find('"', end + 1);
+			}
+
+			segments.push_back({ textStart, json.size() - textStart });
+			return segments;
+		}
+
+		std::string_view SegmentOf(std::string_view json, const std::vector<Segment>& segments, size_t i)
+		{
+			return i < segments.size() ? json.substr(segments[i].offset, segments[i].size) : std::string_view{};
+		}
+
+		void EncodeRuns(std::vector<uint8_t>& delta, std::string_view key, std::string_view data)
+		{
+			size_t pos = 0;
+
+			while (pos < data.size())
+			{
+				auto zeroStart = pos;
+
+				while (pos < data.size() && XorAt(key, data, pos) == 0)
+				{
+					pos++;
+				}
+
+				auto literalStart = pos;
+				size_t zeros = 0;
+
+				// Extend the literal run until the next long run of zeros
+				while (pos < data.size() && zeros < minZeroRun)
+				{
+					zeros = XorAt(key, data, pos) == 0 ? zeros + 1 : 0;
+					pos++;
+				}
+
+				if (zeros == minZeroRun)
+				{
+					pos -= zeros;
+				}
+
+				PutVarint(delta, literalStart - zeroStart);
+				PutVarint(delta, pos - literalStart);
+
+				for (auto i = literalStart; i < pos; i++)
+				{
+					delta.push_back(XorAt(key, data, i));
+				}
+			}
+		}
+
+		void DecodeRuns(const std::vector<uint8_t>& delta, size_t& in, std::string_view key, size_t size, std::string& out)
+		{
+			auto start = out.size();
+			size_t pos = 0;
+
+			// Start from the keyframe, only the runs which differ are encoded
+			out.append(key.substr(0, size));
+			out.resize(start + size, '\0');
+
+			while (pos < size)
+			{
+				auto zeros = GetVarint(delta, in);
+				auto literals = GetVarint(delta, in);
+				pos += zeros;
+
+				if ((zeros == 0 && literals == 0) || pos > size || literals > size - pos || literals > delta.size() - in)
+				{
+					throw std::runtime_error("The rewind delta is corrupt");
+				}
+
+				for (size_t i = 0; i < literals; i++, pos++)
+				{
+					out[start + pos] = static_cast<char>(out[start + pos] ^ delta[in++]);
+				}
+			}
+		}
+	} // namespace
+
+	RewindBuffer::RewindBuffer(size_t maxSnapshots, size_t budget, size_t keyframeInterval)
+		: maxSnapshots_{ maxSnapshots },
+		budget_{ budget },
+		keyframeInterval_{ keyframeInterval }
+	{
+		if (keyframeInterval == 0)
+		{
+			throw std::invalid_argument("The rewind keyframe interval must be greater than zero");
+		}
+	}
+
+	bool RewindBuffer::Enabled() const
+	{
+		return maxSnapshots_ > 0;
+	}
+
+	bool RewindBuffer::Empty() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return snapshots_ == 0;
+	}
+
+	void RewindBuffer::Push(const char* snapshot)
+	{
+		if (Enabled() == false)
+		{
+			return;
+		}
+
+		std::string current(snapshot);
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (groups_.empty() == true || groups_.back().deltas.size() + 1 >= keyframeInterval_)
+		{
+			bytes_ += current.size();
+			groups_.push_back({ std::move(current), {} });
+		}
+		else
+		{
+			auto delta = EncodeDelta(groups_.back().keyframe, current);
+			bytes_ += delta.size();
+			groups_.back().deltas.push_back(std::move(delta));
+		}
+
+		snapshots_++;
+		Evict();
+	}
+
+	bool RewindBuffer::Pop(std::string& snapshot)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (groups_.empty() == true)
+		{
+			return false;
+		}
+
+		auto& group = groups_.back();
+
+		if (group.deltas.empty() == false)
+		{
+			snapshot = DecodeDelta(group.keyframe, group.deltas.back());
+			bytes_ -= group.deltas.back().size();
+			group.deltas.pop_back();
+		}
+		else
+		{
+			bytes_ -= group.keyframe.size();
+			snapshot = std::move(group.keyframe);
+			groups_.pop_back();
+		}
+
+		snapshots_--;
+		return true;
+	}
+
+	void RewindBuffer::Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		groups_.clear();
+		snapshots_ = 0;
+		bytes_ = 0;
+	}
+
+	void RewindBuffer::Evict()
+	{
+		while (groups_.size() > 1 && (bytes_ > budget_ || snapshots_ > maxSnapshots_))
+		{
+			const auto& group = groups_.front();
+			bytes_ -= group.keyframe.size();
+
+			for (const auto& delta : group.deltas)
+			{
+				bytes_ -= delta.size();
+			}
+
+			snapshots_ -= group.deltas.size() + 1;
+			groups_.pop_front();
+		}
+	}
+
+	std::vector<uint8_t> RewindBuffer::EncodeDelta(const std::string& keyframe, const std::string& snapshot)
+	{
+		auto keySegments = Split(keyframe);
+		auto segments = Split(snapshot);
+		std::vector<uint8_t> delta;
+
+		PutVarint(delta, segments.size());
+
+		for (size_t i = 0; i < segments.size(); i++)
+		{
+			PutVarint(delta, segments[i].size);
+			EncodeRuns(delta, SegmentOf(keyframe, keySegments, i), SegmentOf(snapshot, segments, i));
+		}
+
+		return delta;
+	}
+
+	std::string RewindBuffer::DecodeDelta(const std::string& keyframe, const std::vector<uint8_t>& delta)
+	{
+		auto keySegments = Split(keyframe);
+		size_t in = 0;
+		auto count = GetVarint(delta, in);
+		std::string snapshot;
+
+		if (count > delta.size())
+		{
+			throw std::runtime_error("The rewind delta is corrupt");
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			auto size = GetVarint(delta, in);
+
+			// Every byte of a segment is either the keyframe's or a literal
+			if (size > keyframe.size() + delta.size())
+			{
+				throw std::runtime_error("The rewind delta is corrupt");
+			}
+
+			DecodeRuns(delta, in, SegmentOf(keyframe, keySegments, i), size, snapshot);
+		}
+
+		return snapshot;
+	}
+} // namespace i8080_arcade
@@ -0,0 +1,443 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "i8080_arcade/RomPack.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		constexpr std::array<char, 8> magic{ 'i', '8', '0', '8', '0', 'r', 'o', 'm' };
+		constexpr size_t headerSize = 32;
+		// Name length, offset, data offset, size, crc32 and sha1, the name follows the length
+		constexpr size_t romEntrySize = 1 + 2 + 4 + 4 + 4 + 20;
+		constexpr size_t addressSpace = 0x10000;
+
+		template<typename T>
+		void Put(uint8_t* out, T value)
+		{
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				out[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8));
+			}
+		}
+
+		template<typename T>
+		T Get(const uint8_t* in)
+		{
+			uint64_t value = 0;
+
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				value |= uint64_t{in[i]} << (i * 8);
+			}
+
+			return static_cast<T>(value);
+		}
+
+		using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+		// Table n holds the crc of a byte followed by n zero bytes, which lets the crc consume 8 bytes per step
+		constexpr CrcTables MakeCrcTables()
+		{
+			CrcTables tables{};
+
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				auto crc = i;
+
+				for (int bit = 0; bit < 8; bit++)
+				{
+					crc = (crc & 1) != 0 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+				}
+
+				tables[0][i] = crc;
+			}
+
+			for (size_t t = 1; t < tables.size(); t++)
+			{
+				for (size_t i = 0; i < 256; i++)
+				{
+					tables[t][i] = (tables[t - 1][i] >> 8) ^ tables[0][tables[t - 1][i] & 0xFF];
+				}
+			}
+
+			return tables;
+		}
+
+		constexpr CrcTables crcTables{ MakeCrcTables() };
+
+		uint32_t RotateLeft(uint32_t value, int bits)
+		{
+			return (value << bits) | (value >> (32 - bits));
+		}
+
+		void Sha1Block(std::array<uint32_t, 5>& state, const uint8_t* block)
+		{
+			std::array<uint32_t, 80> w{};
+
+			for (size_t i = 0; i < 16; i++)
+			{
+				w[i] = uint32_t{block[i * 4]} << 24 | uint32_t{block[i * 4 + 1]} << 16 | uint32_t{block[i * 4 + 2]} << 8 | uint32_t{block[i * 4 + 3]};
+			}
+
+			for (size_t i = 16; i < w.size(); i++)
+			{
+				w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+			}
+
+			auto [a, b, c, d, e] = state;
+
+			for (size_t i = 0; i < w.size(); i++)
+			{
+				uint32_t f = 0;
+				uint32_t k = 0;
+
+				if (i < 20)
+				{
+					f = (b & c) | (~b & d);
+					k = 0x5A827999;
+				}
+				else if (i < 40)
+				{
+					f = b ^ c ^ d;
+					k = 0x6ED9EBA1;
+				}
+				else if (i < 60)
+				{
+					f = (b & c) | (b & d) | (c & d);
+					k = 0x8F1BBCDC;
+				}
+				else
+				{
+					f = b ^ c ^ d;
+					k = 0xCA62C1D6;
+				}
+
+				auto temp = RotateLeft(a, 5) + f + e + k + w[i];
+				e = d;
+				d = c;
+				c = RotateLeft(b, 30);
+				b = a;
+				a = temp;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+		}
+	} // namespace
+
+	uint32_t RomPack::Crc32(std::span<const uint8_t> data)
+	{
+		uint32_t crc = 0xFFFFFFFF;
+		auto in = data.data();
+		auto size = data.size();
+
+		for (; size >= 8; in += 8, size -= 8)
+		{
+			auto lo = Get<uint32_t>(in) ^ crc;
+			auto hi = Get<uint32_t>(in + 4);
+
+			crc = crcTables[7][lo & 0xFF] ^ crcTables[6][(lo >> 8) & 0xFF] ^ crcTables[5][(lo >> 16) & 0xFF] ^ crcTables[4][lo >> 24]
+				^ crcTables[3][hi & 0xFF] ^ crcTables[2][(hi >> 8) & 0xFF] ^ crcTables[1][(hi >> 16) & 0xFF] ^ crcTables[0][hi >> 24];
+		}
+
+		for (; size > 0; in++, size--)
+		{
+			crc = crcTables[0][(crc ^ *in) & 0xFF] ^ (crc >> 8);
+		}
+
+		return ~crc;
+	}
+
+	std::array<uint8_t, 20> RomPack::Sha1(std::span<const uint8_t> data)
+	{
+		std::array<uint32_t, 5> state{ 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+		size_t i = 0;
+
+		for (; data.size() - i >= 64; i += 64)
+		{
+			Sha1Block(state, data.data() + i);
+		}
+
+		// The remaining bytes, a one bit, zero padding and the length in bits take one or two more blocks
+		std::array<uint8_t, 128> tail{};
+		auto remaining = data.size() - i;
+		std::memcpy(tail.data(), data.data() + i, remaining);
+		tail[remaining] = 0x80;
+		size_t tailSize = remaining + 9 > 64 ? 128 : 64;
+		uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+
+		for (size_t byte = 0; byte < 8; byte++)
+		{
+			tail[tailSize - 1 - byte] = static_cast<uint8_t>(bits >> (byte * 8));
+		}
+
+		for (size_t block = 0; block < tailSize; block += 64)
+		{
+			Sha1Block(state, tail.data() + block);
+		}
+
+		std::array<uint8_t, 20> digest{};
+
+		for (size_t word = 0; word < state.size(); word++)
+		{
+			for (size_t byte = 0; byte < 4; byte++)
+			{
+				digest[word * 4 + byte] = static_cast<uint8_t>(state[word] >> (24 - byte * 8));
+			}
+		}
+
+		return digest;
+	}
+
+	std::filesystem::path RomPack::Path(const std::filesystem::path& romFilePath, const std::string& game)
+	{
+		return romFilePath/(game + ".rom");
+	}
+
+	void RomPack::Pack(const std::filesystem::path& romFilePath, const std::string& game, const nlohmann::json& files, const std::filesystem::path& path)
+	{
+		if (game.size() > 0xFF)
+		{
+			throw std::invalid_argument("The game name is too long to pack");
+		}
+
+		std::vector<std::string> names;
+		std::vector<uint16_t> offsets;
+		std::vector<std::vector<uint8_t>> roms;
+
+		for (const auto& file : files)
+		{
+			auto name = file["name"].get<std::string>();
+			std::ifstream fin(romFilePath/name, std::ios::binary);
+
+			if (!fin)
+			{
+				throw std::runtime_error("The program file failed to open");
+			}
+
+			std::vector<uint8_t> rom{ std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>() };
+			auto offset = file["offset"].get<uint16_t>();
+
+			if (rom.empty() == true || name.size() > 0xFF)
+			{
+				throw std::runtime_error("The program file can't be packed");
+			}
+
+			if (rom.size() > addressSpace - offset)
+			{
+				throw std::length_error("The length of the program is too big to fit at the specified offset");
+			}
+
+			names.push_back(std::move(name));
+			offsets.push_back(offset);
+			roms.push_back(std::move(rom));
+		}
+
+		if (roms.empty() == true)
+		{
+			throw std::runtime_error("There are no program files to pack");
+		}
+
+		auto indexSize = 1 + game.size();
+
+		for (const auto& name : names)
+		{
+			indexSize += romEntrySize + name.size();
+		}
+
+		std::vector<uint8_t> index(indexSize);
+		auto out = index.data();
+		*out++ = static_cast<uint8_t>(game.size());
+		std::memcpy(out, game.data(), game.size());
+		out += game.size();
+		auto dataOffset = headerSize + indexSize;
+
+		for (size_t i = 0; i < roms.size(); i++)
+		{
+			*out++ = static_cast<uint8_t>(names[i].size());
+			std::memcpy(out, names[i].data(), names[i].size());
+			out += names[i].size();
+			Put<uint16_t>(out, offsets[i]);
+			Put<uint32_t>(out + 2, static_cast<uint32_t>(dataOffset));
+			Put<uint32_t>(out + 6, static_cast<uint32_t>(roms[i].size()));
+			Put<uint32_t>(out + 10, Crc32(roms[i]));
+			auto sha1 = Sha1(roms[i]);
+			std::memcpy(out + 14, sha1.data(), sha1.size());
+			out += romEntrySize - 1;
+			dataOffset += roms[i].size();
+		}
+
+		std::array<uint8_t, headerSize> header{};
+		std::memcpy(header.data(), magic.data(), magic.size());
+		Put<uint16_t>(header.data() + 8, version_);
+		Put<uint16_t>(header.data() + 10, static_cast<uint16_t>(roms.size()));
+		Put<uint32_t>(header.data() + 12, static_cast<uint32_t>(indexSize));
+		Put<uint32_t>(header.data() + 16, Crc32(index));
+		Put<uint64_t>(header.data() + 24, dataOffset);
+
+		// Replaced in full so that a failed pack never leaves a truncated pack behind
+		auto tmpPath = path;
+		tmpPath += ".tmp";
+
+		{
+			std::ofstream fout(tmpPath, std::ios::binary | std::ios::trunc);
+
+			if (!fout)
+			{
+				throw std::runtime_error("The rom pack file failed to open");
+			}
+
+			fout.write(reinterpret_cast<const char*>(header.data()), header.size());
+			fout.write(reinterpret_cast<const char*>(index.data()), index.size());
+
+			for (const auto& rom : roms)
+			{
+				fout.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+			}
+
+			if (!fout)
+			{
+				throw std::runtime_error("Failed to write the rom pack file");
+			}
+		}
+
+		std::filesystem::rename(tmpPath, path);
+	}
+
+	RomPack::RomPack(const std::filesystem::path& path)
+		: mappedFile_{ path }
+	{
+		auto data = mappedFile_.Data();
+		auto size = mappedFile_.Size();
+
+		if (size < headerSize || std::memcmp(data, magic.data(), magic.size()) != 0)
+		{
+			throw std::runtime_error("The file is not a rom pack");
+		}
+
+		if (Get<uint16_t>(data + 8) > version_)
+		{
+			throw std::runtime_error("The rom pack version is not supported");
+		}
+
+		auto romCount = Get<uint16_t>(data + 10);
+		auto indexSize = Get<uint32_t>(data + 12);
+
+		if (Get<uint64_t>(data + 24) != size || indexSize > size - headerSize
+			|| Crc32({ data + headerSize, indexSize }) != Get<uint32_t>(data + 16))
+		{
+			throw std::runtime_error("The rom pack is corrupt");
+		}
+
+		// The index crc has passed, the bounds checks below guard against a pack that was written incorrectly
+		auto in = data + headerSize;
+		auto end = in + indexSize;
+
+		auto readName = [&in, end]()
+		{
+			if (in == end || *in > end - in - 1)
+			{
+				throw std::runtime_error("The rom pack index is invalid");
+			}
+
+			std::string name(reinterpret_cast<const char*>(in + 1), *in);
+			in += 1 + name.size();
+			return name;
+		};
+
+		game_ = readName();
+		roms_.reserve(romCount);
+
+		for (size_t i = 0; i < romCount; i++)
+		{
+			Rom rom{};
+			rom.name = readName();
+
+			if (static_cast<size_t>(end - in) < romEntrySize - 1)
+			{
+				throw std::runtime_error("The rom pack index is invalid");
+			}
+
+			rom.offset = Get<uint16_t>(in);
+			auto dataOffset = Get<uint32_t>(in + 2);
+			auto romSize = Get<uint32_t>(in + 6);
+			rom.crc32 = Get<uint32_t>(in + 10);
+			std::memcpy(rom.sha1.data(), in + 14, rom.sha1.size());
+			in += romEntrySize - 1;
+
+			if (dataOffset < headerSize + indexSize || dataOffset > size || romSize > size - dataOffset || romSize > addressSpace - rom.offset)
+			{
+				throw std::runtime_error("The rom pack index is invalid");
+			}
+
+			rom.data = { data + dataOffset, romSize };
+
+			if (Crc32(rom.data) != rom.crc32 || Sha1(rom.data) != rom.sha1)
+			{
+				throw std::runtime_error("The rom " + rom.name + " in the rom pack failed its integrity check");
+			}
+
+			roms_.push_back(std::move(rom));
+		}
+	}
+
+	const std::string& RomPack::Game() const
+	{
+		return game_;
+	}
+
+	const std::vector<RomPack::Rom>& RomPack::Roms() const
+	{
+		return roms_;
+	}
+
+	void RomPack::CheckConfig(const std::string& game, const nlohmann::json& files) const
+	{
+		if (game_ != game)
+		{
+			throw std::runtime_error("The rom pack was packed for a different game");
+		}
+
+		auto matches = files.size() == roms_.size();
+
+		for (size_t i = 0; matches == true && i < roms_.size(); i++)
+		{
+			const auto& file = files[i];
+			matches = roms_[i].name == file["name"].get<std::string>() && roms_[i].offset == file["offset"].get<uint32_t>() && roms_[i].data.size() == file["size"].get<size_t>();
+		}
+
+		if (matches == false)
+		{
+			throw std::runtime_error("The rom pack does not match the rom files in the config, pack the roms again with --pack-roms");
+		}
+	}
+} // namespace i8080_arcade
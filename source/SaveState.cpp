@@ -0,0 +1,385 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "i8080_arcade/SaveState.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		constexpr std::array<char, 8> magic{ 'i', '8', '0', '8', '0', 's', 'a', 'v' };
+		constexpr size_t headerSize = 16;
+		constexpr size_t entrySize = 40;
+		constexpr size_t minMatch = 4;
+		constexpr size_t maxOffset = 0xFFFF;
+		// A machine save is the 64KiB address space and the cpu state as json, far smaller than this
+		constexpr uint64_t maxRawSize = 16 * 1024 * 1024;
+		// Each compressed byte expands to at most this many, a 255 length byte extends a match by 255
+		constexpr uint64_t maxExpansion = 255;
+
+		uint64_t Fnv1a(const uint8_t* data, size_t size)
+		{
+			uint64_t hash = 0xCBF29CE484222325;
+
+			for (size_t i = 0; i < size; i++)
+			{
+				hash = (hash ^ data[i]) * 0x00000100000001B3;
+			}
+
+			return hash;
+		}
+
+		template<typename T>
+		void Put(std::vector<uint8_t>& out, T value)
+		{
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+			}
+		}
+
+		template<typename T>
+		T Get(const uint8_t* in)
+		{
+			uint64_t value = 0;
+
+			for (size_t i = 0; i < sizeof(T); i++)
+			{
+				value |= uint64_t{in[i]} << (i * 8);
+			}
+
+			return static_cast<T>(value);
+		}
+
+		void PutLength(std::vector<uint8_t>& out, size_t length)
+		{
+			while (length >= 255)
+			{
+				out.push_back(255);
+				length -= 255;
+			}
+
+			out.push_back(static_cast<uint8_t>(length));
+		}
+
+		size_t GetLength(const uint8_t*& in, const uint8_t* end, size_t length)
+		{
+			if (length == 15)
+			{
+				uint8_t byte = 0;
+
+				do
+				{
+					if (in == end)
+					{
+						throw std::runtime_error("The compressed save state is truncated");
+					}
+
+					byte = *in++;
+					length += byte;
+				}
+				while (byte == 255);
+			}
+
+			return length;
+		}
+	} // namespace
+
+	SaveState::SaveState(const std::filesystem::path& path)
+		: mappedFile_{ path }
+	{
+		auto data = mappedFile_.Data();
+		auto size = mappedFile_.Size();
+
+		if (size < headerSize || std::memcmp(data, magic.data(), magic.size()) != 0)
+		{
+			throw std::runtime_error("The file is not an i8080 arcade save state");
+		}
+
+		if (Get<uint16_t>(data + 8) > version_)
+		{
+			throw std::runtime_error("The save state was written by a newer version of i8080 arcade");
+		}
+
+		auto sections = Get<uint16_t>(data + 10);
+
+		if (size < headerSize + sections * entrySize)
+		{
+			throw std::runtime_error("The save state is truncated");
+		}
+
+		auto found = false;
+
+		for (size_t i = 0; i < sections; i++)
+		{
+			auto entry = data + headerSize + i * entrySize;
+
+			if (Get<SectionType>(entry) != SectionType::Machine)
+			{
+				continue;
+			}
+
+			auto compression = Get<Compression>(entry + 4);
+			auto offset = Get<uint64_t>(entry + 8);
+			auto storedSize = Get<uint64_t>(entry + 16);
+			auto rawSize = Get<uint64_t>(entry + 24);
+			auto hash = Get<uint64_t>(entry + 32);
+
+			if (offset > size || storedSize > size - offset || rawSize == 0)
+			{
+				throw std::runtime_error("The save state is truncated");
+			}
+
+			const uint8_t* raw = data + offset;
+
+			if (compression == Compression::Lz)
+			{
+				// Don't trust the header with the allocation size
+				if (rawSize > maxRawSize || rawSize > storedSize * maxExpansion)
+				{
+					throw std::runtime_error("The save state is corrupt");
+				}
+
+				machineJson_.resize(rawSize);
+				Decompress(data + offset, storedSize, reinterpret_cast<uint8_t*>(machineJson_.data()), rawSize);
+				raw = reinterpret_cast<const uint8_t*>(machineJson_.data());
+			}
+			else if (compression != Compression::None || storedSize != rawSize)
+			{
+				throw std::runtime_error("The save state compression method is unknown");
+			}
+
+			if (Fnv1a(raw, rawSize) != hash || raw[rawSize - 1] != '\0')
+			{
+				throw std::runtime_error("The save state is corrupt");
+			}
+
+			// A decompressed section keeps its nul so that an empty machine JSON still leaves machineJson_ non empty
+			if (compression == Compression::None)
+			{
+				machineOffset_ = offset;
+			}
+
+			found = true;
+		}
+
+		if (found == false)
+		{
+			throw std::runtime_error("The save state has no machine section");
+		}
+	}
+
+	const char* SaveState::MachineJson() const
+	{
+		if (machineJson_.empty() == false)
+		{
+			return machineJson_.data();
+		}
+
+		return reinterpret_cast<const char*>(mappedFile_.Data() + machineOffset_);
+	}
+
+	void SaveState::Save(const std::filesystem::path& path, std::string_view machineJson, Compression compression)
+	{
+		// Include the nul so the section can be handed to the machine as is when loaded
+		std::vector<uint8_t> raw(machineJson.begin(), machineJson.end());
+		raw.push_back('\0');
+
+		std::vector<uint8_t> stored;
+
+		if (compression == Compression::Lz)
+		{
+			stored = Compress(raw.data(), raw.size());
+		}
+
+		const auto& section = compression == Compression::Lz ? stored : raw;
+		std::vector<uint8_t> header;
+
+		header.insert(header.end(), magic.begin(), magic.end());
+		Put<uint16_t>(header, version_);
+		Put<uint16_t>(header, 1);
+		Put<uint32_t>(header, 0);
+		Put<uint32_t>(header, static_cast<uint32_t>(SectionType::Machine));
+		Put<uint32_t>(header, static_cast<uint32_t>(compression));
+		Put<uint64_t>(header, headerSize + entrySize);
+		Put<uint64_t>(header, section.size());
+		Put<uint64_t>(header, raw.size());
+		Put<uint64_t>(header, Fnv1a(raw.data(), raw.size()));
+
+		auto tmpPath = path;
+		tmpPath += ".tmp";
+
+		{
+			std::ofstream fout(tmpPath, std::ios::binary | std::ios::trunc);
+
+			if (!fout)
+			{
+				throw std::runtime_error("The save state file failed to open");
+			}
+
+			fout.write(reinterpret_cast<const char*>(header.data()), header.size());
+			fout.write(reinterpret_cast<const char*>(section.data()), section.size());
+
+			if (!fout)
+			{
+				throw std::runtime_error("Failed to write the save state");
+			}
+		}
+
+		std::filesystem::rename(tmpPath, path);
+	}
+
+	SaveState::Compression SaveState::ParseCompression(const std::string& compression)
+	{
+		if (compression == "none")
+		{
+			return Compression::None;
+		}
+		else if (compression == "lz")
+		{
+			return Compression::Lz;
+		}
+
+		throw std::invalid_argument("The save compression must be none or lz");
+	}
+
+	std::vector<uint8_t> SaveState::Compress(const uint8_t* src, size_t size)
+	{
+		std::vector<uint8_t> out;
+		// The position + 1 of the last occurrence of each hashed 4 byte sequence, 0 if none
+		std::vector<uint32_t> table(4096);
+		size_t anchor = 0;
+		size_t pos = 0;
+
+		out.reserve(size / 2 + 16);
+
+		auto putSequence = [&](size_t literals, size_t matchLength)
+		{
+			auto literalNibble = std::min<size_t>(literals, 15);
+			auto matchNibble = matchLength == 0 ? 0 : std::min<size_t>(matchLength - minMatch, 15);
+			out.push_back(static_cast<uint8_t>(literalNibble << 4 | matchNibble));
+
+			if (literalNibble == 15)
+			{
+				PutLength(out, literals - 15);
+			}
+
+			out.insert(out.end(), src + anchor, src + anchor + literals);
+		};
+
+		while (pos + minMatch <= size)
+		{
+			uint32_t sequence = 0;
+			std::memcpy(&sequence, src + pos, sizeof(sequence));
+			auto& slot = table[(sequence * 2654435761u) >> 20];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(pos + 1);
+
+			if (candidate == 0 || pos + 1 - candidate > maxOffset || std::memcmp(src + candidate - 1, src + pos, minMatch) != 0)
+			{
+				pos++;
+				continue;
+			}
+
+			candidate--;
+			auto matchLength = minMatch;
+
+			while (pos + matchLength < size && src[candidate + matchLength] == src[pos + matchLength])
+			{
+				matchLength++;
+			}
+
+			putSequence(pos - anchor, matchLength);
+			Put<uint16_t>(out, static_cast<uint16_t>(pos - candidate));
+
+			if (matchLength - minMatch >= 15)
+			{
+				PutLength(out, matchLength - minMatch - 15);
+			}
+
+			pos += matchLength;
+			anchor = pos;
+		}
+
+		putSequence(size - anchor, 0);
+		return out;
+	}
+
+	void SaveState::Decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dstSize)
+	{
+		auto in = src;
+		auto end = src + size;
+		size_t out = 0;
+
+		while (in < end)
+		{
+			auto token = *in++;
+			auto literals = GetLength(in, end, token >> 4);
+
+			if (literals > static_cast<size_t>(end - in) || literals > dstSize - out)
+			{
+				throw std::runtime_error("The compressed save state is corrupt");
+			}
+
+			std::copy_n(in, literals, dst + out);
+			in += literals;
+			out += literals;
+
+			if (in == end)
+			{
+				// The final sequence holds literals only
+				break;
+			}
+
+			if (end - in < 2)
+			{
+				throw std::runtime_error("The compressed save state is truncated");
+			}
+
+			size_t offset = Get<uint16_t>(in);
+			in += 2;
+			auto matchLength = GetLength(in, end, token & 0x0F) + minMatch;
+
+			if (offset == 0 || offset > out || matchLength > dstSize - out)
+			{
+				throw std::runtime_error("The compressed save state is corrupt");
+			}
+
+			// The match may overlap the bytes it produces, copy one at a time
+			for (size_t i = 0; i < matchLength; i++, out++)
+			{
+				dst[out] = dst[out - offset];
+			}
+		}
+
+		if (out != dstSize)
+		{
+			throw std::runtime_error("The compressed save state is truncated");
+		}
+	}
+} // namespace i8080_arcade
@@ -20,241 +20,1237 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <assert.h>
 #include <bitset>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <future>
+#include <random>
+#include <thread>
 
+#include "i8080_arcade/MappedFile.h"
+#include "i8080_arcade/PcmCache.h"
 #include "i8080_arcade/SdlIoController.h"
 
 namespace i8080_arcade
 {
-    SdlIoController::SdlIoController(const std::shared_ptr<MemoryController>& memoryController, const nlohmann::json& audioHardware, const nlohmann::json& videoHardware)
-		: memoryController_{ memoryController }
+	namespace
 	{
+		/** Decode a wav file
+
+			@param	path		The wav file.
+			@param	spec		The device format to convert to, the freq, format and channels are used.
+			@param	cache		When not nullptr the converted PCM is looked up in and stored to it.
+
+			@return				The PCM converted to the device format.
+		*/
+		std::vector<uint8_t> DecodeWav(const std::filesystem::path& path, const SDL_AudioSpec& spec, const PcmCache* cache)
+		{
+			MappedFile file(path);
+			auto key = PcmCache::Key({ file.Data(), file.Size() }, spec.format, spec.channels, spec.freq);
+			std::vector<uint8_t> pcm;
+
+			if (cache != nullptr && cache->Load(key, pcm) == true)
+			{
+				return pcm;
+			}
+
+			SDL_AudioSpec wavSpec{};
+			Uint8* buffer = nullptr;
+			Uint32 length = 0;
+
+			if (SDL_LoadWAV_RW(SDL_RWFromConstMem(file.Data(), static_cast<int>(file.Size())), 1, &wavSpec, &buffer, &length) == nullptr)
+			{
+				throw std::runtime_error("Failed to load audio sample");
+			}
+
+			SDL_AudioCVT cvt{};
+
+			if (SDL_BuildAudioCVT(&cvt, wavSpec.format, wavSpec.channels, wavSpec.freq, spec.format, spec.channels, spec.freq) < 0)
+			{
+				SDL_FreeWAV(buffer);
+				throw std::runtime_error("Unsupported audio sample format");
+			}
+
+			// The conversion is done in place and may need more room than the source
+			pcm.resize(static_cast<size_t>(length) * std::max(cvt.len_mult, 1));
+			std::memcpy(pcm.data(), buffer, length);
+			SDL_FreeWAV(buffer);
+
+			cvt.buf = pcm.data();
+			cvt.len = static_cast<int>(length);
+
+			if (SDL_ConvertAudio(&cvt) < 0)
+			{
+				throw std::runtime_error("Failed to convert audio sample");
+			}
+
+			pcm.resize(static_cast<size_t>(cvt.len_cvt));
+
+			if (cache != nullptr)
+			{
+				try
+				{
+					cache->Store(key, pcm);
+				}
+				catch (const std::exception& e)
+				{
+					// The sample is still usable, it is converted again next time
+					printf("Failed to cache audio sample %s: %s\n", path.filename().string().c_str(), e.what());
+				}
+			}
+
+			return pcm;
+		}
+
+		PostProcessor::Options ParsePostProcessOptions(const nlohmann::json& postProcess)
+		{
+			PostProcessor::Options options;
+			options.scale = postProcess["scale"].get<int>();
+			options.scanlines = postProcess["scanlines"].get<double>();
+			options.phosphor = postProcess["phosphor"].get<double>();
+			options.threads = postProcess["threads"].get<size_t>();
+			return options;
+		}
+	} // namespace
+
+    SdlIoController::SdlIoController(const std::shared_ptr<MemoryController>& memoryController, const nlohmann::json& audioHardware, const nlohmann::json& videoHardware, const nlohmann::json& inputHardware, const nlohmann::json& rewindHardware)
+		: memoryController_{ memoryController },
+		videoFrameRing_{ videoHardware["frame-queue-depth"].get<size_t>() },
+		tripleBuffering_{ videoHardware["frame-buffering"].get<std::string>() == "triple" },
+		blitKernel_{ videoHardware["blitter"].get<std::string>() },
+		pixelFormat_{ videoHardware["pixel-format"].get<std::string>() == "argb8888" ? VramBlitter::PixelFormat::ARGB8888 : VramBlitter::PixelFormat::RGB332 },
+		displayPacer_{ DisplayPacer::ParseMode(videoHardware["vsync"].get<std::string>()), frameInterval_.count() },
+		postProcessOptions_{ ParsePostProcessOptions(videoHardware["post-process"]) },
+		sampleInputPerFrame_{ inputHardware["sample-per-frame"].get<bool>() },
+		// The render interrupt is at 60Hz, one snapshot is taken per frame
+		rewindBuffer_{ rewindHardware["seconds"].get<size_t>() * 60, rewindHardware["budget"].get<size_t>(), rewindHardware["keyframe-interval"].get<size_t>() }
+	{
+		if (displayPacer_.GetMode() == DisplayPacer::Mode::Smooth && (tripleBuffering_ == true || videoFrameRing_.Capacity() < 2))
+		{
+			throw std::invalid_argument("The smooth vsync mode queues a frame, it needs pool frame buffering with a frame queue depth of at least 2");
+		}
+
+		if (postProcessOptions_.Enabled() == true)
+		{
+			// The post processor works on whole 8 bit channels
+			pixelFormat_ = VramBlitter::PixelFormat::ARGB8888;
+		}
+
 		SDL_SetMainReady();
 
-		if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO) < 0)
-		{
-			throw std::runtime_error("Failed to initialise SDL");
-		}
+		if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO) < 0)
+		{
+			throw std::runtime_error("Failed to initialise SDL");
+		}
+
+		window_ = SDL_CreateWindow("i8080 arcade",
+								SDL_WINDOWPOS_UNDEFINED,
+								SDL_WINDOWPOS_UNDEFINED,
+								videoHardware["width"].get<int>(),
+								videoHardware["height"].get<int>(),
+								videoHardware["full-screen"].get<bool>() ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+
+		if (window_ == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		// Presents block until the vblank when paced to the display
+		auto vsync = displayPacer_.GetMode() != DisplayPacer::Mode::Off ? SDL_RENDERER_PRESENTVSYNC : 0;
+		renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED | vsync);
+
+		if (renderer_ == nullptr)
+		{
+			printf("Failed to allocate an accelerated renderer, falling back to software\n");
+			renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_SOFTWARE | vsync);
+
+			if (renderer_ == nullptr)
+			{
+				throw std::runtime_error("Failed to allocate an SDL renderer");
+			}
+		}
+
+		SDL_DisplayMode displayMode{};
+
+		// The nominal refresh rate is a whole number of Hz, it is refined by measuring the vsynced presents
+		if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window_), &displayMode) == 0 && displayMode.refresh_rate > 0)
+		{
+			displayPacer_.SetRefreshInterval(1000000000 / displayMode.refresh_rate);
+		}
+
+		i8080ArcadeIO_ = meen_hw::MakeI8080ArcadeIO();
+
+		if(i8080ArcadeIO_ == nullptr)
+		{
+			throw std::runtime_error("Failed to create i8080 arcade hardware");
+		}
+
+		ports_.Attach(i8080ArcadeIO_.get());
+
+		auto mixer = audioHardware["mixer"].get<std::string>();
+
+		if (mixer == "native")
+		{
+			audioMixer_ = std::make_unique<AudioMixer>(audioHardware["sample-rate"].get<int>(), audioHardware["channels"].get<int>(), audioHardware["sample-size"].get<size_t>());
+			audioMixer_->SetFrameTiming(&frameTiming_);
+
+			SDL_AudioSpec spec{};
+			spec.freq = audioHardware["sample-rate"].get<int>();
+			spec.format = AUDIO_S16SYS;
+			spec.channels = audioHardware["channels"].get<Uint8>();
+			spec.samples = audioHardware["sample-size"].get<Uint16>();
+			spec.userdata = this;
+			spec.callback = [](void* userdata, Uint8* stream, int len)
+			{
+				auto controller = static_cast<SdlIoController*>(userdata);
+				Tracer::Scope scope(controller->tracer_.get(), Tracer::Event::AudioMix);
+				controller->audioMixer_->Mix({ reinterpret_cast<int16_t*>(stream), static_cast<size_t>(len) / sizeof(int16_t) });
+			};
+
+			// Don't allow any changes, SDL converts to the device format if it has to. The device starts paused.
+			audioDevice_ = SDL_OpenAudioDevice(nullptr, 0, &spec, nullptr, 0);
+
+			if (audioDevice_ == 0)
+			{
+				throw std::runtime_error("Failed to open the audio device");
+			}
+		}
+		else if (mixer == "sdl-mixer")
+		{
+			if (Mix_OpenAudio(audioHardware["sample-rate"].get<int>(), 8 /* format (mono) */, audioHardware["channels"].get<int>(), audioHardware["sample-size"].get<int>()) < 0)
+			{
+				throw std::runtime_error("Failed to open SDL Mixer");
+			}
+
+			// Measure the audio latency to the buffer the samples are first mixed into, the same point as the native mixer
+			Mix_SetPostMix([](void* udata, [[maybe_unused]] Uint8* stream, [[maybe_unused]] int len)
+			{
+				auto controller = static_cast<SdlIoController*>(udata);
+				auto triggerTime = controller->mixTriggerTime_.exchange(0, std::memory_order_relaxed);
+
+				if (controller->tracer_ != nullptr)
+				{
+					// The buffer has already been mixed, only the time it finished is known
+					controller->tracer_->Instant(Tracer::Event::AudioMix, FrameTiming::Now());
+				}
+
+				if (triggerTime != 0)
+				{
+					controller->frameTiming_.Record(FrameTiming::Stage::Audio, FrameTiming::Now() - triggerTime);
+				}
+			}, this);
+		}
+		else
+		{
+			throw std::invalid_argument("Invalid audio mixer, must be native or sdl-mixer");
+		}
+
+		siEvent_ = SDL_RegisterEvents(1);
+
+		if (siEvent_ == 0xFFFFFFFF)
+		{
+			throw std::runtime_error("Exhausted all user level events");
+		}
+
+		SDL_SetEventFilter([](void* eventType, SDL_Event* e)
+		{
+			// Ignore all events other than ours and keyboard changes.
+			if (reinterpret_cast<uint64_t>(eventType) == e->type || e->type == SDL_QUIT || e->type == SDL_KEYDOWN || e->type == SDL_KEYUP)
+			{
+				return 1;
+			}
+			else
+			{
+				return 0;
+			}
+		},
+		reinterpret_cast<void*>(siEvent_));
+	}
+
+	SdlIoController::~SdlIoController()
+	{
+		if (renderer_ != nullptr)
+		{
+			SDL_DestroyRenderer(renderer_);
+		}
+
+		if (window_ != nullptr)
+		{
+			SDL_DestroyWindow(window_);
+		}
+
+		if (audioDevice_ != 0)
+		{
+			// Stops the callback before the mixer is released
+			SDL_CloseAudioDevice(audioDevice_);
+		}
+		else if (audioMixer_ == nullptr)
+		{
+			Mix_SetPostMix(nullptr, nullptr);
+
+			for (auto& chunk : mixChunk_)
+			{
+				Mix_FreeChunk(chunk);
+			}
+
+			Mix_CloseAudio();
+		}
+
+		SDL_Quit();
+	}
+
+	void SdlIoController::LoadAudioSamples(const std::filesystem::path& audioFilePath, const nlohmann::json& audio, const std::filesystem::path& audioCachePath)
+	{
+		loopingSamples_ = 0;
+
+		for (const auto& sample : audio["loop"])
+		{
+			auto index = sample.get<size_t>();
+
+			if (index >= sampleTriggered_.size())
+			{
+				throw std::invalid_argument("Invalid looping audio sample index");
+			}
+
+			loopingSamples_ |= 1 << index;
+		}
+
+		SDL_AudioSpec spec{};
+
+		if (audioMixer_ != nullptr)
+		{
+			spec.freq = audioMixer_->SampleRate();
+			spec.format = AUDIO_S16SYS;
+			// The native mixer mixes in mono
+			spec.channels = 1;
+		}
+		else
+		{
+			int channels = 0;
+
+			if (Mix_QuerySpec(&spec.freq, &spec.format, &channels) == 0)
+			{
+				throw std::runtime_error("Failed to query the SDL Mixer audio format");
+			}
+
+			spec.channels = static_cast<Uint8>(channels);
+		}
+
+		std::vector<std::string> names;
+
+		for (const auto& file : audio["file"])
+		{
+			names.push_back(file.get<std::string>());
+		}
+
+		std::unique_ptr<PcmCache> cache;
+
+		if (audioCachePath.empty() == false)
+		{
+			cache = std::make_unique<PcmCache>(audioCachePath);
+		}
+
+		// Decode the samples in parallel, each worker takes the next sample until there are none left
+		std::vector<std::vector<uint8_t>> decoded(names.size());
+		std::atomic<size_t> next{};
+		std::vector<std::future<void>> workers;
+		auto workerCount = std::min<size_t>(names.size(), std::max(1u, std::thread::hardware_concurrency()));
+
+		for (size_t i = 0; i < workerCount; i++)
+		{
+			workers.push_back(std::async(std::launch::async, [&]()
+			{
+				for (auto index = next++; index < names.size(); index = next++)
+				{
+					if (names[index].empty() == false)
+					{
+						decoded[index] = DecodeWav(audioFilePath/names[index], spec, cache.get());
+					}
+				}
+			}));
+		}
+
+		// Wait for every worker before rethrowing the first failure, they reference this frame
+		for (auto& worker : workers)
+		{
+			worker.wait();
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.get();
+		}
+
+		pcmArena_ = PcmArena(decoded);
+
+		if (audioMixer_ != nullptr)
+		{
+			for (size_t i = 0; i < pcmArena_.Count(); i++)
+			{
+				audioMixer_->SetSample(i, pcmArena_.Pcm16(i));
+				sampleDuration_.emplace_back(audioMixer_->SampleDuration(i));
+			}
+
+			SDL_PauseAudioDevice(audioDevice_, 0);
+			return;
+		}
+
+		auto bytesPerSecond = static_cast<uint64_t>(spec.freq) * spec.channels * (SDL_AUDIO_BITSIZE(spec.format) / 8);
+
+		for (size_t i = 0; i < pcmArena_.Count(); i++)
+		{
+			auto pcm = pcmArena_.Bytes(i);
+			// The chunk refers to the arena rather than owning a copy, the mixer never writes to it
+			auto mixChunk = pcm.empty() == true ? nullptr : Mix_QuickLoad_RAW(const_cast<Uint8*>(pcm.data()), static_cast<Uint32>(pcm.size()));
+
+			if (pcm.empty() == false && mixChunk == nullptr)
+			{
+				throw std::runtime_error("Failed to load audio sample");
+			}
+
+			mixChunk_.emplace_back(mixChunk);
+			sampleDuration_.emplace_back(bytesPerSecond == 0 ? 0 : pcm.size() * uint64_t{1000000000} / bytesPerSecond);
+		}
+	}
+
+	void SdlIoController::LoadVideoTextures(const nlohmann::json& videoTextures)
+	{
+		i8080ArcadeIO_->SetOptions(videoTextures.dump().c_str());
+		CreateBlitter(videoTextures);
+		postProcessor_.reset();
+
+		if (postProcessOptions_.Enabled() == true)
+		{
+			if (blitter_ != nullptr)
+			{
+				// The post process kernels have no avx2 variant, only an explicit scalar blit kernel carries over
+				postProcessor_ = std::make_unique<PostProcessor>(blitter_->Width(), blitter_->Height(), postProcessOptions_, blitKernel_ == "scalar" ? "scalar" : "auto");
+				sourceFrame_.resize(static_cast<size_t>(blitter_->Width()) * blitter_->Height());
+				printf("Post processing at x%d with the %s kernel in %zu bands\n", postProcessor_->Width() / blitter_->Width(), postProcessor_->KernelName(), postProcessor_->Bands());
+			}
+			else
+			{
+				printf("Post processing needs the native blitter, it is disabled\n");
+			}
+		}
+
+		// The post processed frame is already scaled, filtering it again would blur the scanlines
+		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, postProcessor_ != nullptr ? "nearest" : "linear");
+
+		auto pixelFormat = blitter_ != nullptr && blitter_->BytesPerPixel() == 4 ? SDL_PIXELFORMAT_ARGB8888 : SDL_PIXELFORMAT_RGB332;
+		auto width = postProcessor_ != nullptr ? postProcessor_->Width() : i8080ArcadeIO_->GetVRAMWidth();
+		auto height = postProcessor_ != nullptr ? postProcessor_->Height() : i8080ArcadeIO_->GetVRAMHeight();
+		texture_ = SDL_CreateTexture(renderer_, pixelFormat, SDL_TEXTUREACCESS_STREAMING, width, height);
+
+		if (texture_ == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		lastRenderedSequence_ = 0;
+
+		if (blitter_ == nullptr)
+		{
+			stagingFrame_.resize(i8080ArcadeIO_->GetVRAMWidth() * i8080ArcadeIO_->GetVRAMHeight());
+			DeriveRowMapping();
+		}
+	}
+
+	void SdlIoController::CreateBlitter(const nlohmann::json& videoTextures)
+	{
+		blitter_.reset();
+
+		if (blitKernel_ == "meen-hw")
+		{
+			return;
+		}
+
+		const auto& colourOption = videoTextures["colour"];
+		auto colour = colourOption.is_number() == true ? std::optional<uint8_t>(colourOption.get<uint8_t>()) : VramBlitter::ParseColour(colourOption.get<std::string>());
+		auto upright = videoTextures["orientation"].get<std::string>() == "upright";
+
+		if (colour.has_value() == false || videoTextures["bpp"].get<int>() != 8)
+		{
+			printf("The video options are not supported by the native blitter, falling back to the meen-hw blitter\n");
+			return;
+		}
+
+		// The native blitter must be bit exact with the meen-hw blitter, check it against a few random frames
+		VramBlitter rgb332(upright, *colour, VramBlitter::PixelFormat::RGB332, blitKernel_);
+		auto width = i8080ArcadeIO_->GetVRAMWidth();
+		auto height = i8080ArcadeIO_->GetVRAMHeight();
+
+		if (rgb332.Width() != width || rgb332.Height() != height)
+		{
+			printf("The native blitter dimensions do not match the meen-hw blitter, falling back to the meen-hw blitter\n");
+			return;
+		}
+
+		std::mt19937 random(0x8080);
+		std::array<uint8_t, VideoFrame::rows * VideoFrame::rowBytes> probe{};
+		std::vector<uint8_t> expected(width * height);
+		std::vector<uint8_t> actual(width * height);
+		auto region = rgb332.GetRegion(0, VideoFrame::rows - 1);
+
+		for (int i = 0; i < 3; i++)
+		{
+			std::generate(probe.begin(), probe.end(), [&random] { return static_cast<uint8_t>(random()); });
+			i8080ArcadeIO_->BlitVRAM(std::span(expected), width, std::span(probe));
+			rgb332.Blit(probe.data(), region, actual.data(), width);
+
+			if (expected != actual)
+			{
+				printf("The native blitter does not match the meen-hw blitter, falling back to the meen-hw blitter\n");
+				return;
+			}
+		}
+
+		if (pixelFormat_ == VramBlitter::PixelFormat::ARGB8888)
+		{
+			// There is no meen-hw reference for ARGB8888, check the kernel against the scalar kernel instead
+			VramBlitter argb8888(upright, *colour, VramBlitter::PixelFormat::ARGB8888, blitKernel_);
+			VramBlitter scalar(upright, *colour, VramBlitter::PixelFormat::ARGB8888, "scalar");
+			expected.resize(width * height * 4);
+			actual.resize(width * height * 4);
+			scalar.Blit(probe.data(), region, expected.data(), width * 4);
+			argb8888.Blit(probe.data(), region, actual.data(), width * 4);
+
+			if (expected != actual)
+			{
+				printf("The %s blit kernel does not match the scalar kernel, falling back to the meen-hw blitter\n", argb8888.KernelName());
+				return;
+			}
+		}
+
+		blitter_ = std::make_unique<VramBlitter>(upright, *colour, pixelFormat_, blitKernel_);
+	}
+
+	void SdlIoController::DeriveRowMapping()
+	{
+		auto width = i8080ArcadeIO_->GetVRAMWidth();
+		auto height = i8080ArcadeIO_->GetVRAMHeight();
+		std::array<uint8_t, VideoFrame::rows * VideoFrame::rowBytes> probe{};
+
+		// Light a single row of video ram and find the bounds of what was drawn
+		auto locate = [&](size_t row)
+		{
+			SDL_Rect bounds{ width, height, 0, 0 };
+			probe.fill(0);
+			std::fill_n(probe.begin() + row * VideoFrame::rowBytes, VideoFrame::rowBytes, 0xFF);
+			i8080ArcadeIO_->BlitVRAM(std::span(stagingFrame_), width, std::span(probe));
+
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					if (stagingFrame_[y * width + x] != 0)
+					{
+						bounds.x = std::min(bounds.x, x);
+						bounds.y = std::min(bounds.y, y);
+						bounds.w = std::max(bounds.w, x + 1);
+						bounds.h = std::max(bounds.h, y + 1);
+					}
+				}
+			}
+
+			bounds.w -= bounds.x;
+			bounds.h -= bounds.y;
+			return bounds;
+		};
+
+		auto first = locate(0);
+		auto last = locate(VideoFrame::rows - 1);
+		constexpr int span = VideoFrame::rows - 1;
+		rowMapping_ = RowMapping{};
+
+		if (first.w == 1 && last.w == 1 && std::abs(last.x - first.x) == span)
+		{
+			rowMapping_ = { true, true, first.x, (last.x - first.x) / span };
+		}
+		else if (first.h == 1 && last.h == 1 && std::abs(last.y - first.y) == span)
+		{
+			rowMapping_ = { true, false, first.y, (last.y - first.y) / span };
+		}
+		else
+		{
+			printf("Unable to map video ram rows to the texture, every frame will be uploaded in full\n");
+		}
+	}
+
+	bool SdlIoController::UploadVideoFrame(VideoFrame& videoFrame)
+	{
+		size_t firstRow = 0;
+		size_t lastRow = VideoFrame::rows - 1;
+
+		// Only the rows that changed since the previous frame need to be uploaded if the previous frame is the one in the texture,
+		// unless the phosphor persistence decays every row every frame
+		auto persistent = postProcessor_ != nullptr && postProcessor_->Persistent() == true;
+
+		if (lastRenderedSequence_ != 0 && videoFrame.sequence == lastRenderedSequence_ + 1 && persistent == false)
+		{
+			int dirtyFirstRow = -1;
+			int dirtyLastRow = -1;
+
+			for (int row = 0; row < static_cast<int>(VideoFrame::rows); row++)
+			{
+				if (videoFrame.dirtyRows[row >> 6] & (uint64_t{1} << (row & 63)))
+				{
+					dirtyFirstRow = dirtyFirstRow < 0 ? row : dirtyFirstRow;
+					dirtyLastRow = row;
+				}
+			}
+
+			if (dirtyFirstRow < 0)
+			{
+				lastRenderedSequence_ = videoFrame.sequence;
+				return false;
+			}
+
+			firstRow = dirtyFirstRow;
+			lastRow = dirtyLastRow;
+		}
+
+		if (blitter_ != nullptr)
+		{
+			// Blit the changed region straight into the texture
+			auto region = blitter_->GetRegion(firstRow, lastRow);
+			auto scaled = postProcessor_ != nullptr ? postProcessor_->Scale(region) : region;
+			SDL_Rect damage{ scaled.x, scaled.y, scaled.w, scaled.h };
+			uint8_t* dst = nullptr;
+			int pitch = 0;
+
+			if (SDL_LockTexture(texture_, &damage, std::bit_cast<void**>(&dst), &pitch) != 0)
+			{
+				printf("Failed to lock texture, video frame dropped\n");
+				lastRenderedSequence_ = 0;
+				return false;
+			}
+
+			if (postProcessor_ != nullptr)
+			{
+				auto width = blitter_->Width();
+				blitter_->Blit(videoFrame.vram.data(), region, reinterpret_cast<uint8_t*>(sourceFrame_.data() + region.y * width + region.x), width * 4);
+
+				auto postProcessTime = FrameTiming::Now();
+				postProcessor_->Process(sourceFrame_.data(), region, dst, pitch);
+				frameTiming_.Record(FrameTiming::Stage::PostProcess, FrameTiming::Now() - postProcessTime);
+			}
+			else
+			{
+				blitter_->Blit(videoFrame.vram.data(), region, dst, pitch);
+			}
+
+			SDL_UnlockTexture(texture_);
+		}
+		else
+		{
+			auto width = i8080ArcadeIO_->GetVRAMWidth();
+			auto height = i8080ArcadeIO_->GetVRAMHeight();
+			SDL_Rect damage{ 0, 0, width, height };
+
+			if (rowMapping_.valid == true)
+			{
+				auto a = rowMapping_.origin + rowMapping_.step * static_cast<int>(firstRow);
+				auto b = rowMapping_.origin + rowMapping_.step * static_cast<int>(lastRow);
+
+				if (rowMapping_.columns == true)
+				{
+					damage.x = std::min(a, b);
+					damage.w = std::abs(b - a) + 1;
+				}
+				else
+				{
+					damage.y = std::min(a, b);
+					damage.h = std::abs(b - a) + 1;
+				}
+			}
+
+			i8080ArcadeIO_->BlitVRAM(std::span(stagingFrame_), width, std::span(videoFrame.vram));
+
+			if (SDL_UpdateTexture(texture_, &damage, stagingFrame_.data() + damage.y * width + damage.x, width) != 0)
+			{
+				printf("Failed to update texture, video frame dropped\n");
+				lastRenderedSequence_ = 0;
+				return false;
+			}
+		}
+
+		lastRenderedSequence_ = videoFrame.sequence;
+		return true;
+	}
+
+	void SdlIoController::DrawFrameTiming()
+	{
+		// One row per stage, each colour is the stage's bar
+		static constexpr std::array<SDL_Color, static_cast<size_t>(FrameTiming::Stage::Count)> colours
+		{{
+			{ 0x40, 0xC0, 0xFF, 0xFF },
+			{ 0xFF, 0xC0, 0x40, 0xFF },
+			{ 0x40, 0xFF, 0x60, 0xFF },
+			{ 0xA0, 0xFF, 0x40, 0xFF },
+			{ 0xFF, 0x40, 0xC0, 0xFF },
+			{ 0xFF, 0xFF, 0xFF, 0xFF },
+			{ 0xC0, 0x80, 0xFF, 0xFF },
+			{ 0xFF, 0x60, 0x40, 0xFF }
+		}};
+		constexpr double frameInterval = 1e9 / 60;
+		int width = 0;
+		int height = 0;
+		std::array<FrameTiming::Summary, static_cast<size_t>(FrameTiming::Stage::Count)> summaries{};
+
+		SDL_GetRendererOutputSize(renderer_, &width, &height);
+		SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+
+		for (size_t i = 0; i < summaries.size(); i++)
+		{
+			summaries[i] = frameTiming_.Summarise(static_cast<FrameTiming::Stage>(i));
+			auto barWidth = [width](int64_t latency) { return static_cast<int>(std::min(latency / frameInterval, 1.0) * width); };
+			auto colour = colours[i];
+			SDL_Rect bar{ 0, 4 + static_cast<int>(i) * 8, barWidth(summaries[i].p99), 6 };
+
+			SDL_SetRenderDrawColor(renderer_, colour.r, colour.g, colour.b, 0x60);
+			SDL_RenderFillRect(renderer_, &bar);
+			bar.w = barWidth(summaries[i].p50);
+			SDL_SetRenderDrawColor(renderer_, colour.r, colour.g, colour.b, colour.a);
+			SDL_RenderFillRect(renderer_, &bar);
+		}
+
+		SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+
+		auto now = std::chrono::steady_clock::now();
+
+		if (now - frameTimingTitleTime_ >= std::chrono::seconds(1))
+		{
+			std::string title = "i8080 arcade - p50/p99 ms";
+
+			for (size_t i = 0; i < summaries.size(); i++)
+			{
+				char stage[64];
+				snprintf(stage, sizeof(stage), " %s %.2f/%.2f", FrameTiming::StageName(static_cast<FrameTiming::Stage>(i)), summaries[i].p50 / 1e6, summaries[i].p99 / 1e6);
+				title += stage;
+			}
+
+			SDL_SetWindowTitle(window_, title.c_str());
+			frameTimingTitleTime_ = now;
+		}
+	}
+
+	void SdlIoController::DrawMemoryHeatmap()
+	{
+		constexpr int grid = 16;
+		auto profiler = memoryController_->GetMemoryProfiler();
+		std::array<std::array<uint64_t, MemoryProfiler::pages_>, 2> counts{ profiler->PageCounts(MemoryProfiler::Access::Read), profiler->PageCounts(MemoryProfiler::Access::Write) };
+		std::array<std::array<uint64_t, MemoryProfiler::pages_>, 2> deltas{};
+		uint64_t maxDelta = 1;
+
+		for (size_t access = 0; access < counts.size(); access++)
+		{
+			for (size_t page = 0; page < MemoryProfiler::pages_; page++)
+			{
+				deltas[access][page] = counts[access][page] - memoryHeatmapCounts_[access][page];
+				maxDelta = std::max(maxDelta, deltas[access][page]);
+			}
+		}
+
+		memoryHeatmapCounts_ = counts;
+
+		int width = 0;
+		int height = 0;
+		SDL_GetRendererOutputSize(renderer_, &width, &height);
+		auto cell = std::max(4, std::min(width, height) / 48);
+		auto originX = width - grid * cell - 4;
+		auto originY = height - grid * cell - 4;
+		auto scale = [maxDelta](uint64_t delta) { return static_cast<Uint8>(std::log1p(static_cast<double>(delta)) / std::log1p(static_cast<double>(maxDelta)) * 255); };
+
+		SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+
+		for (size_t page = 0; page < MemoryProfiler::pages_; page++)
+		{
+			SDL_Rect rect{ originX + static_cast<int>(page % grid) * cell, originY + static_cast<int>(page / grid) * cell, cell - 1, cell - 1 };
+			SDL_SetRenderDrawColor(renderer_, scale(deltas[1][page]), scale(deltas[0][page]), 0x20, 0xC0);
+			SDL_RenderFillRect(renderer_, &rect);
+		}
+
+		SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+	}
+
+	uint16_t SdlIoController::EncodeInputPorts(const Uint8* state)
+	{
+		uint8_t port1 = 0x08;
+		port1 |= (state[SDL_SCANCODE_C] * 0x01); // Credit
+		port1 |= (state[SDL_SCANCODE_1] * 0x04); // 1P
+		port1 |= (state[SDL_SCANCODE_2] * 0x02); // 2P
+		port1 |= (state[SDL_SCANCODE_A] * 0x20); // 1P Left
+		port1 |= (state[SDL_SCANCODE_S] * 0x10); // 1P Fire
+		port1 |= (state[SDL_SCANCODE_D] * 0x40); // 1P Right
+
+		uint8_t port2 = 0;
+		port2 |= (state[SDL_SCANCODE_3] * 0x00); // 3 Ships
+		port2 |= (state[SDL_SCANCODE_4] * 0x01); // 4 Ships
+		port2 |= (state[SDL_SCANCODE_5] * 0x02); // 5 Ships
+		port2 |= (state[SDL_SCANCODE_6] * 0x03); // 6 Ships
+		port2 |= (state[SDL_SCANCODE_T] * 0x04); // Tilt
+		port2 |= (state[SDL_SCANCODE_E] * 0x08); // Extra Ship at
+		port2 |= (state[SDL_SCANCODE_J] * 0x20); // 2P Left
+		port2 |= (state[SDL_SCANCODE_K] * 0x10); // 2P Fire
+		port2 |= (state[SDL_SCANCODE_L] * 0x40); // 2P Right
+		port2 |= (state[SDL_SCANCODE_I] * 0x80); // Show coin info
+
+		return port1 | (port2 << 8);
+	}
+
+	uint8_t SdlIoController::Read(uint16_t port)
+	{
+		uint8_t ret = 0;
+
+		if (quit_ == false)
+		{
+			ret = ports_.ReadPort(port);
+
+			if (ret == 0)
+			{
+				if (port == 1 || port == 2)
+				{
+					auto inputPorts = sampleInputPerFrame_ == true ? latchedInputPorts_ : inputPorts_.load(std::memory_order_relaxed);
+					ret = port == 1 ? inputPorts & 0xFF : inputPorts >> 8;
+
+					if (tracer_ != nullptr)
+					{
+						tracer_->Instant(Tracer::Event::InputRead, FrameTiming::Now());
+					}
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	void SdlIoController::Write(uint16_t port, uint8_t data)
+	{
+		if (quit_ == false)
+		{
+			auto audio = ports_.WritePort(port, data);
+
+			if (audio > 0 && (pacingSpeed_ > 1 || pacingSpeed_ == 0))
+			{
+				audio = ThrottleAudio(port, audio);
+			}
+
+			if (audio > 0 && tracer_ != nullptr)
+			{
+				tracer_->Instant(Tracer::Event::AudioTrigger, FrameTiming::Now());
+			}
+
+			// A looping sample can stop without any port bits being raised
+			if (port == 3 || port == 5)
+			{
+				TriggerAudio(port, data, audio);
+			}
+		}
+	}
+
+	void SdlIoController::TriggerAudio(uint16_t port, uint8_t data, uint8_t audio)
+	{
+		// port will either be 3 or 5
+		// when port is 3 offset will be 0 and when it is 5 it will be 8
+		auto offset = (port - 3) << 2;
+
+		if (audioMixer_ == nullptr)
+		{
+			if (audio > 0)
+			{
+				SDL_Event e{};
+				e.type = siEvent_;
+				e.user.code = EventCode::RenderAudio;
+				e.user.data1 = reinterpret_cast<void*>(static_cast<uintptr_t>((port << 8) | audio));
+				e.user.data2 = reinterpret_cast<void*>(static_cast<uintptr_t>(FrameTiming::Now()));
+				SDL_PushEvent(&e);
+			}
+
+			return;
+		}
+
+		auto& level = audioPortLevels_[(port - 3) >> 1];
+		auto loops = static_cast<uint8_t>(loopingSamples_ >> offset);
+		auto raised = static_cast<uint8_t>(data & ~level & loops);
+		auto lowered = static_cast<uint8_t>(level & ~data & loops);
+		audio &= static_cast<uint8_t>(~loops);
+		level = data;
+
+		for (int i = 0; i < 8; i++)
+		{
+			auto sample = static_cast<uint8_t>(i + offset);
+			auto bit = 1 << i;
+
+			// A full queue drops the trigger, the drops are reported when the event loop exits
+			if ((raised & bit) != 0)
+			{
+				audioMixer_->QueueTrigger(sample, AudioMixer::Action::Loop, static_cast<int64_t>(emulatedTime_));
+			}
+			else if ((lowered & bit) != 0)
+			{
+				audioMixer_->QueueTrigger(sample, AudioMixer::Action::Stop, static_cast<int64_t>(emulatedTime_));
+			}
+			else if ((audio & bit) != 0)
+			{
+				audioMixer_->QueueTrigger(sample, AudioMixer::Action::Play, static_cast<int64_t>(emulatedTime_));
+			}
+		}
+	}
+
+	MachEmu::ISR SdlIoController::ServiceInterrupts(uint64_t currTime, uint64_t cycles)
+	{
+		auto isr = MachEmu::ISR::Quit;
+
+		if(quit_ == false)
+		{
+			emulatedTime_ = currTime;
+			auto interrupt = i8080ArcadeIO_->GenerateInterrupt(currTime, cycles);
+			// Most calls have no interrupt to service, only the ones that do are traced
+			int64_t serviceTime = 0;
+
+			if (interrupt != 0)
+			{
+				{
+					Tracer::Scope scope(tracer_.get(), Tracer::Event::Pace);
+					Pace(currTime);
+				}
+
+				if (tracer_ != nullptr)
+				{
+					serviceTime = FrameTiming::Now();
+				}
+			}
+
+			switch(interrupt)
+			{
+				case 0:
+				{
+					isr = NextLoadSaveInterrupt();
+					break;
+				}
+				case 1:
+				{
+					isr = MachEmu::ISR::One;
+					break;
+				}
+				case 2:
+				{
+					isr = MachEmu::ISR::Two;
+					auto interruptTime = FrameTiming::Now();
+
+					if (inputLog_ != nullptr)
+					{
+						latchedInputPorts_ = inputLog_->Latch(inputPorts_.load(std::memory_order_relaxed));
+
+						// A recording may end at any frame, a replay only at its last
+						if (inputLog_->Replaying() == false || inputLog_->Finished() == true)
+						{
+							inputLog_->SetFrameHash(memoryController_->VramHash());
+						}
+
+						if (inputLog_->Finished() == true)
+						{
+							SDL_Event e{};
+							e.type = SDL_QUIT;
+							SDL_PushEvent(&e);
+							isr = MachEmu::ISR::Quit;
+							break;
+						}
+					}
+					else
+					{
+						latchedInputPorts_ = inputPorts_.load(std::memory_order_relaxed);
+					}
+
+					if (videoRecorder_ != nullptr)
+					{
+						videoRecorder_->Capture(*memoryController_);
+					}
+
+					pendingFrames_++;
+					captureRewind_ = rewindBuffer_.Enabled() == true && rewinding_.load(std::memory_order_relaxed) == false && inputLog_ == nullptr;
+
+					if (TakeFrame() == false)
+					{
+						// Skipped frames leave their rows marked dirty, they are picked up by the next frame taken
+						break;
+					}
+
+					if (tripleBuffering_ == true)
+					{
+						memoryController_->PublishVideoFrame(interruptTime);
+					}
+					else
+					{
+						auto videoFrame = memoryController_->GetVideoFrame(interruptTime);
 
-		window_ = SDL_CreateWindow("i8080 arcade",
-								SDL_WINDOWPOS_UNDEFINED,
-								SDL_WINDOWPOS_UNDEFINED,
-								videoHardware["width"].get<int>(),
-								videoHardware["height"].get<int>(),
-								videoHardware["full-screen"].get<bool>() ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+						if (videoFrame == nullptr)
+						{
+							// The main thread still holds every frame in the pool
+							videoFrameRing_.Drop();
+						}
+						else
+						{
+							// The frame is released back to the pool if the ring is full
+							videoFrameRing_.Push(std::move(videoFrame));
+						}
+					}
 
-		if (window_ == nullptr)
-		{
-			throw std::bad_alloc();
+					auto copiedTime = FrameTiming::Now();
+					frameTiming_.Record(FrameTiming::Stage::Copy, copiedTime - interruptTime);
+
+					if (tracer_ != nullptr)
+					{
+						tracer_->Span(Tracer::Event::FramePublish, interruptTime, copiedTime);
+					}
+
+					// Push the event even when the frame was dropped, it drives the control loop. The main thread
+					// takes every frame queued when it handles the event, so one in flight is enough. SDL_PushEvent
+					// takes the event queue lock, it is the only lock on the publish path and at most once per wake-up.
+					if (renderPending_.exchange(true, std::memory_order_acq_rel) == false)
+					{
+						SDL_Event e{};
+						e.type = siEvent_;
+						e.user.code = EventCode::RenderVideo;
+						e.user.data1 = nullptr;
+						e.user.data2 = nullptr;
+						SDL_PushEvent(&e);
+					}
+					break;
+				}
+				default:
+				{
+					assert(interrupt >= 0 && interrupt <= 2);
+					break;
+				}
+			}
+
+			if (serviceTime != 0)
+			{
+				tracer_->Span(Tracer::Event::ServiceInterrupts, serviceTime, FrameTiming::Now());
+			}
 		}
 
-		renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+		return isr;
+	}
 
-		if (renderer_ == nullptr)
+	MachEmu::ISR SdlIoController::NextLoadSaveInterrupt()
+	{
+		if (auto pending = pendingState_.load(std::memory_order_acquire); pending != PendingState::None)
 		{
-			printf("Failed to allocate an accelerated renderer, falling back to software\n");
-			renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_SOFTWARE);
+			// Wait for the machine to hand the state in flight to the OnSave or OnLoad handler
+			if (pendingFrames_ < pendingTimeout_)
+			{
+				return MachEmu::ISR::NoInterrupt;
+			}
 
-			if (renderer_ == nullptr)
+			// The handler may take it at the same time, only abandon it if it is still pending
+			if (pendingState_.compare_exchange_strong(pending, PendingState::None, std::memory_order_acq_rel) == false)
 			{
-				throw std::runtime_error("Failed to allocate an SDL renderer");
+				return MachEmu::ISR::NoInterrupt;
 			}
+
+			abandonedState_.store(pending, std::memory_order_release);
 		}
 
-		i8080ArcadeIO_ = meen_hw::MakeI8080ArcadeIO();
+		pendingFrames_ = 0;
 
-		if(i8080ArcadeIO_ == nullptr)
+		auto isr = loadSaveInterrupt_.exchange(MachEmu::ISR::NoInterrupt);
+
+		if (isr == MachEmu::ISR::Save)
 		{
-			throw std::runtime_error("Failed to create i8080 arcade hardware");
+			pendingState_ = PendingState::UserSave;
 		}
-
-		if (Mix_OpenAudio(audioHardware["sample-rate"].get<int>(), 8 /* format (mono) */, audioHardware["channels"].get<int>(), audioHardware["sample-size"].get<int>()) < 0)
+		else if (isr == MachEmu::ISR::Load)
+		{
+			pendingState_ = PendingState::UserLoad;
+		}
+		else if (rewindStep_.exchange(false) == true && rewindBuffer_.Empty() == false)
+		{
+			pendingState_ = PendingState::RewindLoad;
+			isr = MachEmu::ISR::Load;
+		}
+		else if (captureRewind_ == true)
 		{
-			throw std::runtime_error("Failed to open SDL Mixer");
+			captureRewind_ = false;
+			pendingState_ = PendingState::RewindSave;
+			isr = MachEmu::ISR::Save;
 		}
 
-		siEvent_ = SDL_RegisterEvents(1);
+		return isr;
+	}
 
-		if (siEvent_ == 0xFFFFFFFF)
+	SdlIoController::PendingState SdlIoController::TakePendingState()
+	{
+		auto pending = pendingState_.exchange(PendingState::None, std::memory_order_acq_rel);
+
+		if (pending == PendingState::None)
 		{
-			throw std::runtime_error("Exhausted all user level events");
+			// A late hand over of an abandoned request
+			pending = abandonedState_.exchange(PendingState::None, std::memory_order_acq_rel);
 		}
 
-		SDL_SetEventFilter([](void* eventType, SDL_Event* e)
-		{
-			// Ignore all events other than ours.
-			if (reinterpret_cast<uint64_t>(eventType) == e->type || e->type == SDL_QUIT)
-			{
-				return 1;
-			}
-			else
-			{
-				return 0;
-			}
-		},
-		reinterpret_cast<void*>(siEvent_));
+		return pending;
+	}
 
-		for(int i = 0; i < 1; i++)
+	bool SdlIoController::SaveRewindSnapshot(const char* json)
+	{
+		if (TakePendingState() != PendingState::RewindSave)
 		{
-			videoFrameWrapperPool_.emplace_back(std::make_unique<VideoFrameWrapper>());
+			return false;
 		}
+
+		rewindBuffer_.Push(json);
+		return true;
 	}
 
-	SdlIoController::~SdlIoController()
+	const char* SdlIoController::LoadRewindSnapshot()
 	{
-		if (renderer_ != nullptr)
+		if (TakePendingState() != PendingState::RewindLoad)
 		{
-			SDL_DestroyRenderer(renderer_);
+			// The history no longer leads up to the loaded game
+			rewindBuffer_.Clear();
+			return nullptr;
 		}
 
-		if (window_ != nullptr)
+		// Only this thread removes snapshots and the step is only requested when there is one
+		if (rewindBuffer_.Pop(rewindSnapshot_) == false)
 		{
-			SDL_DestroyWindow(window_);
+			throw std::runtime_error("The rewind buffer is empty");
+		}
+
+		return rewindSnapshot_.c_str();
+	}
+
+	void SdlIoController::Pace(uint64_t currTime)
+	{
+		auto speed = fastForward_.load(std::memory_order_relaxed) == true ? fastForwardSpeed_ : speed_;
+		auto now = std::chrono::steady_clock::now();
+
+		if (speed != pacingSpeed_ || currTime < anchorTime_)
+		{
+			// Restart pacing from here, the credit ensures the first frame at the new speed is taken
+			pacingSpeed_ = speed;
+			anchorTime_ = currTime;
+			anchorWallTime_ = now;
+			frameCredit_ = 1.0;
+			return;
 		}
 
-		for (auto& chunk : mixChunk_)
+		if (speed == 0)
 		{
-			Mix_FreeChunk(chunk);
+			return;
 		}
 
-		Mix_CloseAudio();
+		auto target = anchorWallTime_ + std::chrono::nanoseconds(static_cast<int64_t>((currTime - anchorTime_) / speed));
 
-		SDL_Quit();
+		if (target - now > maxLag_ || now - target > maxLag_)
+		{
+			// Too far out to catch up, the machine thread was starved or the emulated time jumped
+			anchorTime_ = currTime;
+			anchorWallTime_ = now;
+		}
+		else if (target > now)
+		{
+			std::this_thread::sleep_until(target);
+		}
 	}
 
-	void SdlIoController::LoadAudioSamples(const std::filesystem::path& audioFilePath, const nlohmann::json& audio)
+	bool SdlIoController::TakeFrame()
 	{
-		for(const auto& file : audio["file"])
+		if (pacingSpeed_ == 0)
 		{
-			auto name = file.get<std::string>();
-			auto mixChunk = Mix_LoadWAV((audioFilePath/name).string().c_str());
+			// There is no emulated to real time ratio, take a frame once per display interval of real time
+			auto now = std::chrono::steady_clock::now();
 
-			if(name.empty() == false && mixChunk == nullptr)
+			if (now - lastFrameWallTime_ < frameInterval_)
 			{
-				throw std::runtime_error("Failed to load audio sample");
+				return false;
 			}
 
-			mixChunk_.emplace_back(mixChunk);
+			lastFrameWallTime_ = now;
+			return true;
 		}
-	}
 
-	void SdlIoController::LoadVideoTextures(const nlohmann::json& videoTextures)
-	{
-		i8080ArcadeIO_->SetOptions(videoTextures.dump().c_str());
-		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-		texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGB332, SDL_TEXTUREACCESS_STREAMING, i8080ArcadeIO_->GetVRAMWidth(), i8080ArcadeIO_->GetVRAMHeight());
+		// Each render interrupt is 1 / speed display intervals of real time, take a frame each time a whole interval has elapsed.
+		// The epsilon absorbs the rounding error in speeds such as 3 where 1 / speed is not exact.
+		frameCredit_ += 1.0 / pacingSpeed_;
 
-		if (texture_ == nullptr)
+		if (frameCredit_ < 1.0 - 1e-9)
 		{
-			throw std::bad_alloc();
+			return false;
 		}
+
+		frameCredit_ = std::max(frameCredit_ - std::floor(frameCredit_ + 1e-9), 0.0);
+		return true;
 	}
 
-	uint8_t SdlIoController::Read(uint16_t port)
+	uint8_t SdlIoController::ThrottleAudio(uint16_t port, uint8_t audio)
 	{
-		uint8_t ret = 0;
+		auto now = std::chrono::steady_clock::now();
+		// See the RenderAudio event for the mapping of port bits to samples
+		auto offset = static_cast<size_t>((port - 3) << 2);
 
-		if (quit_ == false)
+		for (size_t i = 0; i < 8; i++)
 		{
-			ret = i8080ArcadeIO_->ReadPort(port);
+			auto sample = i + offset;
 
-			if (ret == 0)
+			if ((audio & (1 << i)) == 0 || sample >= sampleTriggered_.size())
 			{
-				if (port == 1 || port == 2)
-				{
-					std::promise<uint8_t> p;
-					SDL_Event e{};
-					e.type = siEvent_;
-					e.user.code = EventCode::ReadInput;
-					e.user.data1 = reinterpret_cast<void*>(port);
-					e.user.data2 = reinterpret_cast<void*>(&p);
-					SDL_PushEvent(&e);
-					ret = p.get_future().get();
-				}
+				continue;
 			}
-		}
 
-		return ret;
-	}
-
-	void SdlIoController::Write(uint16_t port, uint8_t data)
-	{
-		if (quit_ == false)
-		{
-			auto audio = i8080ArcadeIO_->WritePort(port, data);
+			auto duration = sample < sampleDuration_.size() ? sampleDuration_[sample] : std::chrono::nanoseconds(0);
 
-			if (audio > 0)
+			// Don't retrigger a sample that is still playing, but always allow one per display interval
+			if (now - sampleTriggered_[sample] < std::max<std::chrono::nanoseconds>(duration, frameInterval_))
 			{
-				SDL_Event e{};
-				e.type = siEvent_;
-				e.user.code = EventCode::RenderAudio;
-				e.user.data1 = reinterpret_cast<void*>(port);
-				e.user.data2 = reinterpret_cast<void*>(audio);
-				SDL_PushEvent(&e);
+				audio &= static_cast<uint8_t>(~(1 << i));
+			}
+			else
+			{
+				sampleTriggered_[sample] = now;
 			}
 		}
+
+		return audio;
 	}
 
-	MachEmu::ISR SdlIoController::ServiceInterrupts(uint64_t currTime, uint64_t cycles)
+	void SdlIoController::SetSpeed(double speed, double fastForwardSpeed)
 	{
-		auto isr = MachEmu::ISR::Quit;
-
-		if(quit_ == false)
+		if (speed < 0 || fastForwardSpeed < 0)
 		{
-			auto interrupt = i8080ArcadeIO_->GenerateInterrupt(currTime, cycles);
-	
-			switch(interrupt)
-			{
-				case 0:
-				{
-					isr = loadSaveInterrupt_.exchange(MachEmu::ISR::NoInterrupt);				
-					break;
-				}
-				case 1:
-				{
-					isr = MachEmu::ISR::One;
-					break;
-				}
-				case 2:
-				{
-					isr = MachEmu::ISR::Two;
-					VideoFrameWrapper* videoFrameWrapper = nullptr; 
+			throw std::invalid_argument("The speed must not be negative");
+		}
 
-					{
-						std::lock_guard<std::mutex> lg(videoFrameWrapperMutex_);
-						
-						if(videoFrameWrapperPool_.empty() == false)
-						{
-							videoFrameWrapper = videoFrameWrapperPool_.back().release();
-						}
-					}
+		speed_ = speed;
+		fastForwardSpeed_ = fastForwardSpeed;
+	}
 
-					if(videoFrameWrapper != nullptr)
-					{				
-						videoFrameWrapper->videoFrame = memoryController_->GetVideoFrame();	
-					}
+	void SdlIoController::SetInputLog(const std::shared_ptr<InputLog>& inputLog)
+	{
+		inputLog_ = inputLog;
+		// The log holds the inputs latched at each frame, so that is all the machine may see
+		sampleInputPerFrame_ = true;
+	}
 
-					SDL_Event e{};
-					e.type = siEvent_;
-					e.user.code = EventCode::RenderVideo;
-					// Allow events where the vram is nullptr to be pushed so we can track
-					// dropped frames in the main thread.
-					e.user.data1 = videoFrameWrapper;
-					e.user.data2 = nullptr;
-					SDL_PushEvent(&e);
-					break;
-				}
-				default:
-				{
-					assert(interrupt >= 0 && interrupt <= 2);
-					break;
-				}
-			}
-		}
+	void SdlIoController::SetVideoRecorder(const std::shared_ptr<VideoRecorder>& videoRecorder)
+	{
+		videoRecorder_ = videoRecorder;
+	}
 
-		return isr;
+	void SdlIoController::SetTracer(const std::shared_ptr<Tracer>& tracer)
+	{
+		tracer_ = tracer;
+	}
+
+	void SdlIoController::OnFirstFrame(std::function<void()> onFirstFrame)
+	{
+		onFirstFrame_ = std::move(onFirstFrame);
 	}
 
 	std::array<uint8_t, 16> SdlIoController::Uuid() const
@@ -269,6 +1265,8 @@ namespace i8080_arcade
 		Uint8 lastY = 0;
 		const auto state = SDL_GetKeyboardState(nullptr);
 
+		inputPorts_ = EncodeInputPorts(state);
+
 		while (quit_ == false && SDL_WaitEvent(&e))
 		{
 			switch (e.type)
@@ -278,6 +1276,38 @@ namespace i8080_arcade
 					quit_ = true;
 					break;
 				}
+				case SDL_KEYDOWN:
+				case SDL_KEYUP:
+				{
+					// Publish the new input snapshot, the machine thread picks it up on its next port read
+					quit_ = state[SDL_SCANCODE_Q];
+					fastForward_.store(state[SDL_SCANCODE_TAB] != 0, std::memory_order_relaxed);
+					rewinding_.store(state[SDL_SCANCODE_BACKSPACE] != 0, std::memory_order_relaxed);
+					inputPorts_.store(EncodeInputPorts(state), std::memory_order_relaxed);
+
+					if (e.type == SDL_KEYDOWN && e.key.repeat == 0 && e.key.keysym.scancode == SDL_SCANCODE_F1)
+					{
+						showFrameTiming_ = !showFrameTiming_;
+						// Upload the next frame in full to clear the overlay and restore the title
+						lastRenderedSequence_ = 0;
+						frameTimingTitleTime_ = {};
+						SDL_SetWindowTitle(window_, "i8080 arcade");
+					}
+					else if (e.type == SDL_KEYDOWN && e.key.repeat == 0 && e.key.keysym.scancode == SDL_SCANCODE_F2)
+					{
+						if (memoryController_->GetMemoryProfiler() == nullptr)
+						{
+							printf("The memory heatmap needs a build with the I8080_ARCADE_MEMORY_PROFILE CMake option enabled\n");
+						}
+						else
+						{
+							showMemoryHeatmap_ = !showMemoryHeatmap_;
+							// Upload the next frame in full to clear the overlay
+							lastRenderedSequence_ = 0;
+						}
+					}
+					break;
+				}
 				default:
 				{
 					if(e.type == siEvent_)
@@ -286,48 +1316,125 @@ namespace i8080_arcade
 						{
 							case EventCode::RenderVideo:
 							{
-								auto videoFrameWrapper = std::bit_cast<VideoFrameWrapper*>(e.user.data1);
+								// Frames published from here on push a new event, the exchange pairs with the machine thread's
+								renderPending_.exchange(false, std::memory_order_acq_rel);
+
+								// Low latency pacing waits until just before the vblank so that the newest frame is the one presented
+								auto now = FrameTiming::Now();
+
+								if (tracer_ != nullptr)
+								{
+									tracer_->Instant(Tracer::Event::EventDequeue, now);
+								}
+
+								// There is nothing to wait for when no new frame has been queued, the event only drives the loop
+								auto frameQueued = tripleBuffering_ == true ? memoryController_->VideoFramePublished() : videoFrameRing_.Produced() != videoFrameRing_.Consumed();
+
+								if (auto wait = displayPacer_.PresentDeadline(now) - now; wait > 0 && frameQueued == true)
+								{
+									std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+								}
+
+								auto dequeuedTime = FrameTiming::Now();
+								int64_t interruptTime = 0;
 
-								if (videoFrameWrapper != nullptr)
+								auto upload = [this, dequeuedTime, &interruptTime](VideoFrame& videoFrame)
 								{
-									// Move the frame out of the wrapper. This must be done as it allows the
-									// video frame to be returned back to the memory controller, alternatively,
-									// one could set videoFrameWrapper->videoFrame to nullptr once it is no longer
-									// needed.
-									auto videoFrame = std::move(videoFrameWrapper->videoFrame);
-									// We are done with the wrapper, return it back to the wrapper pool
+									interruptTime = videoFrame.interruptTime;
+									frameTiming_.Record(FrameTiming::Stage::Queue, dequeuedTime - videoFrame.copiedTime);
+									auto blitTime = FrameTiming::Now();
+									auto uploaded = UploadVideoFrame(videoFrame);
+									auto blittedTime = FrameTiming::Now();
+									frameTiming_.Record(FrameTiming::Stage::Blit, blittedTime - blitTime);
+
+									if (tracer_ != nullptr)
 									{
-										std::lock_guard<std::mutex> lg(videoFrameWrapperMutex_);
-										videoFrameWrapperPool_.push_back(std::unique_ptr<VideoFrameWrapper>(videoFrameWrapper));
+										tracer_->Span(Tracer::Event::Blit, blitTime, blittedTime);
 									}
 
-									if (videoFrame != nullptr)
-									{
-										uint8_t* dst = nullptr;
-										int rowBytes = 0;
+									return uploaded;
+								};
+
+								auto uploaded = false;
+
+								if (tripleBuffering_ == true)
+								{
+									// The front frame is read in place, it is only uploaded if it is new
+									auto videoFrame = memoryController_->AcquireVideoFrame();
+									uploaded = videoFrame != nullptr && videoFrame->sequence != lastRenderedSequence_ && upload(*videoFrame);
+								}
+								else
+								{
+									VideoFramePtr videoFrame;
 
-										if (SDL_LockTexture(texture_, nullptr, std::bit_cast<void**>(&dst), &rowBytes) == 0)
+									// The frame is released back to the memory controller frame pool when it goes out of scope
+									if (displayPacer_.GetMode() == DisplayPacer::Mode::LowLatency)
+									{
+										// Present the newest frame, the older ones are released unseen
+										for (VideoFramePtr newerFrame; videoFrameRing_.Pop(newerFrame) == true;)
 										{
-											i8080ArcadeIO_->BlitVRAM(std::span(dst, i8080ArcadeIO_->GetVRAMWidth() * i8080ArcadeIO_->GetVRAMHeight()), rowBytes, std::span(*videoFrame));
-											SDL_UnlockTexture(texture_);
+											videoFrame = std::move(newerFrame);
 										}
-										else
+									}
+									else if (displayPacer_.GetMode() == DisplayPacer::Mode::Smooth)
+									{
+										// Keep a frame queued so that there is one ready for the next vblank
+										if (videoFrameRing_.Produced() - videoFrameRing_.Consumed() >= 2)
 										{
-											printf("Failed to lock texture, video frame dropped\n");
+											videoFrameRing_.Pop(videoFrame);
 										}
 									}
 									else
 									{
-										printf("Video frame dropped\n");
+										videoFrameRing_.Pop(videoFrame);
 									}
+
+									uploaded = videoFrame != nullptr && upload(*videoFrame) == true;
 								}
-								else
+
+								// The present is skipped when the frame is identical to the one already on screen,
+								// unless an overlay is being drawn over it
+								if (uploaded == true || showFrameTiming_ == true || showMemoryHeatmap_ == true)
 								{
-									printf("Wrapper empty, video frame dropped\n");
-								}
+									auto presentTime = FrameTiming::Now();
+									SDL_RenderCopy(renderer_, texture_, nullptr, nullptr);
+
+									if (showFrameTiming_ == true)
+									{
+										DrawFrameTiming();
+									}
+
+									if (showMemoryHeatmap_ == true)
+									{
+										DrawMemoryHeatmap();
+									}
+
+									displayPacer_.Prepared(FrameTiming::Now() - dequeuedTime);
+									SDL_RenderPresent(renderer_);
+									auto presentedTime = FrameTiming::Now();
+
+									if (tracer_ != nullptr)
+									{
+										tracer_->Span(Tracer::Event::Present, presentTime, presentedTime);
+									}
+
+									if (auto judder = displayPacer_.Presented(presentedTime, uploaded); judder >= 0)
+									{
+										frameTiming_.Record(FrameTiming::Stage::Judder, judder);
+									}
+
+									if (uploaded == true)
+									{
+										frameTiming_.Record(FrameTiming::Stage::Present, presentedTime - presentTime);
+										frameTiming_.Record(FrameTiming::Stage::Total, presentedTime - interruptTime);
 
-								SDL_RenderCopy(renderer_, texture_, nullptr, nullptr);
-								SDL_RenderPresent(renderer_);
+										if (onFirstFrame_ != nullptr)
+										{
+											onFirstFrame_();
+											onFirstFrame_ = nullptr;
+										}
+									}
+								}
 
 								// Scan the keyboard for load and save requests, we'll lock this to
 								// the renderer, ie; check for these requests 60 times per second
@@ -341,14 +1448,26 @@ namespace i8080_arcade
 									return key;
 								};
 
-								lastR = setInterrupt(state[SDL_SCANCODE_R], lastR, MachEmu::ISR::Load);
+								// Loading a game would take a recorded or replayed run off its path
+								if (inputLog_ == nullptr)
+								{
+									lastR = setInterrupt(state[SDL_SCANCODE_R], lastR, MachEmu::ISR::Load);
+								}
+
 								lastY = setInterrupt(state[SDL_SCANCODE_Y], lastY, MachEmu::ISR::Save);
+
+								// Step back one snapshot per presented frame while the rewind key is held
+								if (rewinding_.load(std::memory_order_relaxed) == true)
+								{
+									rewindStep_ = true;
+								}
 								break;
 							}
 							case EventCode::RenderAudio:
 							{
-								uint8_t port = reinterpret_cast<uint64_t>(e.user.data1);
-								std::bitset<8> audio = reinterpret_cast<uint64_t>(e.user.data2);
+								auto data = reinterpret_cast<uintptr_t>(e.user.data1);
+								uint8_t port = data >> 8;
+								std::bitset<8> audio = data & 0xFF;
 								// port will either be 3 or 5
 								// when port is 3 index will be 0 and when it is 5 it will be 8
 								// which will give the correct offset into the mixChunk_ array
@@ -364,44 +1483,10 @@ namespace i8080_arcade
 										//assert(mixChunk_[i] == nullptr || busy != -1);
 									}
 								}
-								break;
-							}
-							case EventCode::ReadInput:
-							{
-								uint8_t port = reinterpret_cast<uint64_t>(e.user.data1);
-								auto p = static_cast<std::promise<uint8_t>*>(e.user.data2);
-								uint8_t value = 0;
-								quit_ = state[SDL_SCANCODE_Q];
-
-								if (port == 1)
-								{
-									value = 0x08;
-									value |= (state[SDL_SCANCODE_C] * 0x01); // Credit
-									value |= (state[SDL_SCANCODE_1] * 0x04); // 1P
-									value |= (state[SDL_SCANCODE_2] * 0x02); // 2P
-									value |= (state[SDL_SCANCODE_A] * 0x20); // 1P Left
-									value |= (state[SDL_SCANCODE_S] * 0x10); // 1P Fire
-									value |= (state[SDL_SCANCODE_D] * 0x40); // 1P Right
-								}
-								else if (port == 2)
-								{
-									value |= (state[SDL_SCANCODE_3] * 0x00); // 3 Ships
-									value |= (state[SDL_SCANCODE_4] * 0x01); // 4 Ships
-									value |= (state[SDL_SCANCODE_5] * 0x02); // 5 Ships
-									value |= (state[SDL_SCANCODE_6] * 0x03); // 6 Ships
-									value |= (state[SDL_SCANCODE_T] * 0x04); // Tilt
-									value |= (state[SDL_SCANCODE_E] * 0x08); // Extra Ship at
-									value |= (state[SDL_SCANCODE_J] * 0x20); // 2P Left
-									value |= (state[SDL_SCANCODE_K] * 0x10); // 2P Fire
-									value |= (state[SDL_SCANCODE_L] * 0x40); // 2P Right
-									value |= (state[SDL_SCANCODE_I] * 0x80); // Show coin info
-								}
-								else
-								{
-									printf("Invalid Read Port: %d\n", port);
-								}
 
-								p->set_value(value);
+								// Keep the oldest trigger time until the post mix callback takes it
+								int64_t none = 0;
+								mixTriggerTime_.compare_exchange_strong(none, static_cast<int64_t>(reinterpret_cast<uintptr_t>(e.user.data2)), std::memory_order_relaxed);
 								break;
 							}
 							default:
@@ -414,5 +1499,25 @@ namespace i8080_arcade
 				}
 			}
 		}
+
+		frameTiming_.PrintSummary();
+
+		if (displayPacer_.GetMode() != DisplayPacer::Mode::Off)
+		{
+			printf("Display refresh interval: %.3f ms measured, %.3f ms nominal\n", displayPacer_.RefreshInterval() / 1e6, displayPacer_.NominalRefreshInterval() / 1e6);
+		}
+
+		if (audioMixer_ != nullptr && audioMixer_->DroppedTriggers() > 0)
+		{
+			printf("Audio triggers dropped: %llu\n", static_cast<unsigned long long>(audioMixer_->DroppedTriggers()));
+		}
+
+		if (tripleBuffering_ == false)
+		{
+			printf("Video frames produced: %llu, consumed: %llu, dropped: %llu\n",
+				static_cast<unsigned long long>(videoFrameRing_.Produced()),
+				static_cast<unsigned long long>(videoFrameRing_.Consumed()),
+				static_cast<unsigned long long>(videoFrameRing_.Dropped()));
+		}
 	}
 } // namespace i8080_arcade
\ No newline at end of file
@@ -0,0 +1,266 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#include "i8080_arcade/FrameTiming.h"
+#include "i8080_arcade/Tracer.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		struct EventInfo
+		{
+			const char* name;
+			const char* thread;
+		};
+
+		// Indexed by Tracer::Event, the thread is written as the category of the event and names the thread which records it
+		constexpr std::array<EventInfo, static_cast<size_t>(Tracer::Event::Count)> eventInfo
+		{{
+			{ "pace", "machine" },
+			{ "service-interrupts", "machine" },
+			{ "frame-publish", "machine" },
+			{ "input-read", "machine" },
+			{ "audio-trigger", "machine" },
+			{ "save", "machine" },
+			{ "load", "machine" },
+			{ "event-dequeue", "event-loop" },
+			{ "blit", "event-loop" },
+			{ "present", "event-loop" },
+			{ "audio-mix", "audio" }
+		}};
+
+		std::atomic<uint64_t> nextTracerId{ 1 };
+	} // namespace
+
+	Tracer::Scope::Scope(Tracer* tracer, Event event)
+		: tracer_{ tracer },
+		event_{ event },
+		start_{ tracer != nullptr ? FrameTiming::Now() : 0 }
+	{
+	}
+
+	Tracer::Scope::~Scope()
+	{
+		if (tracer_ != nullptr)
+		{
+			tracer_->Span(event_, start_, FrameTiming::Now());
+		}
+	}
+
+	Tracer::Tracer(const std::filesystem::path& path)
+		: path_{ path },
+		id_{ nextTracerId.fetch_add(1, std::memory_order_relaxed) },
+		startTime_{ FrameTiming::Now() }
+	{
+		fout_.open(path, std::ios::trunc);
+
+		if (!fout_)
+		{
+			throw std::runtime_error("The trace file " + path.string() + " failed to open");
+		}
+
+		fout_ << "[";
+		writer_ = std::thread(&Tracer::WriteEvents, this);
+	}
+
+	Tracer::~Tracer()
+	{
+		if (writer_.joinable() == true)
+		{
+			try
+			{
+				Close();
+			}
+			catch (const std::exception& e)
+			{
+				printf("%s\n", e.what());
+			}
+		}
+	}
+
+	Tracer::ThreadRing& Tracer::Ring(Event event)
+	{
+		struct Cache
+		{
+			uint64_t tracerId;
+			ThreadRing* ring;
+		};
+
+		// There is one tracer at a time, a thread recording to another registers a new ring with it
+		thread_local Cache cache{};
+
+		if (cache.tracerId != id_)
+		{
+			// Once per thread, the only time recording takes a lock or allocates
+			std::scoped_lock lock(mutex_);
+			auto ring = std::make_unique<ThreadRing>();
+			ring->tid = static_cast<uint32_t>(rings_.size() + 1);
+			ring->firstEvent = event;
+			cache = { id_, ring.get() };
+			rings_.push_back(std::move(ring));
+		}
+
+		return *cache.ring;
+	}
+
+	void Tracer::Push(const Record& record)
+	{
+		// A full ring counts the event as dropped
+		Ring(record.event).records.Push(Record(record));
+	}
+
+	void Tracer::Span(Event event, int64_t start, int64_t end)
+	{
+		Push({ start, std::max<int64_t>(end - start, 0), event });
+	}
+
+	void Tracer::Instant(Event event, int64_t time)
+	{
+		Push({ time, -1, event });
+	}
+
+	void Tracer::WriteEvents()
+	{
+		std::vector<ThreadRing*> rings;
+		size_t named = 0;
+		auto first = true;
+		char line[256];
+
+		auto write = [this, &first, &line](int length)
+		{
+			if (failed_.load(std::memory_order_relaxed) == true)
+			{
+				return;
+			}
+
+			fout_ << (first == true ? "\n" : ",\n");
+			fout_.write(line, length);
+			first = false;
+
+			if (!fout_)
+			{
+				failed_.store(true, std::memory_order_relaxed);
+			}
+		};
+
+		for (;;)
+		{
+			// Read before draining so that an event recorded just before the trace was closed is not missed
+			auto stopping = stopping_.load(std::memory_order_acquire);
+
+			{
+				std::scoped_lock lock(mutex_);
+
+				for (auto i = rings.size(); i < rings_.size(); i++)
+				{
+					rings.push_back(rings_[i].get());
+				}
+			}
+
+			for (; named < rings.size(); named++)
+			{
+				auto ring = rings[named];
+				write(snprintf(line, sizeof(line), R"({"name":"thread_name","ph":"M","pid":1,"tid":%u,"args":{"name":"%s"}})",
+					ring->tid, eventInfo[static_cast<size_t>(ring->firstEvent)].thread));
+			}
+
+			for (auto ring : rings)
+			{
+				Record record;
+
+				while (ring->records.Pop(record) == true)
+				{
+					const auto& info = eventInfo[static_cast<size_t>(record.event)];
+					// The trace times are in microseconds
+					auto ts = (record.start - startTime_) / 1e3;
+
+					if (record.duration < 0)
+					{
+						write(snprintf(line, sizeof(line), R"({"name":"%s","cat":"%s","ph":"i","s":"t","pid":1,"tid":%u,"ts":%.3f})",
+							info.name, info.thread, ring->tid, ts));
+					}
+					else
+					{
+						write(snprintf(line, sizeof(line), R"({"name":"%s","cat":"%s","ph":"X","pid":1,"tid":%u,"ts":%.3f,"dur":%.3f})",
+							info.name, info.thread, ring->tid, ts, record.duration / 1e3));
+					}
+
+					written_.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+
+			if (stopping == true)
+			{
+				break;
+			}
+
+			// Polling keeps the traced threads free of any signalling
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+
+		fout_ << "\n]\n";
+		fout_.close();
+
+		if (!fout_)
+		{
+			failed_.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	Tracer::Statistics Tracer::Close()
+	{
+		if (writer_.joinable() == true)
+		{
+			stopping_.store(true, std::memory_order_release);
+			writer_.join();
+		}
+
+		if (failed_.load(std::memory_order_relaxed) == true)
+		{
+			throw std::runtime_error("Failed to write the trace file " + path_.string());
+		}
+
+		Statistics statistics{ 0, written_.load(std::memory_order_relaxed), 0 };
+		std::scoped_lock lock(mutex_);
+
+		for (const auto& ring : rings_)
+		{
+			statistics.recorded += ring->records.Produced();
+			statistics.dropped += ring->records.Dropped();
+		}
+
+		return statistics;
+	}
+
+	const std::filesystem::path& Tracer::Path() const
+	{
+		return path_;
+	}
+} // namespace i8080_arcade
@@ -0,0 +1,192 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "i8080_arcade/VideoRecorder.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		uint8_t RecordedColour(const nlohmann::json& videoOptions)
+		{
+			const auto& colourOption = videoOptions["colour"];
+			auto colour = colourOption.is_number() == true ? std::optional<uint8_t>(colourOption.get<uint8_t>()) : VramBlitter::ParseColour(colourOption.get<std::string>());
+
+			if (colour.has_value() == false)
+			{
+				throw std::invalid_argument("The video colour can't be recorded, use a fixed colour");
+			}
+
+			return *colour;
+		}
+	} // namespace
+
+	VideoRecorder::VideoRecorder(const std::filesystem::path& path, const nlohmann::json& videoOptions)
+		: path_{ path },
+		blitter_{ videoOptions["orientation"].get<std::string>() == "upright", RecordedColour(videoOptions), VramBlitter::PixelFormat::RGB332 }
+	{
+		// Full range BT.601, a frame is black and a single colour so the conversion loses nothing
+		for (int i = 0; i < 256; i++)
+		{
+			auto r = ((i >> 5) & 0x07) * 255.0 / 7;
+			auto g = ((i >> 2) & 0x07) * 255.0 / 7;
+			auto b = (i & 0x03) * 255.0 / 3;
+			auto clamp = [](double v) { return static_cast<uint8_t>(std::lround(std::clamp(v, 0.0, 255.0))); };
+
+			planes_[0][i] = clamp(0.299 * r + 0.587 * g + 0.114 * b);
+			planes_[1][i] = clamp(128 - 0.168736 * r - 0.331264 * g + 0.5 * b);
+			planes_[2][i] = clamp(128 + 0.5 * r - 0.418688 * g - 0.081312 * b);
+		}
+
+		fout_.open(path, std::ios::binary | std::ios::trunc);
+
+		if (!fout_)
+		{
+			throw std::runtime_error("The video file " + path.string() + " failed to open");
+		}
+
+		// The render interrupt runs at 60Hz in emulated time regardless of the speed the machine is run at
+		fout_ << "YUV4MPEG2 W" << blitter_.Width() << " H" << blitter_.Height() << " F60:1 Ip A1:1 C444 XCOLORRANGE=FULL\n";
+		writer_ = std::thread(&VideoRecorder::WriteFrames, this);
+	}
+
+	VideoRecorder::~VideoRecorder()
+	{
+		if (writer_.joinable() == true)
+		{
+			try
+			{
+				Close();
+			}
+			catch (const std::exception& e)
+			{
+				printf("%s\n", e.what());
+			}
+		}
+	}
+
+	void VideoRecorder::WriteFrames()
+	{
+		auto width = blitter_.Width();
+		auto height = blitter_.Height();
+		auto pixels = static_cast<size_t>(width) * height;
+		auto region = blitter_.GetRegion(0, VideoFrame::rows - 1);
+		std::vector<uint8_t> rgb332(pixels);
+		std::vector<char> frame(pixels * 3);
+		Vram vram{};
+
+		for (;;)
+		{
+			// Read before draining so that a frame queued just before the recording was closed is not missed
+			auto stopping = stopping_.load(std::memory_order_acquire);
+
+			while (frameQueue_.Pop(vram) == true)
+			{
+				if (failed_.load(std::memory_order_relaxed) == true)
+				{
+					continue;
+				}
+
+				blitter_.Blit(vram.data(), region, rgb332.data(), width);
+
+				for (size_t plane = 0; plane < planes_.size(); plane++)
+				{
+					auto out = frame.data() + plane * pixels;
+
+					for (size_t i = 0; i < pixels; i++)
+					{
+						out[i] = static_cast<char>(planes_[plane][rgb332[i]]);
+					}
+				}
+
+				fout_.write("FRAME\n", 6);
+				fout_.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+
+				if (!fout_)
+				{
+					failed_.store(true, std::memory_order_relaxed);
+					continue;
+				}
+
+				written_.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			if (stopping == true)
+			{
+				break;
+			}
+
+			// A frame arrives every 16.7ms at normal speed, polling keeps the machine thread free of any signalling
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+
+		fout_.close();
+
+		if (!fout_)
+		{
+			failed_.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	void VideoRecorder::Capture(const MemoryController& memoryController, bool wait)
+	{
+		Vram vram;
+		memoryController.ReadBlock(vramAddress_, vram);
+
+		while (wait == true && frameQueue_.Produced() - frameQueue_.Consumed() == frameQueue_.Capacity() && failed_.load(std::memory_order_relaxed) == false)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// A full queue counts the frame as dropped
+		frameQueue_.Push(std::move(vram));
+	}
+
+	VideoRecorder::Statistics VideoRecorder::Close()
+	{
+		if (writer_.joinable() == true)
+		{
+			stopping_.store(true, std::memory_order_release);
+			writer_.join();
+		}
+
+		if (failed_.load(std::memory_order_relaxed) == true)
+		{
+			throw std::runtime_error("Failed to write the video file " + path_.string());
+		}
+
+		return { frameQueue_.Produced(), written_.load(std::memory_order_relaxed), frameQueue_.Dropped() };
+	}
+
+	const std::filesystem::path& VideoRecorder::Path() const
+	{
+		return path_;
+	}
+} // namespace i8080_arcade
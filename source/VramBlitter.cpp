@@ -0,0 +1,316 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__arm__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#include "i8080_arcade/VramBlitter.h"
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		// For each byte value, a 64 bit word with byte n set to 0xFF when bit n is set
+		constexpr std::array<uint64_t, 256> MakeByteMasks()
+		{
+			std::array<uint64_t, 256> masks{};
+
+			for (size_t value = 0; value < masks.size(); value++)
+			{
+				for (size_t bit = 0; bit < 8; bit++)
+				{
+					if (value & (size_t{1} << bit))
+					{
+						masks[value] |= uint64_t{0xFF} << (bit * 8);
+					}
+				}
+			}
+
+			return masks;
+		}
+
+		constexpr auto byteMasks = MakeByteMasks();
+
+		void Expand8Scalar(const uint8_t* bits, size_t bytes, uint8_t* dst, uint8_t colour)
+		{
+			const auto colours = uint64_t{0x0101010101010101} * colour;
+
+			for (size_t i = 0; i < bytes; i++)
+			{
+				// The frame buffer is little endian on all supported targets, byte n of the word is pixel n
+				auto pixels = byteMasks[bits[i]] & colours;
+				std::memcpy(dst + i * 8, &pixels, sizeof(pixels));
+			}
+		}
+
+		void Expand32Scalar(const uint8_t* bits, size_t bytes, uint32_t* dst, uint32_t colour, uint32_t background)
+		{
+			for (size_t i = 0; i < bytes; i++)
+			{
+				for (size_t bit = 0; bit < 8; bit++)
+				{
+					*dst++ = (bits[i] >> bit) & 0x01 ? colour : background;
+				}
+			}
+		}
+
+		// Transpose an 8x8 bit matrix where byte n is row n and bit n is column n
+		uint64_t Transpose8x8(uint64_t x)
+		{
+			auto t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AA;
+			x = x ^ t ^ (t << 7);
+			t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCC;
+			x = x ^ t ^ (t << 14);
+			t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0;
+			return x ^ t ^ (t << 28);
+		}
+
+		uint32_t ToArgb8888(uint8_t rgb332)
+		{
+			uint32_t r = ((rgb332 >> 5) & 0x07) * 255 / 7;
+			uint32_t g = ((rgb332 >> 2) & 0x07) * 255 / 7;
+			uint32_t b = (rgb332 & 0x03) * 255 / 3;
+			return 0xFF000000 | (r << 16) | (g << 8) | b;
+		}
+
+		bool CpuSupportsAvx2()
+		{
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+			return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && defined(_M_X64)
+			int info[4]{};
+			__cpuid(info, 0);
+
+			if (info[0] < 7)
+			{
+				return false;
+			}
+
+			__cpuid(info, 1);
+
+			// The OS must save the ymm registers (OSXSAVE and AVX set and XCR0 bits 1 and 2 set)
+			if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x06) != 0x06)
+			{
+				return false;
+			}
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return false;
+#endif
+		}
+
+		bool CpuSupportsNeon()
+		{
+#if defined(__aarch64__) || defined(_M_ARM64)
+			return true;
+#elif defined(__arm__) && defined(__linux__)
+			return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+			return false;
+#endif
+		}
+	} // namespace
+
+	VramBlitter::VramBlitter(bool upright, uint8_t colour, PixelFormat pixelFormat, const std::string& kernel)
+		: upright_{ upright },
+		pixelFormat_{ pixelFormat },
+		colour_{ colour }
+	{
+		auto kernels = AvailableKernels();
+
+		if (kernel == "auto")
+		{
+			kernel_ = kernels.back();
+		}
+		else
+		{
+			auto it = std::find_if(kernels.begin(), kernels.end(), [&kernel](const Kernel& k) { return kernel == k.name; });
+
+			if (it == kernels.end())
+			{
+				throw std::invalid_argument("The blit kernel is unknown or not supported by this CPU");
+			}
+
+			kernel_ = *it;
+		}
+	}
+
+	int VramBlitter::Width() const
+	{
+		return static_cast<int>(upright_ == true ? vramRows_ : vramRowBytes_ * 8);
+	}
+
+	int VramBlitter::Height() const
+	{
+		return static_cast<int>(upright_ == true ? vramRowBytes_ * 8 : vramRows_);
+	}
+
+	int VramBlitter::BytesPerPixel() const
+	{
+		return pixelFormat_ == PixelFormat::RGB332 ? 1 : 4;
+	}
+
+	const char* VramBlitter::KernelName() const
+	{
+		return kernel_.name;
+	}
+
+	VramBlitter::Region VramBlitter::GetRegion(size_t firstRow, size_t lastRow) const
+	{
+		if (upright_ == true)
+		{
+			// Video ram rows are rotated in groups of 8, a row becomes a column
+			auto firstGroup = static_cast<int>(firstRow / 8);
+			auto lastGroup = static_cast<int>(lastRow / 8);
+			return { firstGroup * 8, 0, (lastGroup - firstGroup + 1) * 8, Height() };
+		}
+
+		return { 0, static_cast<int>(firstRow), Width(), static_cast<int>(lastRow - firstRow + 1) };
+	}
+
+	void VramBlitter::Blit(const uint8_t* vram, const Region& region, uint8_t* dst, int pitch)
+	{
+		const uint8_t* rows = vram;
+		size_t rowBytes = vramRowBytes_;
+		size_t rowOffset = 0;
+		auto bytes = static_cast<size_t>(region.w / 8);
+
+		if (upright_ == true)
+		{
+			auto firstGroup = static_cast<size_t>(region.x / 8);
+			auto lastGroup = firstGroup + bytes;
+			rowBytes = vramRows_ / 8;
+
+			// Transpose each 8x8 block of bits: 8 video ram rows by 8 bits of one byte in each row.
+			// Output row y takes bit (255 - y) of each video ram row, output column x is video ram row x.
+			for (auto group = firstGroup; group < lastGroup; group++)
+			{
+				const auto block = vram + group * 8 * vramRowBytes_;
+
+				for (size_t byte = 0; byte < vramRowBytes_; byte++)
+				{
+					uint64_t x = 0;
+
+					for (size_t row = 0; row < 8; row++)
+					{
+						x |= uint64_t{block[row * vramRowBytes_ + byte]} << (row * 8);
+					}
+
+					x = Transpose8x8(x);
+
+					for (size_t bit = 0; bit < 8; bit++)
+					{
+						auto y = vramRowBytes_ * 8 - 1 - (byte * 8 + bit);
+						packedRows_[y * rowBytes + group] = static_cast<uint8_t>(x >> (bit * 8));
+					}
+				}
+			}
+
+			rows = packedRows_.data();
+			rowOffset = firstGroup;
+		}
+
+		for (int y = 0; y < region.h; y++)
+		{
+			auto bits = rows + (region.y + y) * rowBytes + rowOffset;
+			auto line = dst + y * pitch;
+
+			if (pixelFormat_ == PixelFormat::RGB332)
+			{
+				kernel_.expand8(bits, bytes, line, colour_);
+			}
+			else
+			{
+				kernel_.expand32(bits, bytes, reinterpret_cast<uint32_t*>(line), ToArgb8888(colour_), 0xFF000000);
+			}
+		}
+	}
+
+	std::optional<uint8_t> VramBlitter::ParseColour(const std::string& colour)
+	{
+		if (colour == "white")
+		{
+			return 0xFF;
+		}
+		else if (colour == "red")
+		{
+			return 0xE0;
+		}
+		else if (colour == "green")
+		{
+			return 0x1C;
+		}
+		else if (colour == "blue")
+		{
+			return 0x03;
+		}
+
+		try
+		{
+			size_t pos = 0;
+			auto value = std::stoul(colour, &pos, 16);
+
+			if (pos == colour.size() && value <= 0xFF)
+			{
+				return static_cast<uint8_t>(value);
+			}
+		}
+		catch (const std::exception&)
+		{
+			// Not a hex value, "random" for example
+		}
+
+		return std::nullopt;
+	}
+
+	std::vector<VramBlitter::Kernel> VramBlitter::AvailableKernels()
+	{
+		std::vector<Kernel> kernels{ { "scalar", Expand8Scalar, Expand32Scalar } };
+
+		if (auto sse2 = Sse2Kernel(); sse2.has_value() == true)
+		{
+			kernels.push_back(*sse2);
+		}
+
+		if (auto avx2 = Avx2Kernel(); avx2.has_value() == true && CpuSupportsAvx2() == true)
+		{
+			kernels.push_back(*avx2);
+		}
+
+		if (auto neon = NeonKernel(); neon.has_value() == true && CpuSupportsNeon() == true)
+		{
+			kernels.push_back(*neon);
+		}
+
+		return kernels;
+	}
+} // namespace i8080_arcade
@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "i8080_arcade/VramBlitter.h"
+
+// Only the kernel functions are compiled with AVX2 code generation enabled, rather than the whole translation
+// unit, so that no inline function shared with the other translation units is emitted with AVX2 instructions.
+// The kernel must only be called after checking that the CPU supports AVX2. MSVC accepts the AVX2 intrinsics
+// without enabling AVX2 code generation.
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		TARGET_AVX2 void Expand8Avx2(const uint8_t* bits, size_t bytes, uint8_t* dst, uint8_t colour)
+		{
+			const auto bitMask = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201));
+			// Byte n of the 4 broadcast bytes fills lanes 8n to 8n + 7
+			const auto spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+				2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+			const auto colours = _mm256_set1_epi8(static_cast<char>(colour));
+			size_t i = 0;
+
+			for (; i + 4 <= bytes; i += 4)
+			{
+				int32_t word = 0;
+				std::memcpy(&word, bits + i, sizeof(word));
+				auto v = _mm256_shuffle_epi8(_mm256_set1_epi32(word), spread);
+				auto mask = _mm256_cmpeq_epi8(_mm256_and_si256(v, bitMask), bitMask);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 8), _mm256_and_si256(mask, colours));
+			}
+
+			for (; i < bytes; i++)
+			{
+				for (size_t bit = 0; bit < 8; bit++)
+				{
+					dst[i * 8 + bit] = (bits[i] >> bit) & 0x01 ? colour : 0;
+				}
+			}
+		}
+
+		TARGET_AVX2 void Expand32Avx2(const uint8_t* bits, size_t bytes, uint32_t* dst, uint32_t colour, uint32_t background)
+		{
+			const auto bitMask = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+			const auto colours = _mm256_set1_epi32(static_cast<int>(colour));
+			const auto backgrounds = _mm256_set1_epi32(static_cast<int>(background));
+
+			for (size_t i = 0; i < bytes; i++)
+			{
+				auto v = _mm256_set1_epi32(bits[i]);
+				auto mask = _mm256_cmpeq_epi32(_mm256_and_si256(v, bitMask), bitMask);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 8), _mm256_blendv_epi8(backgrounds, colours, mask));
+			}
+		}
+	} // namespace
+
+	std::optional<VramBlitter::Kernel> Avx2Kernel()
+	{
+		return VramBlitter::Kernel{ "avx2", Expand8Avx2, Expand32Avx2 };
+	}
+} // namespace i8080_arcade
+#else
+namespace i8080_arcade
+{
+	std::optional<VramBlitter::Kernel> Avx2Kernel()
+	{
+		return std::nullopt;
+	}
+} // namespace i8080_arcade
+#endif
@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "i8080_arcade/VramBlitter.h"
+
+// On armv7 this translation unit is compiled with NEON code generation enabled, its kernel
+// must only be called after checking that the CPU supports NEON.
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		void Expand8Neon(const uint8_t* bits, size_t bytes, uint8_t* dst, uint8_t colour)
+		{
+			const uint8_t bitValues[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+			const auto bitMask = vld1q_u8(bitValues);
+			const auto colours = vdupq_n_u8(colour);
+			size_t i = 0;
+
+			for (; i + 2 <= bytes; i += 2)
+			{
+				auto v = vcombine_u8(vdup_n_u8(bits[i]), vdup_n_u8(bits[i + 1]));
+				vst1q_u8(dst + i * 8, vandq_u8(vtstq_u8(v, bitMask), colours));
+			}
+
+			for (; i < bytes; i++)
+			{
+				for (size_t bit = 0; bit < 8; bit++)
+				{
+					dst[i * 8 + bit] = (bits[i] >> bit) & 0x01 ? colour : 0;
+				}
+			}
+		}
+
+		void Expand32Neon(const uint8_t* bits, size_t bytes, uint32_t* dst, uint32_t colour, uint32_t background)
+		{
+			const uint32_t loValues[4] = { 1, 2, 4, 8 };
+			const uint32_t hiValues[4] = { 16, 32, 64, 128 };
+			const auto loMask = vld1q_u32(loValues);
+			const auto hiMask = vld1q_u32(hiValues);
+			const auto colours = vdupq_n_u32(colour);
+			const auto backgrounds = vdupq_n_u32(background);
+
+			for (size_t i = 0; i < bytes; i++)
+			{
+				auto v = vdupq_n_u32(bits[i]);
+				vst1q_u32(dst + i * 8, vbslq_u32(vtstq_u32(v, loMask), colours, backgrounds));
+				vst1q_u32(dst + i * 8 + 4, vbslq_u32(vtstq_u32(v, hiMask), colours, backgrounds));
+			}
+		}
+	} // namespace
+
+	std::optional<VramBlitter::Kernel> NeonKernel()
+	{
+		return VramBlitter::Kernel{ "neon", Expand8Neon, Expand32Neon };
+	}
+} // namespace i8080_arcade
+#else
+namespace i8080_arcade
+{
+	std::optional<VramBlitter::Kernel> NeonKernel()
+	{
+		return std::nullopt;
+	}
+} // namespace i8080_arcade
+#endif
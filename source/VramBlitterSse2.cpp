@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "i8080_arcade/VramBlitter.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+
+namespace i8080_arcade
+{
+	namespace
+	{
+		// Broadcast two bytes so that byte 0 fills lanes 0 - 7 and byte 1 fills lanes 8 - 15
+		// and return a mask with the lane set to 0xFF when its bit is set
+		__m128i ExpandMask(const uint8_t* bits)
+		{
+			const auto bitMask = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+			auto v = _mm_cvtsi32_si128(bits[0] | (bits[1] << 8));
+			v = _mm_unpacklo_epi8(v, v);
+			v = _mm_unpacklo_epi16(v, v);
+			v = _mm_unpacklo_epi32(v, v);
+			return _mm_cmpeq_epi8(_mm_and_si128(v, bitMask), bitMask);
+		}
+
+		void Expand8Sse2(const uint8_t* bits, size_t bytes, uint8_t* dst, uint8_t colour)
+		{
+			const auto colours = _mm_set1_epi8(static_cast<char>(colour));
+			size_t i = 0;
+
+			for (; i + 2 <= bytes; i += 2)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 8), _mm_and_si128(ExpandMask(bits + i), colours));
+			}
+
+			for (; i < bytes; i++)
+			{
+				for (size_t bit = 0; bit < 8; bit++)
+				{
+					dst[i * 8 + bit] = (bits[i] >> bit) & 0x01 ? colour : 0;
+				}
+			}
+		}
+
+		void Expand32Sse2(const uint8_t* bits, size_t bytes, uint32_t* dst, uint32_t colour, uint32_t background)
+		{
+			const auto colours = _mm_set1_epi32(static_cast<int>(colour));
+			const auto backgrounds = _mm_set1_epi32(static_cast<int>(background));
+			size_t i = 0;
+
+			auto store = [&](__m128i mask, uint32_t* out)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(_mm_and_si128(mask, colours), _mm_andnot_si128(mask, backgrounds)));
+			};
+
+			for (; i + 2 <= bytes; i += 2)
+			{
+				// Widen the 16 byte lane masks into 4 sets of 4 dword lane masks
+				auto mask = ExpandMask(bits + i);
+				auto lo = _mm_unpacklo_epi8(mask, mask);
+				auto hi = _mm_unpackhi_epi8(mask, mask);
+				auto out = dst + i * 8;
+				store(_mm_unpacklo_epi16(lo, lo), out);
+				store(_mm_unpackhi_epi16(lo, lo), out + 4);
+				store(_mm_unpacklo_epi16(hi, hi), out + 8);
+				store(_mm_unpackhi_epi16(hi, hi), out + 12);
+			}
+
+			for (; i < bytes; i++)
+			{
+				for (size_t bit = 0; bit < 8; bit++)
+				{
+					dst[i * 8 + bit] = (bits[i] >> bit) & 0x01 ? colour : background;
+				}
+			}
+		}
+	} // namespace
+
+	std::optional<VramBlitter::Kernel> Sse2Kernel()
+	{
+		return VramBlitter::Kernel{ "sse2", Expand8Sse2, Expand32Sse2 };
+	}
+} // namespace i8080_arcade
+#else
+namespace i8080_arcade
+{
+	std::optional<VramBlitter::Kernel> Sse2Kernel()
+	{
+		return std::nullopt;
+	}
+} // namespace i8080_arcade
+#endif
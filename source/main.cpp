@@ -20,21 +20,94 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <popl.hpp>
+#include <vector>
 
 #include "Machine/MachineFactory.h"
+#include "i8080_arcade/ArcadeConfig.h"
+#include "i8080_arcade/FrameTiming.h"
+#include "i8080_arcade/HeadlessIoController.h"
+#include "i8080_arcade/InputLog.h"
+#include "i8080_arcade/MappedMemoryController.h"
+#include "i8080_arcade/MidwayPorts.h"
+#include "i8080_arcade/RegressionGate.h"
+#include "i8080_arcade/RomPack.h"
+#include "i8080_arcade/SaveState.h"
 #include "i8080_arcade/SdlIoController.h"
+#include "i8080_arcade/Tracer.h"
+#include "i8080_arcade/VideoRecorder.h"
 
 using namespace popl;
 
 static std::filesystem::path configFile;
 static std::filesystem::path romFilePath;
 static std::filesystem::path audioFilePath;
+static std::filesystem::path audioCachePath;
 static std::filesystem::path saveFilePath;
 static std::string gameRom;
+static bool headless{};
+static uint64_t headlessFrames{};
+static double speed{};
+static double fastForwardSpeed{};
+static i8080_arcade::SaveState::Compression saveCompression{};
+static std::filesystem::path convertSaveFile;
+static std::filesystem::path recordInputFile;
+static std::filesystem::path replayFile;
+static std::filesystem::path recordVideoFile;
+static bool packRoms{};
+static bool bootReport{};
+static bool gate{};
+static bool gateUpdate{};
+static std::filesystem::path gateGoldenFile;
+static std::filesystem::path gateBaselineFile;
+static double gateThreshold{};
+static std::filesystem::path memoryProfileFile;
+static uint32_t memoryProfileInterval{};
+static bool verifyPorts{};
+static std::filesystem::path traceFile;
+
+enum class BootPhase
+{
+	Config,
+	Machine,
+	Roms,
+	Sdl,
+	Audio,
+	Video,
+	Count
+};
+
+static int64_t bootTime{};
+// The start and end of each phase, written by the thread that runs it and read once the phases have completed
+static std::array<std::array<int64_t, 2>, static_cast<size_t>(BootPhase::Count)> bootPhaseTimes{};
+
+template<typename PhaseFunc>
+auto TimeBootPhase(BootPhase phase, PhaseFunc&& phaseFunc)
+{
+	struct PhaseTimer
+	{
+		std::array<int64_t, 2>& times;
+
+		explicit PhaseTimer(std::array<int64_t, 2>& phaseTimes)
+			: times{ phaseTimes }
+		{
+			times[0] = i8080_arcade::FrameTiming::Now();
+		}
+
+		~PhaseTimer()
+		{
+			times[1] = i8080_arcade::FrameTiming::Now();
+		}
+	} phaseTimer{ bootPhaseTimes[static_cast<size_t>(phase)] };
+
+	return phaseFunc();
+}
 
 int ParseCmdLine(int argc, char** argv)
 {
@@ -43,8 +116,29 @@ int ParseCmdLine(int argc, char** argv)
 	auto configFileOpt = op.add<Value<std::string>>("c", "config-file", "i8080 arcade configuration file", "conf/config.json");
 	auto romFilePathOpt = op.add<Value<std::string>>("r", "rom-file-path", "Path to the i8080 arcade rom files directory", "rom-files");
 	auto audioFilePathOpt = op.add<Value<std::string>>("a", "audio-file-path", "Path to the i8080 arcade audio files directory", "audio-files");
+	auto audioCachePathOpt = op.add<Value<std::string>>("", "audio-cache-path", "Path to a directory to cache the audio samples converted to the output format in");
 	auto saveFilePathOpt = op.add<Value<std::string>>("s", "save-file-path", "Path to the i8080 arcade save files directory", "save-files");
 	auto gameRomOpt = op.add<Value<std::string>>("g", "game", "The name of the i8080 arcade game to load as defined in the config file", "space-invaders");
+	auto headlessOpt = op.add<Switch>("", "headless", "Run the machine as fast as possible without a window or audio and report the throughput");
+	auto headlessFramesOpt = op.add<Value<uint64_t>>("", "frames", "The number of video frames to run for when running headless", 3600);
+	auto speedOpt = op.add<Value<double>>("", "speed", "The real time multiplier to run the machine at, 0 runs it as fast as possible", 1.0);
+	auto fastForwardSpeedOpt = op.add<Value<double>>("", "fast-forward", "The real time multiplier to run the machine at while the tab key is held, 0 runs it as fast as possible", 4.0);
+	auto saveCompressionOpt = op.add<Value<std::string>>("", "save-compression", "The compression applied to save files, none or lz", "lz");
+	auto convertSaveFileOpt = op.add<Value<std::string>>("", "convert-save", "Convert a .json save file to a binary .sav file or a .sav file to .json, then exit");
+	auto recordInputFileOpt = op.add<Value<std::string>>("", "record-input", "Record the inputs latched at each frame to this input log file");
+	auto replayFileOpt = op.add<Value<std::string>>("", "replay", "Replay the inputs from this input log file, then exit");
+	auto recordVideoFileOpt = op.add<Value<std::string>>("", "record-video", "Record every frame to this lossless .y4m video file");
+	auto packRomsOpt = op.add<Switch>("", "pack-roms", "Pack the rom files of the game into a single verified rom pack in the rom file path, then exit");
+	auto bootReportOpt = op.add<Switch>("", "boot-report", "Print the wall time of each start up phase once the first frame is presented");
+	auto gateOpt = op.add<Switch>("", "gate", "Run every game headless in parallel with scripted inputs for --frames frames, compare them against the golden hashes and throughput baseline, then exit");
+	auto gateUpdateOpt = op.add<Switch>("", "gate-update", "With --gate, record the runs as the new golden hashes and throughput baseline instead of comparing them");
+	auto gateGoldenFileOpt = op.add<Value<std::string>>("", "gate-golden", "The golden frame hashes file of the gate", "conf/gate-golden.json");
+	auto gateBaselineFileOpt = op.add<Value<std::string>>("", "gate-baseline", "The throughput baseline file of the gate for this host", "gate-baseline.json");
+	auto gateThresholdOpt = op.add<Value<double>>("", "gate-threshold", "The fraction of the baseline throughput a game may lose before the gate fails", 0.1);
+	auto memoryProfileFileOpt = op.add<Value<std::string>>("", "memory-profile", "Save the memory access counts to this .csv or .json file on exit, needs the I8080_ARCADE_MEMORY_PROFILE build option");
+	auto memoryProfileIntervalOpt = op.add<Value<uint32_t>>("", "memory-profile-interval", "Count one memory access in this many", 1);
+	auto traceFileOpt = op.add<Value<std::string>>("", "trace", "Record the activity of the machine, event loop and audio threads to this Chrome trace .json file");
+	auto verifyPortsOpt = op.add<Switch>("", "verify-ports", "Compare the inline port map against the meen_hw port map with a random sequence of port reads and writes, then exit");
 	op.parse(argc, argv);
 	auto helpCount = helpOpt->count();
 
@@ -78,11 +172,482 @@ int ParseCmdLine(int argc, char** argv)
 	audioFilePath = audioFilePathOpt->value();
 	saveFilePath = saveFilePathOpt->value();
 	gameRom = gameRomOpt->value();
+	headless = headlessOpt->is_set();
+	packRoms = packRomsOpt->is_set();
+	bootReport = bootReportOpt->is_set();
+	gate = gateOpt->is_set();
+	gateUpdate = gateUpdateOpt->is_set();
+	gateGoldenFile = gateGoldenFileOpt->value();
+	gateBaselineFile = gateBaselineFileOpt->value();
+	gateThreshold = gateThresholdOpt->value();
+	memoryProfileInterval = memoryProfileIntervalOpt->value();
+	verifyPorts = verifyPortsOpt->is_set();
+
+	if (memoryProfileFileOpt->is_set() == true)
+	{
+		memoryProfileFile = memoryProfileFileOpt->value();
+	}
+	headlessFrames = headlessFramesOpt->value();
+	speed = speedOpt->value();
+	fastForwardSpeed = fastForwardSpeedOpt->value();
+	saveCompression = i8080_arcade::SaveState::ParseCompression(saveCompressionOpt->value());
+
+	if (audioCachePathOpt->is_set() == true)
+	{
+		audioCachePath = audioCachePathOpt->value();
+	}
+
+	if (convertSaveFileOpt->is_set() == true)
+	{
+		convertSaveFile = convertSaveFileOpt->value();
+	}
+
+	if (recordInputFileOpt->is_set() == true)
+	{
+		recordInputFile = recordInputFileOpt->value();
+	}
+
+	if (replayFileOpt->is_set() == true)
+	{
+		replayFile = replayFileOpt->value();
+	}
+
+	if (recordVideoFileOpt->is_set() == true)
+	{
+		recordVideoFile = recordVideoFileOpt->value();
+	}
+
+	if (traceFileOpt->is_set() == true)
+	{
+		traceFile = traceFileOpt->value();
+	}
+
+	if (headlessFrames == 0)
+	{
+		throw std::invalid_argument("The number of headless frames must be greater than zero");
+	}
+
+	if (recordInputFile.empty() == false && (replayFile.empty() == false || headless == true))
+	{
+		throw std::invalid_argument("Inputs can only be recorded from a windowed run which is not a replay");
+	}
+
+	return 0;
+}
+
+int ConvertSave()
+{
+	auto outFile = convertSaveFile;
+
+	if (convertSaveFile.extension() == ".sav")
+	{
+		i8080_arcade::SaveState saveState(convertSaveFile);
+		outFile.replace_extension(".json");
+		std::ofstream fout(outFile, std::ios::trunc);
+		fout.exceptions(fout.failbit);
+		fout << saveState.MachineJson();
+	}
+	else
+	{
+		std::ifstream fin(convertSaveFile);
+		fin.exceptions(fin.failbit);
+		std::string json((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+		outFile.replace_extension(".sav");
+		i8080_arcade::SaveState::Save(outFile, json, saveCompression);
+	}
+
+	printf("Converted %s to %s\n", convertSaveFile.string().c_str(), outFile.string().c_str());
+	return 0;
+}
+
+int PackRoms(const i8080_arcade::ArcadeConfig& config)
+{
+	auto romPackFile = i8080_arcade::RomPack::Path(romFilePath, gameRom);
+	i8080_arcade::RomPack::Pack(romFilePath, gameRom, config.memory["rom"]["file"], romPackFile);
+	// Read the pack back so that a pack which doesn't verify is reported now rather than at boot
+	i8080_arcade::RomPack romPack(romPackFile);
+
+	for (const auto& rom : romPack.Roms())
+	{
+		printf("%s: offset 0x%04X size %zu crc32 %08x sha1 ", rom.name.c_str(), rom.offset, rom.data.size(), rom.crc32);
+
+		for (auto byte : rom.sha1)
+		{
+			printf("%02x", byte);
+		}
+
+		printf("\n");
+	}
+
+	printf("Packed %s\n", romPackFile.string().c_str());
+	return 0;
+}
+
+void LoadRoms(i8080_arcade::MemoryController& memoryController, const i8080_arcade::ArcadeConfig& config)
+{
+	auto romPackFile = i8080_arcade::RomPack::Path(romFilePath, config.game);
+
+	// Prefer the rom pack, it is verified as it is loaded
+	if (std::filesystem::exists(romPackFile) == true)
+	{
+		i8080_arcade::RomPack romPack(romPackFile);
+
+		romPack.CheckConfig(config.game, config.memory["rom"]["file"]);
+
+		memoryController.LoadRoms(romPack);
+	}
+	else
+	{
+		memoryController.LoadRoms(romFilePath, config.memory["rom"]["file"]);
+	}
+}
+
+bool RomsPresent(const i8080_arcade::ArcadeConfig& config)
+{
+	if (std::filesystem::exists(i8080_arcade::RomPack::Path(romFilePath, config.game)) == true)
+	{
+		return true;
+	}
+
+	const auto& roms = config.memory["rom"]["file"];
+	return std::all_of(roms.begin(), roms.end(), [](const nlohmann::json& rom) { return std::filesystem::exists(romFilePath / rom["name"].get<std::string>()); });
+}
+
+void PrintBootReport()
+{
+	static constexpr std::array<const char*, static_cast<size_t>(BootPhase::Count)> phaseNames{ "config", "machine", "roms", "sdl", "audio", "video" };
+	auto firstFrameTime = i8080_arcade::FrameTiming::Now();
+	int64_t phasesTime = 0;
+	int64_t lastEndTime = bootTime;
+
+	printf("%-8s %10s %10s\n", "phase", "start ms", "wall ms");
+
+	for (size_t i = 0; i < bootPhaseTimes.size(); i++)
+	{
+		auto [startTime, endTime] = bootPhaseTimes[i];
+		printf("%-8s %10.2f %10.2f\n", phaseNames[i], (startTime - bootTime) / 1e6, (endTime - startTime) / 1e6);
+		phasesTime += endTime - startTime;
+		lastEndTime = std::max(lastEndTime, endTime);
+	}
+
+	printf("Boot phases: %.2f ms of work in %.2f ms, first frame presented at %.2f ms\n", phasesTime / 1e6, (lastEndTime - bootTime) / 1e6, (firstFrameTime - bootTime) / 1e6);
+}
+
+std::shared_ptr<i8080_arcade::InputLog> MakeInputLog()
+{
+	if (replayFile.empty() == false)
+	{
+		auto inputLog = std::make_shared<i8080_arcade::InputLog>(replayFile);
+
+		if (inputLog->Frames() == 0)
+		{
+			throw std::runtime_error("The input log has no frames to replay");
+		}
+
+		return inputLog;
+	}
+	else if (recordInputFile.empty() == false)
+	{
+		return std::make_shared<i8080_arcade::InputLog>();
+	}
+
+	return nullptr;
+}
+
+void ReportReplay(uint64_t frames, uint64_t frameHash, const i8080_arcade::InputLog& inputLog)
+{
+	printf("Replayed frames: %llu of %llu\n", static_cast<unsigned long long>(frames), static_cast<unsigned long long>(inputLog.Frames()));
+	printf("Frame hash: %016llx (recorded %016llx) %s\n", static_cast<unsigned long long>(frameHash), static_cast<unsigned long long>(inputLog.RecordedFrameHash()),
+		frames == inputLog.Frames() && frameHash == inputLog.RecordedFrameHash() ? "match" : "MISMATCH");
+}
+
+std::shared_ptr<i8080_arcade::VideoRecorder> MakeVideoRecorder(const nlohmann::json& videoSoftware)
+{
+	if (recordVideoFile.empty() == true)
+	{
+		return nullptr;
+	}
+
+	return std::make_shared<i8080_arcade::VideoRecorder>(recordVideoFile, videoSoftware);
+}
+
+void ReportRecording(i8080_arcade::VideoRecorder& videoRecorder)
+{
+	auto stats = videoRecorder.Close();
+	printf("Recorded %llu video frames to %s\n", static_cast<unsigned long long>(stats.written), videoRecorder.Path().string().c_str());
+
+	if (stats.dropped > 0)
+	{
+		printf("Dropped %llu of %llu video frames, the disk could not keep up\n", static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.captured + stats.dropped));
+	}
+}
+
+std::shared_ptr<i8080_arcade::Tracer> MakeTracer()
+{
+	if (traceFile.empty() == true)
+	{
+		return nullptr;
+	}
+
+	return std::make_shared<i8080_arcade::Tracer>(traceFile);
+}
+
+void ReportTrace(i8080_arcade::Tracer& tracer)
+{
+	auto stats = tracer.Close();
+	printf("Traced %llu events to %s\n", static_cast<unsigned long long>(stats.written), tracer.Path().string().c_str());
+
+	if (stats.dropped > 0)
+	{
+		printf("Dropped %llu of %llu trace events, the disk could not keep up\n", static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.recorded + stats.dropped));
+	}
+}
+
+void ConfigureMemoryProfiler(i8080_arcade::MemoryController& memoryController)
+{
+	auto memoryProfiler = memoryController.GetMemoryProfiler();
+
+	if (memoryProfiler == nullptr)
+	{
+		if (memoryProfileFile.empty() == false)
+		{
+			throw std::invalid_argument("The memory profile needs a build with the I8080_ARCADE_MEMORY_PROFILE CMake option enabled");
+		}
+
+		return;
+	}
+
+	memoryProfiler->SetSampleInterval(memoryProfileInterval);
+}
+
+void SaveMemoryProfile(i8080_arcade::MemoryController& memoryController)
+{
+	if (memoryProfileFile.empty() == false)
+	{
+		memoryController.GetMemoryProfiler()->Save(memoryProfileFile);
+		printf("Saved the memory profile to %s\n", memoryProfileFile.string().c_str());
+	}
+}
+
+int RunHeadless(const i8080_arcade::ArcadeConfig& config)
+{
+	// The machine options don't sync the machine to real time, it runs as fast as possible
+	auto machine = MachEmu::MakeMachine(config.machineOptions.c_str());
+	auto memoryController = i8080_arcade::MakeMemoryController(config.memory);
+	auto inputLog = MakeInputLog();
+	// A replay runs for exactly the frames that were recorded
+	auto frames = inputLog != nullptr ? inputLog->Frames() : headlessFrames;
+	auto ioController = std::make_shared<i8080_arcade::HeadlessIoController>(memoryController, frames, config.videoHardware);
+	auto videoRecorder = MakeVideoRecorder(config.videoSoftware);
+
+	ioController->SetVideoOptions(config.videoSoftware);
+	ioController->SetInputLog(inputLog);
+	ioController->SetVideoRecorder(videoRecorder);
+	ConfigureMemoryProfiler(*memoryController);
+	LoadRoms(*memoryController, config);
+	machine->SetOptions(config.memoryOptions.c_str());
+	machine->SetMemoryController(memoryController);
+	machine->SetIoController(ioController);
+	machine->Run(0x00);
+	machine->WaitForCompletion();
+	SaveMemoryProfile(*memoryController);
+
+	if (videoRecorder != nullptr)
+	{
+		ReportRecording(*videoRecorder);
+	}
+
+	auto stats = ioController->GetStatistics();
+	auto wallSeconds = stats.wallTime / 1e9;
+
+	if (wallSeconds <= 0)
+	{
+		printf("The machine did not complete any frames\n");
+		return 0;
+	}
+
+	printf("Frames: %llu\n", static_cast<unsigned long long>(stats.frames));
+	printf("Cycles: %llu\n", static_cast<unsigned long long>(stats.cycles));
+	printf("Wall time: %.3f s\n", wallSeconds);
+	printf("Emulated cycles/sec: %.0f\n", stats.cycles / wallSeconds);
+	printf("Frames/sec: %.2f\n", stats.frames / wallSeconds);
+	printf("Speed-up over real time: %.2fx\n", stats.emulatedTime / 1e9 / wallSeconds);
+
+	if (inputLog != nullptr)
+	{
+		ReportReplay(stats.frames, stats.frameHash, *inputLog);
+	}
+	else
+	{
+		printf("Frame hash: %016llx\n", static_cast<unsigned long long>(stats.frameHash));
+	}
+
+	return 0;
+}
+
+i8080_arcade::RegressionGate::Run RunGateGame(const i8080_arcade::ArcadeConfig& config)
+{
+	auto machine = MachEmu::MakeMachine(config.machineOptions.c_str());
+	auto memoryController = i8080_arcade::MakeMemoryController(config.memory);
+	auto ioController = std::make_shared<i8080_arcade::HeadlessIoController>(memoryController, headlessFrames, config.videoHardware);
+
+	ioController->SetVideoOptions(config.videoSoftware);
+	ioController->SetInputScript(i8080_arcade::RegressionGate::ScriptedInputs);
+	ioController->SetCheckpointInterval(i8080_arcade::RegressionGate::checkpointInterval_);
+	LoadRoms(*memoryController, config);
+	machine->SetOptions(config.memoryOptions.c_str());
+	machine->SetMemoryController(memoryController);
+	machine->SetIoController(ioController);
+	machine->Run(0x00);
+	machine->WaitForCompletion();
+
+	auto stats = ioController->GetStatistics();
+	return { config.game, stats.frames, stats.cycles, stats.wallTime, ioController->GetCheckpoints() };
+}
+
+int RunGate()
+{
+	std::vector<std::string> games;
+	std::vector<std::future<i8080_arcade::RegressionGate::Run>> tasks;
+	std::vector<i8080_arcade::RegressionGate::Run> runs;
+	auto failed = false;
+
+	// Each game runs its own machine on its own thread, the config is loaded per game as each one only needs its own sections
+	for (const auto& game : i8080_arcade::ArcadeConfig::Games(configFile))
+	{
+		auto config = i8080_arcade::ArcadeConfig::Load(configFile, game);
+
+		// Only some rom sets may be available, the games without them are left out rather than failed
+		if (RomsPresent(config) == false)
+		{
+			printf("%s: skipped, its rom files are not in %s\n", game.c_str(), romFilePath.string().c_str());
+			continue;
+		}
+
+		games.push_back(game);
+		tasks.push_back(std::async(std::launch::async, RunGateGame, std::move(config)));
+	}
+
+	for (size_t i = 0; i < tasks.size(); i++)
+	{
+		try
+		{
+			runs.push_back(tasks[i].get());
+			runs.back().concurrency = tasks.size();
+		}
+		catch (const std::exception& e)
+		{
+			printf("%s: %s\n", games[i].c_str(), e.what());
+			failed = true;
+		}
+	}
+
+	if (gateUpdate == true)
+	{
+		// A partial update would leave the failed games with entries from an older build
+		if (failed == true)
+		{
+			printf("Not updating %s and %s, %zu of %zu games failed to run\n", gateGoldenFile.string().c_str(), gateBaselineFile.string().c_str(), tasks.size() - runs.size(), tasks.size());
+			return 1;
+		}
+
+		i8080_arcade::RegressionGate::Update(runs, gateGoldenFile, gateBaselineFile);
+		printf("Updated %zu games in %s and %s\n", runs.size(), gateGoldenFile.string().c_str(), gateBaselineFile.string().c_str());
+		return 0;
+	}
+
+	i8080_arcade::RegressionGate regressionGate(gateGoldenFile, gateBaselineFile, gateThreshold);
+	size_t noGolden = 0;
+	printf("%-24s %14s %14s %8s %s\n", "game", "Mcycles/sec", "baseline", "change", "hashes");
+
+	for (const auto& run : runs)
+	{
+		auto verdict = regressionGate.Check(run);
+		char hashes[64];
+		char change[16] = "-";
+		char baseline[16] = "-";
+
+		if (verdict.hasGolden == false)
+		{
+			snprintf(hashes, sizeof(hashes), "no golden hashes");
+		}
+		else if (verdict.firstMismatchFrame >= 0)
+		{
+			snprintf(hashes, sizeof(hashes), "MISMATCH by frame %lld", static_cast<long long>(verdict.firstMismatchFrame));
+		}
+		else
+		{
+			snprintf(hashes, sizeof(hashes), "match");
+		}
+
+		if (verdict.baselineCyclesPerSecond > 0)
+		{
+			snprintf(baseline, sizeof(baseline), "%.2f", verdict.baselineCyclesPerSecond / 1e6);
+			snprintf(change, sizeof(change), "%+.1f%%", (verdict.cyclesPerSecond / verdict.baselineCyclesPerSecond - 1) * 100);
+		}
+
+		printf("%-24s %14.2f %14s %8s %s%s\n", run.game.c_str(), verdict.cyclesPerSecond / 1e6, baseline, change, hashes, verdict.regressed == true ? ", REGRESSED" : "");
+
+		if (verdict.baselineConcurrency != run.concurrency && verdict.baselineConcurrency > 0)
+		{
+			printf("%-24s the baseline was recorded with %zu games running at the same time, not %zu, the throughput was not compared\n", "", verdict.baselineConcurrency, run.concurrency);
+		}
+		if (verdict.hasGolden == false)
+		{
+			// Nothing to compare the hashes with, only the throughput can fail
+			noGolden++;
+			failed |= verdict.regressed;
+		}
+		else
+		{
+			failed |= verdict.Passed() == false;
+		}
+	}
+
+	if (failed == false && (noGolden > 0 || runs.empty() == true))
+	{
+		if (runs.empty() == true)
+		{
+			printf("Gate skipped, none of the games' rom files are in %s\n", romFilePath.string().c_str());
+		}
+		else
+		{
+			printf("Gate skipped, %zu of %zu games have no golden checkpoints, record them with --gate-update\n", noGolden, runs.size());
+		}
+
+		return i8080_arcade::RegressionGate::skippedExitCode_;
+	}
+
+	printf("Gate %s\n", failed == true ? "FAILED" : "passed");
+	return failed == true ? 1 : 0;
+}
+
+int VerifyPorts()
+{
+	constexpr uint64_t operations = 1 << 20;
+	auto i8080ArcadeIO = meen_hw::MakeI8080ArcadeIO();
+
+	if (i8080ArcadeIO == nullptr)
+	{
+		throw std::runtime_error("Failed to create i8080 arcade hardware");
+	}
+
+	auto mismatch = i8080_arcade::VerifyPorts<i8080_arcade::MidwayPorts<>>(*i8080ArcadeIO, operations);
+
+	if (mismatch.has_value() == true)
+	{
+		printf("The inline port map differs from meen_hw at %s\n", mismatch->c_str());
+		return 1;
+	}
+
+	printf("The inline port map matches meen_hw for %llu port reads and writes\n", static_cast<unsigned long long>(operations));
 	return 0;
 }
 
 int main(int argc, char** argv)
 {
+	bootTime = i8080_arcade::FrameTiming::Now();
+
 	try
 	{
 		if (ParseCmdLine(argc, argv) < 0)
@@ -91,50 +656,117 @@ int main(int argc, char** argv)
 			return 0;
 		}
 
-		// Open the configuration file, see the README for an explanation of each configuration option
-		std::ifstream fin(configFile);
-		const auto config = nlohmann::json::parse(fin);
-		auto software = config["i8080-arcade"]["software"];
+		if (convertSaveFile.empty() == false)
+		{
+			return ConvertSave();
+		}
 
-		if(software.contains(gameRom) == false)
+		if (gate == true)
 		{
-			std::cout << "The game " << gameRom << " does not exist in the software section of the config file" << std::endl;			
-			return 0;
+			return RunGate();
+		}
+
+		if (verifyPorts == true)
+		{
+			return VerifyPorts();
 		}
 
-		auto hardware = config["i8080-arcade"]["hardware"];
-		// Create our custom i8080 arcade machine
-		auto machine = MachEmu::MakeMachine(hardware["mach-emu"].dump().c_str());
-		// Create our custom i8080 arcade memory controller.
-		auto memoryController = std::make_shared<i8080_arcade::MemoryController>();
+		// Parse the configuration file once, see the README for an explanation of each configuration option
+		const auto config = TimeBootPhase(BootPhase::Config, [] { return i8080_arcade::ArcadeConfig::Load(configFile, gameRom); });
+
+		if (packRoms == true)
+		{
+			return PackRoms(config);
+		}
+
+		if (headless == true)
+		{
+			return RunHeadless(config);
+		}
+
+		// Create our custom i8080 arcade memory controller for the game's memory layout, allow for one frame being rendered while the frame queue is full.
+		auto memoryController = i8080_arcade::MakeMemoryController(config.memory, config.frameQueueDepth + 1);
+		ConfigureMemoryProfiler(*memoryController);
+		// The machine and the roms don't depend on SDL, they are made and loaded while SDL and the window are initialised.
+		// The machine options leave the clock unsynchronised, the io controller paces the machine so that its speed can be changed while it is running.
+		auto machineTask = std::async(std::launch::async, [&config] { return TimeBootPhase(BootPhase::Machine, [&config] { return MachEmu::MakeMachine(config.machineOptions.c_str()); }); });
+		auto romTask = std::async(std::launch::async, [&memoryController, &config] { TimeBootPhase(BootPhase::Roms, [&memoryController, &config] { LoadRoms(*memoryController, config); }); });
 		// Create our custom i8080 arcade I/O controller based on a specific configuration.
-		auto ioController = std::make_shared<i8080_arcade::SdlIoController>(memoryController, hardware["audio"], hardware["video"]);
-		auto arcadeGame = software[gameRom];
+		auto ioController = TimeBootPhase(BootPhase::Sdl, [&memoryController, &config]
+		{
+			return std::make_shared<i8080_arcade::SdlIoController>(memoryController, config.audioHardware, config.videoHardware, config.inputHardware, config.rewindHardware);
+		});
+
+		ioController->SetSpeed(speed, fastForwardSpeed);
+		auto inputLog = MakeInputLog();
+
+		if (inputLog != nullptr)
+		{
+			ioController->SetInputLog(inputLog);
+		}
+
+		auto videoRecorder = MakeVideoRecorder(config.videoSoftware);
+		ioController->SetVideoRecorder(videoRecorder);
+		auto tracer = MakeTracer();
+		ioController->SetTracer(tracer);
+
+		// The textures are created on this thread which owns the renderer, the audio samples are decoded alongside them
+		auto audioTask = std::async(std::launch::async, [&ioController, &config]
+		{
+			TimeBootPhase(BootPhase::Audio, [&ioController, &config] { ioController->LoadAudioSamples(audioFilePath, config.audioSoftware, audioCachePath); });
+		});
 
-		ioController->LoadAudioSamples(audioFilePath, software["audio"]);
-		ioController->LoadVideoTextures(software["video"]);
-		memoryController->LoadRoms(romFilePath, arcadeGame["memory"]["rom"]["file"]);
+		TimeBootPhase(BootPhase::Video, [&ioController, &config] { ioController->LoadVideoTextures(config.videoSoftware); });
+		audioTask.get();
+		romTask.get();
+		auto machine = machineTask.get();
+
+		if (bootReport == true)
+		{
+			ioController->OnFirstFrame(PrintBootReport);
+		}
 
 		// Load the memory layout into the machine
-		machine->SetOptions(arcadeGame["memory"].dump().c_str());
+		machine->SetOptions(config.memoryOptions.c_str());
 		// Load our controllers into the machine.
 		machine->SetMemoryController(memoryController);
 		machine->SetIoController(ioController);
-		// Will be called from a different thread, this is a simple implementation which will overwrite the previous save file
-		machine->OnSave([](const char* json)
+		// Will be called from a different thread, the save file is replaced in full so a failed save never corrupts the previous one
+		machine->OnSave([&ioController, &tracer](const char* json)
 		{
-			// Need to make a copy of the json if you want to hold the json string longer than the scope of this function
+			i8080_arcade::Tracer::Scope scope(tracer.get(), i8080_arcade::Tracer::Event::Save);
+
+			// Per frame rewind snapshots are kept in memory
+			if (ioController->SaveRewindSnapshot(json) == true)
+			{
+				return;
+			}
+
 			std::filesystem::create_directory(saveFilePath);
-			std::ofstream fout((saveFilePath/gameRom).string() + ".json", std::ios::trunc);
-			fout.exceptions(fout.failbit);
-			fout.write(json, strlen(json));
+			i8080_arcade::SaveState::Save((saveFilePath/gameRom).string() + ".sav", json, saveCompression);
 		});
 
-		// Will be accessed from a different thread
+		// Will be accessed from a different thread, holds the json the machine loads from
 		std::string loadJson;
 		// Will be called from a different thread
-		machine->OnLoad([&loadJson]
+		machine->OnLoad([&ioController, &tracer, &loadJson]
 		{
+			i8080_arcade::Tracer::Scope scope(tracer.get(), i8080_arcade::Tracer::Event::Load);
+
+			if (auto snapshot = ioController->LoadRewindSnapshot(); snapshot != nullptr)
+			{
+				return snapshot;
+			}
+
+			std::filesystem::path savFile = (saveFilePath/gameRom).string() + ".sav";
+
+			if (std::filesystem::exists(savFile) == true)
+			{
+				// Copied so that the file is unmapped on return, it can't be replaced by the next save while mapped on Windows
+				loadJson = i8080_arcade::SaveState(savFile).MachineJson();
+				return loadJson.c_str();
+			}
+
 			std::ifstream fin((saveFilePath/gameRom).string() + ".json", std::ios::ate);
 			fin.exceptions(fin.failbit);
 			auto len = fin.tellg();
@@ -150,6 +782,27 @@ int main(int argc, char** argv)
 		ioController->EventLoop();
 		// Wait for the machine to finish, once complete the controllers can be accessed safely
 		machine->WaitForCompletion();
+		SaveMemoryProfile(*memoryController);
+
+		if (videoRecorder != nullptr)
+		{
+			ReportRecording(*videoRecorder);
+		}
+
+		if (tracer != nullptr)
+		{
+			ReportTrace(*tracer);
+		}
+
+		if (inputLog != nullptr && inputLog->Replaying() == true)
+		{
+			ReportReplay(inputLog->Frame(), inputLog->FrameHash(), *inputLog);
+		}
+		else if (inputLog != nullptr)
+		{
+			inputLog->Save(recordInputFile);
+			printf("Recorded %llu frames to %s, frame hash: %016llx\n", static_cast<unsigned long long>(inputLog->Frame()), recordInputFile.string().c_str(), static_cast<unsigned long long>(inputLog->FrameHash()));
+		}
 	}
 	catch (const std::exception& e)
 	{
@@ -0,0 +1,295 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "i8080_arcade/SaveState.h"
+
+using namespace i8080_arcade;
+
+// Round trip and corrupt input tests for the save state container and its LZ coder, they parse untrusted files.
+// Returns the number of failed checks.
+
+static int failures{};
+
+void Check(bool condition, const std::string& what)
+{
+	if (condition == false)
+	{
+		printf("FAILED: %s\n", what.c_str());
+		failures++;
+	}
+}
+
+void CheckThrows(const std::function<void()>& fn, const std::string& what)
+{
+	try
+	{
+		fn();
+	}
+	catch (const std::runtime_error&)
+	{
+		return;
+	}
+
+	Check(false, what + " did not throw");
+}
+
+// A stable pattern between runs and builds
+std::vector<uint8_t> Random(size_t size, uint32_t seed)
+{
+	std::vector<uint8_t> data(size);
+
+	for (auto& byte : data)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		byte = static_cast<uint8_t>(seed);
+	}
+
+	return data;
+}
+
+// Something like a save, long runs of zeros (unused ram) between text and random bytes
+std::vector<uint8_t> SaveLike(size_t size)
+{
+	std::string text = "{\"cpu\":{\"a\":12,\"pc\":6500},\"memory\":{\"ram\":\"";
+	std::vector<uint8_t> data(text.begin(), text.end());
+	auto random = Random(size / 4, 8080);
+
+	data.insert(data.end(), random.begin(), random.end());
+	data.resize(data.size() + size / 2);
+	data.insert(data.end(), random.begin(), random.begin() + size / 8);
+	data.resize(size);
+	return data;
+}
+
+void TestCompressRoundTrip()
+{
+	std::vector<std::pair<std::string, std::vector<uint8_t>>> inputs
+	{
+		{ "empty", {} },
+		{ "one byte", { 0x42 } },
+		{ "short", { 1, 2, 3, 4, 1, 2, 3, 4, 1, 2 } },
+		{ "zeros", std::vector<uint8_t>(100000) },
+		{ "random", Random(70000, 1) },
+		{ "save like", SaveLike(150000) },
+		// Literal and match lengths of 15 and more continue in extra length bytes
+		{ "long literals", Random(15 + 255 * 3, 2) },
+		{ "long match", std::vector<uint8_t>(4 + 15 + 255 * 3 + 1, 0xAA) }
+	};
+
+	for (const auto& [name, input] : inputs)
+	{
+		auto compressed = SaveState::Compress(input.data(), input.size());
+		std::vector<uint8_t> output(input.size());
+		SaveState::Decompress(compressed.data(), compressed.size(), output.data(), output.size());
+		Check(output == input, "compress round trip: " + name);
+	}
+
+	// Matches are found up to the largest offset, 0xFFFF back
+	auto far = Random(0x10000 + 64, 3);
+	std::copy_n(far.begin(), 64, far.end() - 64);
+	auto compressed = SaveState::Compress(far.data(), far.size());
+	std::vector<uint8_t> output(far.size());
+	SaveState::Decompress(compressed.data(), compressed.size(), output.data(), output.size());
+	Check(output == far, "compress round trip: far match");
+}
+
+void TestDecompressCorrupt()
+{
+	auto input = SaveLike(20000);
+	auto compressed = SaveState::Compress(input.data(), input.size());
+	std::vector<uint8_t> output(input.size());
+
+	auto decompress = [&output](const std::vector<uint8_t>& src, size_t dstSize)
+	{
+		output.assign(dstSize, 0);
+		SaveState::Decompress(src.data(), src.size(), output.data(), dstSize);
+	};
+
+	CheckThrows([&] { decompress(compressed, input.size() + 1); }, "decompress into a larger buffer");
+	CheckThrows([&] { decompress(compressed, input.size() - 1); }, "decompress into a smaller buffer");
+	CheckThrows([&] { decompress({ compressed.begin(), compressed.begin() + compressed.size() / 2 }, input.size()); }, "decompress truncated");
+	// A match before the start of the output
+	CheckThrows([&] { decompress({ 0x10, 'a', 0x02, 0x00 }, 5); }, "decompress offset beyond the output");
+	CheckThrows([&] { decompress({ 0x10, 'a', 0x00, 0x00 }, 5); }, "decompress zero offset");
+	// A literal length continuing past the end
+	CheckThrows([&] { decompress({ 0xF0, 0xFF }, 300); }, "decompress truncated length");
+	CheckThrows([&] { decompress({ 0x10, 'a', 0x01 }, 5); }, "decompress truncated offset");
+
+	// Any corruption must throw or decompress to exactly the buffer size, never write outside it
+	auto fuzzed = Random(4096, 4);
+
+	for (size_t i = 0; i < 4096; i++)
+	{
+		auto corrupt = compressed;
+		corrupt[fuzzed[i] * 7919u % corrupt.size()] ^= static_cast<uint8_t>(fuzzed[(i + 1) % fuzzed.size()] | 1);
+
+		try
+		{
+			decompress(corrupt, input.size());
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+	}
+}
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path)
+{
+	std::ifstream fin(path, std::ios::binary);
+	return { std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>() };
+}
+
+void WriteFile(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+{
+	std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+	fout.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+void Put64(std::vector<uint8_t>& data, size_t offset, uint64_t value)
+{
+	for (size_t i = 0; i < 8; i++)
+	{
+		data[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+}
+
+void TestSaveStateRoundTrip(const std::filesystem::path& path)
+{
+	auto saveLike = SaveLike(100000);
+	// The machine JSON is nul terminated, it can't hold a nul
+	std::replace(saveLike.begin(), saveLike.end(), uint8_t{ 0 }, uint8_t{ '0' });
+	std::string json(saveLike.begin(), saveLike.end());
+
+	for (auto compression : { SaveState::Compression::None, SaveState::Compression::Lz })
+	{
+		auto name = std::string(compression == SaveState::Compression::Lz ? "lz" : "none");
+		SaveState::Save(path, json, compression);
+		Check(std::strcmp(SaveState(path).MachineJson(), json.c_str()) == 0, "save state round trip: " + name);
+		SaveState::Save(path, "", compression);
+		Check(std::strcmp(SaveState(path).MachineJson(), "") == 0, "save state round trip empty: " + name);
+	}
+}
+
+void TestSaveStateCorrupt(const std::filesystem::path& path)
+{
+	std::string json(5000, 'x');
+	json.replace(0, 16, "{\"memory\":\"abcd\"");
+
+	for (auto compression : { SaveState::Compression::None, SaveState::Compression::Lz })
+	{
+		auto name = std::string(compression == SaveState::Compression::Lz ? " (lz)" : " (none)");
+		SaveState::Save(path, json, compression);
+		auto good = ReadFile(path);
+
+		auto load = [&path](const std::vector<uint8_t>& data)
+		{
+			WriteFile(path, data);
+			SaveState saveState(path);
+		};
+
+		auto corrupt = good;
+		corrupt[0] = 'x';
+		CheckThrows([&] { load(corrupt); }, "bad magic" + name);
+
+		corrupt = good;
+		corrupt[8] = SaveState::version_ + 1;
+		CheckThrows([&] { load(corrupt); }, "newer version" + name);
+
+		// The header and entry layout, see SaveState
+		CheckThrows([&] { load({ good.begin(), good.begin() + 10 }); }, "truncated header" + name);
+		CheckThrows([&] { load({ good.begin(), good.begin() + 30 }); }, "truncated entry" + name);
+		CheckThrows([&] { load({ good.begin(), good.end() - 1 }); }, "truncated section" + name);
+
+		corrupt = good;
+		corrupt[10] = 0;
+		CheckThrows([&] { load(corrupt); }, "no machine section" + name);
+
+		corrupt = good;
+		corrupt[16] = 2;
+		CheckThrows([&] { load(corrupt); }, "unknown section type only" + name);
+
+		corrupt = good;
+		corrupt[20] = 7;
+		CheckThrows([&] { load(corrupt); }, "unknown compression" + name);
+
+		corrupt = good;
+		Put64(corrupt, 24, good.size());
+		CheckThrows([&] { load(corrupt); }, "offset past the end" + name);
+
+		corrupt = good;
+		Put64(corrupt, 40, 0);
+		CheckThrows([&] { load(corrupt); }, "zero raw size" + name);
+
+		// A raw size far beyond what the stored size can expand to must not be allocated
+		corrupt = good;
+		Put64(corrupt, 40, uint64_t{ 1 } << 40);
+		CheckThrows([&] { load(corrupt); }, "huge raw size" + name);
+
+		corrupt = good;
+		Put64(corrupt, 40, json.size());
+		CheckThrows([&] { load(corrupt); }, "raw size one short" + name);
+
+		corrupt = good;
+		corrupt[56 + 1] ^= 0x01;
+		CheckThrows([&] { load(corrupt); }, "section data" + name);
+
+		corrupt = good;
+		corrupt[48] ^= 0x01;
+		CheckThrows([&] { load(corrupt); }, "hash" + name);
+	}
+}
+
+int main()
+{
+	auto path = std::filesystem::temp_directory_path() / "i8080-arcade-save-state-tests.sav";
+
+	try
+	{
+		TestCompressRoundTrip();
+		TestDecompressCorrupt();
+		TestSaveStateRoundTrip(path);
+		TestSaveStateCorrupt(path);
+	}
+	catch (const std::exception& e)
+	{
+		printf("FAILED: %s\n", e.what());
+		failures++;
+	}
+
+	std::filesystem::remove(path);
+	printf("%s\n", failures == 0 ? "All save state tests passed" : "Save state tests FAILED");
+	return failures == 0 ? 0 : 1;
+}